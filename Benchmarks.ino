@@ -0,0 +1,532 @@
+#include "beta-cube-library-fastled.h"
+#include "benchmark.h"
+#include "cube-sdf.h"
+#include "cube-layers.h"
+#include "cube-particles.h"
+#include "cube-audio.h"
+
+// Times the drawing primitives and color helpers of the library over sweeps of their parameters and prints
+// one JSON object per line over Serial, e.g.
+//   {"bench":"sphere","param":"r=2","platform":"photon","size":8,"clock":"cycles","calls":412,"ns_per_call":4310.2,"voxels":33,"ns_per_voxel":130.6}
+// voxels is the number of voxels lit by one call, or lit before it for fade and background; helpers that
+// return a single color report null. Only the calls themselves are timed; before each call of fade and
+// background the cube is filled again without showing a frame. background() does show one, so on the device it is timed with micros()
+// ("clock":"micros") and includes sending the frame to the LEDs.
+// Runs on the cube and on the host (see "Running sketches on a desktop" in the README).
+
+Cube cube=Cube();
+Color onColor=Color(200, 100, 50);
+volatile uint8_t sink;
+int counter;
+
+/** Time spent in each benchmark, in nanoseconds; calls are repeated until it is reached. */
+#define BENCHMARK_NANOS 20000000.0f
+#define BENCHMARK_MIN_CALLS 8
+#define BENCHMARK_BATCH 64
+
+typedef void (*BenchmarkFunction)(int param);
+
+/** Light a deterministic scattering of voxels. */
+void fillDensity(int percent)
+{
+	for(int i = 0; i < PIXEL_COUNT; i++)
+		cube.setVoxel(i, ((i * 37) % 100) < percent ? onColor : Black);
+}
+
+int litVoxels()
+{
+	int count = 0;
+	for(int i = 0; i < PIXEL_COUNT; i++)
+		if(cube.getVoxel(i) != Black)
+			count++;
+	return count;
+}
+
+void clearCube(int param)
+{
+	cube.fade(1.0f, false);		// clears without sending a frame to the LEDs
+}
+
+void lineAxis(int length) { cube.line(0, 0, 0, length - 1, 0, 0, onColor); }
+void lineDiagonal(int length) { cube.line(0, 0, 0, length - 1, length - 1, length - 1, onColor); }
+void lineAA(int length) { cube.lineAA(Point(0.25f, 0.5f, 0.75f), Point(length - 0.75f, length * 0.6f, length * 0.3f), onColor, BLEND_MAX); }
+void sphere(int r) { cube.sphere(cube.size / 2, cube.size / 2, cube.size / 2, r, onColor); }
+void shellThin(int r) { cube.shell(cube.size / 2, cube.size / 2, cube.size / 2, r, 0.1f, onColor); }
+void shellThick(int r) { cube.shell(cube.size / 2, cube.size / 2, cube.size / 2, r, 0.6f, onColor); }
+void fade(int density) { cube.fade(0.0625f, false); }
+void scaleVolume(int density) { cube.scaleVolume(240); }
+void blur(int density) { cube.blur(64); }
+VoxelTransform quarterTurn;
+void rotate(int density) { cube.transform(quarterTurn); }
+void scroll(int density) { cube.translate(0, 0, -1); }
+VoxelBuffer fadeFrom, fadeTo;
+void fillFadeBuffers(int density)
+{
+	fillDensity(density);
+	cube.copyTo(fadeFrom);
+	cube.translate(0, 0, 1, true);
+	cube.copyTo(fadeTo);
+}
+void crossFade(int density) { cube.crossFade(fadeFrom, fadeTo, 100); }
+void scrollVoxels(int density)
+{
+	for(int z = 0; z < cube.size - 1; z++)
+		for(int x = 0; x < cube.size; x++)
+			for(int y = 0; y < cube.size; y++)
+				cube.setVoxel(x, y, z, cube.getVoxel(x, y, z + 1));
+	for(int x = 0; x < cube.size; x++)
+		for(int y = 0; y < cube.size; y++)
+			cube.setVoxel(x, y, cube.size - 1, Black);
+}
+void fillBox(int length) { cube.fillBox(0, 0, 0, length - 1, length - 1, length - 1, onColor); }
+void backgroundBlack(int density) { cube.background(Black); }
+void backgroundColor(int density) { cube.background(onColor); }
+void edges(int param)
+{
+	int n = cube.size - 1;
+	for(int a = 0; a <= n; a += n)
+		for(int b = 0; b <= n; b += n) {
+			cube.line(0, a, b, n, a, b, onColor);
+			cube.line(a, 0, b, a, n, b, onColor);
+			cube.line(a, b, 0, a, b, n, onColor);
+		}
+}
+
+// the trail of DemoCode's squarral and the rocket of its fireworks, moved with Point and with PointQ
+#define TRAIL_LENGTH 50
+Point trailFloat[TRAIL_LENGTH];
+Point headFloat, stepFloat(0.375f, 0.25f, 0.125f);
+PointQ trailFixed[TRAIL_LENGTH];
+PointQ headFixed, stepFixed(96, 64, 32);
+
+void trailFloatStep(int param)
+{
+	for(int i = TRAIL_LENGTH - 1; i > 0; i--)
+		trailFloat[i] = trailFloat[i - 1];
+	trailFloat[0] = headFloat;
+	headFloat.x += stepFloat.x;
+	headFloat.y += stepFloat.y;
+	headFloat.z += stepFloat.z;
+	if(headFloat.x >= cube.size) headFloat.x -= cube.size;
+	if(headFloat.y >= cube.size) headFloat.y -= cube.size;
+	if(headFloat.z >= cube.size) headFloat.z -= cube.size;
+	for(int i = 0; i < TRAIL_LENGTH; i++)
+		cube.setVoxel((int)trailFloat[i].x, (int)trailFloat[i].y, (int)trailFloat[i].z, onColor);
+}
+
+void trailFixedStep(int param)
+{
+	for(int i = TRAIL_LENGTH - 1; i > 0; i--)
+		trailFixed[i] = trailFixed[i - 1];
+	trailFixed[0] = headFixed;
+	headFixed += stepFixed;
+	if(headFixed.x >= cube.size * POINTQ_ONE) headFixed.x -= cube.size * POINTQ_ONE;
+	if(headFixed.y >= cube.size * POINTQ_ONE) headFixed.y -= cube.size * POINTQ_ONE;
+	if(headFixed.z >= cube.size * POINTQ_ONE) headFixed.z -= cube.size * POINTQ_ONE;
+	for(int i = 0; i < TRAIL_LENGTH; i++)
+		cube.setVoxel(trailFixed[i], onColor);
+}
+
+Point rocketFloat, rocketStepFloat(0.125f, 0.125f, 0.125f);
+float radiusFloat;
+
+void fireworksFloat(int param)
+{
+	if(radiusFloat == 0) {
+		cube.sphere(rocketFloat, 0, onColor);
+		rocketFloat.x += rocketStepFloat.x;
+		rocketFloat.y += rocketStepFloat.y;
+		rocketFloat.z += rocketStepFloat.z;
+		float c = (cube.size - 1) / 2.0f;
+		if(sqrt(pow(rocketFloat.x - c, 2) + pow(rocketFloat.y - c, 2) + pow(rocketFloat.z - c, 2)) < 1)
+			radiusFloat = 0.15f;
+	} else {
+		cube.shell(rocketFloat, radiusFloat, onColor);
+		radiusFloat += 0.15f;
+		if(radiusFloat > cube.size / 2) {
+			radiusFloat = 0;
+			rocketFloat = Point();
+		}
+	}
+}
+
+PointQ rocketFixed, rocketStepFixed(32, 32, 32);
+int16_t radiusFixed;
+
+void fireworksFixed(int param)
+{
+	if(radiusFixed == 0) {
+		cube.sphere(rocketFixed, 0, onColor);
+		rocketFixed += rocketStepFixed;
+		int32_t c = (cube.size - 1) * POINTQ_ONE / 2;
+		int32_t dx = rocketFixed.x - c, dy = rocketFixed.y - c, dz = rocketFixed.z - c;
+		if(dx * dx + dy * dy + dz * dz < POINTQ_ONE * POINTQ_ONE)
+			radiusFixed = 38;
+	} else {
+		cube.shell(rocketFixed, radiusFixed, onColor);
+		radiusFixed += 38;
+		if(radiusFixed > cube.size / 2 * POINTQ_ONE) {
+			radiusFixed = 0;
+			rocketFixed = PointQ();
+		}
+	}
+}
+
+CubeCommand edgeCommands[12];
+CubeRun edgeRuns[12 * CUBE_SIZE];
+CubeCommandList edgeList(edgeCommands, 12, edgeRuns, 12 * CUBE_SIZE);
+void edgesList(int param) { cube.draw(edgeList); }
+
+SdfScene sdfSphere;
+void sdfSphereRadius(int r)
+{
+	float c = (cube.size - 1) / 2.0f;
+	sdfSphere.clear();
+	sdfSphere.sphere(c, c, c, r, onColor);
+}
+void sdf(int param) { cube.draw(sdfSphere); }
+
+SdfScene sdfBlobs;
+void sdfBlobsDraw(int param) { cube.draw(sdfBlobs); }
+
+// four layers, of which the top param change every frame
+VoxelLayer layerFill(LAYER_REPLACE), layerSphere(LAYER_ADD), layerShell(LAYER_SCREEN, 160), layerEdges(LAYER_ALPHA, 200);
+LayerStack layers;
+void fillLayers(int changing)
+{
+	if(!layers.layerCount()) {
+		layers.add(layerFill);
+		layers.add(layerSphere);
+		layers.add(layerShell);
+		layers.add(layerEdges);
+	}
+	cube.setTarget(&layerFill);
+	fillDensity(50);
+	cube.setTarget(&layerSphere);
+	cube.sphere(cube.size / 2, cube.size / 2, cube.size / 2, cube.size / 3, Red);
+	cube.setTarget(&layerShell);
+	cube.shell(cube.size / 2, cube.size / 2, cube.size / 2, cube.size / 2, 0.6f, Blue);
+	cube.setTarget(&layerEdges);
+	cube.line(0, 0, 0, cube.size - 1, cube.size - 1, cube.size - 1, Green);
+	cube.setTarget(NULL);
+	cube.composite(layers);
+}
+void composite(int changing)
+{
+	for(int i = layers.layerCount() - changing; i < layers.layerCount(); i++)
+		layers.layer(i).changed = true;
+	cube.composite(layers);
+}
+
+// a pool of particles spread through the cube, moved a step under gravity and drag and drawn
+ParticleSystem particles;
+void spawnParticles(int count)
+{
+	ParticleEmitter emitter;
+	emitter.position = PointQ(cube.size * POINTQ_ONE / 2, cube.size * POINTQ_ONE / 2, cube.size * POINTQ_ONE / 2);
+	emitter.spread = PARTICLE_VELOCITY_ONE / 4;
+	emitter.life = 1000;
+	emitter.color = CRGB(40, 20, 10);
+	random16_set_seed(1);
+	particles.clear();
+	particles.burst(emitter, count);
+	// spread them out, so they are drawn all over the cube
+	for(int i = 0; i < 12; i++)
+		particles.step();
+	particles.setGravity(0, 0, -6);
+	particles.setDrag(2500);
+}
+void particleStep(int count) { particles.step(); }
+void particleDraw(int count) { cube.draw(particles); }
+
+// the 16 point float FFT DemoCode's spectrum used to take, with its magnitudes, against an AudioAnalyzer
+#define SPECTRUM_FLOAT_BITS 4
+#define SPECTRUM_FLOAT_POINTS (1 << SPECTRUM_FLOAT_BITS)
+float spectrumReal[SPECTRUM_FLOAT_POINTS], spectrumImaginary[SPECTRUM_FLOAT_POINTS];
+
+void spectrumFloat(int points)
+{
+	float *x = spectrumReal, *y = spectrumImaginary;
+	int n = SPECTRUM_FLOAT_POINTS;
+	for(int i = 0; i < n; i++) {
+		x[i] = (counter++ * 37) % 401 - 200;
+		y[i] = 0;
+	}
+	for(int i = 0, j = 0; i < n - 1; i++) {
+		if(i < j) {
+			float t = x[i]; x[i] = x[j]; x[j] = t;
+			t = y[i]; y[i] = y[j]; y[j] = t;
+		}
+		int k = n >> 1;
+		while(k <= j) {
+			j -= k;
+			k >>= 1;
+		}
+		j += k;
+	}
+	float c1 = -1.0, c2 = 0.0;
+	for(int l = 0, l2 = 1; l < SPECTRUM_FLOAT_BITS; l++) {
+		int l1 = l2;
+		l2 <<= 1;
+		float u1 = 1.0, u2 = 0.0;
+		for(int j = 0; j < l1; j++) {
+			for(int i = j; i < n; i += l2) {
+				int i1 = i + l1;
+				float t1 = u1 * x[i1] - u2 * y[i1];
+				float t2 = u1 * y[i1] + u2 * x[i1];
+				x[i1] = x[i] - t1;
+				y[i1] = y[i] - t2;
+				x[i] += t1;
+				y[i] += t2;
+			}
+			float z = u1 * c1 - u2 * c2;
+			u2 = u1 * c2 + u2 * c1;
+			u1 = z;
+		}
+		c2 = -sqrt((1.0 - c1) / 2.0);
+		c1 = sqrt((1.0 + c1) / 2.0);
+	}
+	for(int i = 0; i < n; i++) {
+		x[i] /= n;
+		y[i] /= n;
+		y[i] = sqrt(pow(y[i], 2) + pow(x[i], 2));
+	}
+	sink = y[1];
+}
+
+AudioAnalyzer analyzer;
+void spectrumPoints(int points) { analyzer.setPoints(points); }
+void spectrumFixed(int points)
+{
+	for(int i = 0; i < points; i++)
+		analyzer.addSample(((counter++ * 37) % 401 - 200) << 4);
+	analyzer.analyze();
+	sink = analyzer.band(0);
+}
+
+// a volume of 16 bit noise, 8 voxels to a lattice cell, filled in one call and one voxel at a time
+uint16_t noiseVolume[PIXEL_COUNT];
+void noiseFill(int octaves)
+{
+	memset(noiseVolume, 0, sizeof(noiseVolume));
+	fill_raw_3dnoise16(noiseVolume, cube.size, cube.size, cube.size, octaves, 0, 0x2000, 0, 0x2000, 0, 0x2000, counter++ << 8);
+}
+void noisePerVoxel(int octaves)
+{
+	uint32_t time = counter++ << 8;
+	memset(noiseVolume, 0, sizeof(noiseVolume));
+	for(int o = 0; o < octaves; o++)
+		for(int k = 0; k < cube.size; k++)
+			for(int j = 0; j < cube.size; j++)
+				for(int i = 0; i < cube.size; i++) {
+					uint16_t &value = noiseVolume[(k * cube.size + j) * cube.size + i];
+					uint32_t accum = value + (inoise16((i * 0x2000) << o, (j * 0x2000) << o, ((k * 0x2000) << o) + time) >> o);
+					value = (accum > 65535) ? 65535 : accum;
+				}
+}
+void noiseColor(int octaves)
+{
+	int step = counter++;
+	fill_3dnoise16(cube.voxels(), cube.size, cube.size, cube.size, octaves, 0, 0x2000, 0, 0x2000, 0, 0x2000, step << 8,
+			1, 0, 0x1000, 0, 0x1000, 0, 0x1000, step, false);
+}
+
+void colorMap(int param) { sink = cube.colorMap(counter++ & 255, 0, 255).red; }
+void lerpColor(int param) { sink = cube.lerpColor(Red, Blue, counter++ & 255, 0, 255).red; }
+void colorMapPosition(int param) { sink = cube.colorMap(counter++).red; }
+void wheel(int param) { sink = cube.Wheel(counter++, 0.5f).red; }
+void wheelFull(int param) { sink = cube.Wheel(counter++).red; }
+
+/** Time taken to read the clock, subtracted from every timed batch. */
+float overheadNanos = 0;
+
+/** Repeat op(param) until BENCHMARK_NANOS have been spent in it.
+  With prepare, it is called untimed before every call of op. Without, op is timed in batches of
+  BENCHMARK_BATCH calls, so that reading the clock does not swamp short calls.
+
+  @param wall Time with micros(), for op that shows a frame.
+  @param nanos Set to the average nanoseconds per call.
+
+  @return Number of calls made.
+*/
+uint32_t measure(BenchmarkFunction prepare, BenchmarkFunction op, int param, bool wall, float *nanos)
+{
+	int batch = prepare ? 1 : BENCHMARK_BATCH;
+	uint32_t calls = 0, batches = 0;
+	float total = 0;
+	while(calls < BENCHMARK_MIN_CALLS || total < BENCHMARK_NANOS) {
+		if(prepare)
+			prepare(param);
+		if(wall) {
+			uint32_t start = benchmarkMicros();
+			for(int i = 0; i < batch; i++)
+				op(param);
+			total += (benchmarkMicros() - start) * 1000.0f;
+		} else {
+			uint32_t start = benchmarkTicks();
+			for(int i = 0; i < batch; i++)
+				op(param);
+			total += benchmarkTicksToNanos(benchmarkTicks() - start);
+		}
+		calls += batch;
+		batches++;
+	}
+	if(!wall)
+		total = (total > batches * overheadNanos) ? total - batches * overheadNanos : 0;
+	*nanos = total / calls;
+	return calls;
+}
+
+/** Run one benchmark and print its result.
+
+  @param name Name of the benchmark.
+  @param label Name of the swept parameter, or NULL if there is none.
+  @param prepare Called before every timed call, untimed, or NULL if op can be repeated as it is.
+  @param op The call to time.
+  @param param Passed to prepare and op.
+  @param litBefore Count the voxels lit before op rather than after it.
+  @param helper op returns a color rather than drawing, so there are no voxels to count.
+*/
+float run(const char *name, const char *label, BenchmarkFunction prepare, BenchmarkFunction op, int param, bool litBefore, bool helper=false)
+{
+	bool wall = false;
+#if !defined(FASTLED_HOST_PLATFORM)
+	wall = (op == backgroundBlack || op == backgroundColor);
+#endif
+	clearCube(0);
+	if(prepare)
+		prepare(param);
+	int voxels = litVoxels();
+	op(param);
+	if(!litBefore)
+		voxels = litVoxels();
+
+	float nanos;
+	uint32_t calls = measure(prepare, op, param, wall, &nanos);
+
+	char paramText[24];
+	if(label)
+		snprintf(paramText, sizeof(paramText), "%s=%d", label, param);
+	else
+		snprintf(paramText, sizeof(paramText), "-");
+	Serial.printf("{\"bench\":\"%s\",\"param\":\"%s\",\"platform\":\"%s\",\"size\":%d,\"clock\":\"%s\",\"calls\":%lu,\"ns_per_call\":%.1f,",
+			name, paramText, BENCHMARK_PLATFORM, cube.size,
+#if defined(FASTLED_HOST_PLATFORM)
+			"monotonic",
+#else
+			wall ? "micros" : "cycles",
+#endif
+			(unsigned long)calls, nanos);
+	if(helper || voxels == 0)
+		Serial.printf("\"voxels\":%s,\"ns_per_voxel\":null}\n", helper ? "null" : "0");
+	else
+		Serial.printf("\"voxels\":%d,\"ns_per_voxel\":%.1f}\n", voxels, nanos / voxels);
+	return nanos;
+}
+
+void setup() {
+	Serial.begin(9600);
+	cube.begin();
+	benchmarkBegin();
+
+	// the cost of reading the clock twice
+	uint32_t ticks = 0;
+	for(int i = 0; i < 1000; i++) {
+		uint32_t start = benchmarkTicks();
+		ticks += benchmarkTicks() - start;
+	}
+	overheadNanos = benchmarkTicksToNanos(ticks) / 1000;
+
+	for(int length = 1; ; length *= 2) {
+		if(length > cube.size)
+			length = cube.size;
+		run("line_axis", "length", NULL, lineAxis, length, false);
+		run("line_diagonal", "length", NULL, lineDiagonal, length, false);
+		run("line_aa", "length", NULL, lineAA, length, false);
+		if(length == cube.size)
+			break;
+	}
+	for(int length = 1; length <= cube.size; length *= 2)
+		run("fill_box", "length", NULL, fillBox, length, false);
+	for(int r = 0; r <= cube.size / 2; r++)
+		run("sphere", "r", NULL, sphere, r, false);
+	for(int r = 1; r < cube.size; r += (r < 2) ? 1 : 2) {
+		run("shell_thin", "r", NULL, shellThin, r, false);
+		run("shell_thick", "r", NULL, shellThick, r, false);
+	}
+
+	// fill the trails before timing them, so that they light as many voxels as they do in the demo
+	for(int i = 0; i < TRAIL_LENGTH; i++) {
+		trailFloatStep(0);
+		trailFixedStep(0);
+	}
+	run("trail_float", NULL, NULL, trailFloatStep, 0, false);
+	run("trail_fixed", NULL, NULL, trailFixedStep, 0, false);
+	run("fireworks_float", NULL, NULL, fireworksFloat, 0, false);
+	run("fireworks_fixed", NULL, NULL, fireworksFixed, 0, false);
+
+	static const int densities[] = { 0, 10, 50, 100 };
+	for(unsigned int i = 0; i < sizeof(densities) / sizeof(densities[0]); i++) {
+		run("fade", "density", fillDensity, fade, densities[i], true);
+		run("scale_volume", "density", fillDensity, scaleVolume, densities[i], true);
+		run("blur", "density", fillDensity, blur, densities[i], true);
+		run("background_black", "density", fillDensity, backgroundBlack, densities[i], true);
+	}
+	// a quarter turn about z, and scrolling along z by a slab, compared to copying voxel by voxel
+	quarterTurn.rotate(AXIS_Z, 1);
+	run("rotate", "density", fillDensity, rotate, 50, true);
+	run("scroll", "density", fillDensity, scroll, 50, true);
+	run("scroll_voxels", "density", fillDensity, scrollVoxels, 50, true);
+	// mixing two buffers, as the effect scheduler does during a transition
+	run("cross_fade", "density", fillFadeBuffers, crossFade, 50, true);
+	run("background_color", NULL, NULL, backgroundColor, 0, false);
+	for(int count = 250; count <= PARTICLE_MAX; count *= 2) {
+		float stepNanos = run("particle_step", "particles", spawnParticles, particleStep, count, false, true);
+		float drawNanos = run("particle_draw", "particles", spawnParticles, particleDraw, count, false, true);
+		Serial.printf("{\"bench\":\"particles\",\"param\":\"particles=%d\",\"platform\":\"%s\",\"alive\":%d,\"particles_per_ms\":%.0f}\n",
+				count, BENCHMARK_PLATFORM, particles.particleCount(), particles.particleCount() * 1e6f / (stepNanos + drawNanos));
+	}
+	fillLayers(0);
+	for(int changing = 0; changing <= 4; changing++)
+		run("composite", "changing", NULL, composite, changing, false);
+
+	// the 12 edges of the cube, drawn directly and from a compiled command list
+	int n = cube.size - 1;
+	for(int a = 0; a <= n; a += n)
+		for(int b = 0; b <= n; b += n) {
+			edgeList.line(0, a, b, n, a, b, onColor);
+			edgeList.line(a, 0, b, a, n, b, onColor);
+			edgeList.line(a, b, 0, a, b, n, onColor);
+		}
+	run("edges_direct", NULL, NULL, edges, 0, false);
+	run("edges_list", NULL, NULL, edgesList, 0, false);
+
+	for(int r = 1; r <= cube.size / 2; r++)
+		run("sdf_sphere", "r", sdfSphereRadius, sdf, r, false);
+	// two spheres blended into a torus, standing on a floor
+	float c = (cube.size - 1) / 2.0f;
+	int blobs = sdfBlobs.smoothUnionOf(sdfBlobs.sphere(c - 2, c, c + 1, 1.5f, Red), sdfBlobs.sphere(c + 2, c, c + 1, 1.5f, Blue), 1.5f);
+	int ring = sdfBlobs.smoothUnionOf(blobs, sdfBlobs.torus(Point(c, c, c + 1), 2.5f, 0.7f, Green), 1.0f);
+	sdfBlobs.unionOf(ring, sdfBlobs.plane(Point(0, 0, 1), 0.5f, onColor));
+	run("sdf_scene", NULL, NULL, sdfBlobsDraw, 0, false);
+
+	run("spectrum_float", "points", NULL, spectrumFloat, SPECTRUM_FLOAT_POINTS, false, true);
+	for(int points = 64; points <= AUDIO_FFT_MAX_POINTS; points *= 2)
+		run("spectrum_fixed", "points", spectrumPoints, spectrumFixed, points, false, true);
+
+	for(int octaves = 1; octaves <= 3; octaves++) {
+		run("noise_fill", "octaves", NULL, noiseFill, octaves, false, true);
+		run("noise_per_voxel", "octaves", NULL, noisePerVoxel, octaves, false, true);
+		run("noise_color", "octaves", NULL, noiseColor, octaves, false);
+	}
+
+	run("colorMap", NULL, NULL, colorMap, 0, false, true);
+	run("colorMap_position", NULL, NULL, colorMapPosition, 0, false, true);
+	run("lerpColor", NULL, NULL, lerpColor, 0, false, true);
+	run("Wheel", NULL, NULL, wheel, 0, false, true);
+	run("Wheel_full", NULL, NULL, wheelFull, 0, false, true);
+	Serial.printf("{\"done\":true,\"platform\":\"%s\"}\n", BENCHMARK_PLATFORM);
+}
+
+void loop() {
+}
@@ -1,12 +1,24 @@
 #include "beta-cube-library-fastled.h"
+#include "cube-governor.h"
+
+#define STEP_RATE 60		// a voxel of a line, or a fade, every step
+#define PAUSE_STEPS (STEP_RATE * 3 / 10)	// 300 ms between lines
+
+#define DRAWING 0
+#define PAUSING 1
+#define FADING 2
 
 Cube cube=Cube();
+FrameGovernor governor(cube, STEP_RATE, STEP_RATE);
 Color col;			// You need to keep it at ~20% brightness
 					// at full brightness, i.e. (255,255,0), the LEDs will try to draw too much power, and the
 					// cube's internal current-limiting circuitry will kick in.  
   int x, changex, changexa, decreasex;
   int y, changey, changeya, decreasey;
   int z, changez, changeza, decreasez;
+int state, linesLeft, t, pauseSteps;
+
+void startLines();
 
 void setup() {
 	x = decreasex = 0;
@@ -15,9 +27,10 @@ void setup() {
 
 	cube.begin();
 	cube.clear();
+	startLines();
 }
 
-void drawLine() {
+void startLine() {
 	//decreasex = 0;
 	//decreasey = 0;
 	//decreasez = 0;
@@ -39,56 +52,80 @@ void drawLine() {
 	if (x == (cube.size-1)) decreasex = 1;
 	if (y == (cube.size-1)) decreasey = 1;
 	if (z == (cube.size-1)) decreasez = 1;
-  
-	for(int t = 0; t < cube.size; t++) {
-		col = Color((cube.size-x)*18, (cube.size-y)*18, (cube.size-z)*18);
 
-		if(changex == 0) {
-			if(decreasex == 1)
-				x = (cube.size-1)-t;
-			else
-				x = t;
-		}
-		if(changey == 0) {
-			if(decreasey == 1)
-				y = (cube.size-1)-t;
-			else
-				y = t;
-		}
-		if(changez == 0) {
-			if(decreasez == 1)
-				z = (cube.size-1)-t;
-			else
-				z = t;
-		}
-		cube.setVoxel(x, y, z, col);
-		cube.show();
+	t = 0;
+	state = DRAWING;
+}
+
+void startLines() {
+	linesLeft = rand()%9 + 1;
+	startLine();
+}
+
+void drawVoxel() {
+	col = Color((cube.size-x)*18, (cube.size-y)*18, (cube.size-z)*18);
+
+	if(changex == 0) {
+		if(decreasex == 1)
+			x = (cube.size-1)-t;
+		else
+			x = t;
 	}
+	if(changey == 0) {
+		if(decreasey == 1)
+			y = (cube.size-1)-t;
+		else
+			y = t;
+	}
+	if(changez == 0) {
+		if(decreasez == 1)
+			z = (cube.size-1)-t;
+		else
+			z = t;
+	}
+	cube.setVoxel(x, y, z, col);
+	t++;
 }
 
 bool areAllVoxelsFaded() {
-	Color col;
-	for(int x = 0; x < cube.size; x++)
-		for(int y = 0; y < cube.size; y++)
-			for(int z = 0; z < cube.size; z++) {
-				col = cube.getVoxel(x, y, z);
-				if((col.red + col.green + col.blue) > 0) return false;
-			}
-	return true;
+	// fade() shrinks the dirty region down to the voxels that are still lit
+	return cube.getDirtyRegion().isEmpty();
 }
 
-void loop() {
-	int iteration = rand()%9;
-	for(int b=iteration+3; iteration >= 0; iteration--) {
-		drawLine();
-		delay(300);
+// one fixed step of the animation: draw the lines a voxel at a time, pausing after each, then fade them out
+void simulate() {
+	switch(state) {
+		case DRAWING:
+			drawVoxel();
+			if(t == cube.size) {
+				state = PAUSING;
+				pauseSteps = (linesLeft == 1) ? 2 * PAUSE_STEPS : PAUSE_STEPS;
+			}
+			break;
+		case PAUSING:
+			if(--pauseSteps > 0)
+				break;
+			if(--linesLeft > 0) {
+				startLine();
+			} else {
+				decreasex = 0;
+				decreasey = 0;
+				decreasez = 0;
+				state = FADING;
+			}
+			break;
+		case FADING:
+			cube.fade(0.0625f, false);
+			if(areAllVoxelsFaded())
+				startLines();
+			break;
 	}
+}
 
-	decreasex = 0;
-	decreasey = 0;
-	decreasez = 0;
-	
-	delay(300);
-	while(!areAllVoxelsFaded())
-		cube.fade();
-}
\ No newline at end of file
+// the animation runs at STEP_RATE however long a frame takes to show
+void loop() {
+	governor.beginFrame();
+	while(governor.step())
+		simulate();
+	governor.endFrame();
+}
@@ -1,5 +1,10 @@
 #include <math.h>
 #include "beta-cube-library-fastled.h"
+#include "cube-motion.h"
+#include "cube-effects.h"
+#include "cube-governor.h"
+#include "cube-particles.h"
+#include "cube-audio.h"
 
 #define MICROPHONE 12
 #define GAIN_CONTROL 11
@@ -7,11 +12,6 @@
 #define SPEED 0.22
 
 
-#define FIREWORKS 0
-#define SQUARRAL 1
-#define PLASMA 2
-#define FFT_JOY 3
-#define DEMO_ROUTINES 4
 
 
 void add(Point& a, Point& b);
@@ -20,18 +20,21 @@ void add(Point& a, Point& b);
 /******************************
  * fireworks variables *
  * ****************************/
- int centerX, centerY, centerZ;
-int launchX, launchZ;
-int brightness=50;
-float radius=0;
-float speed;
-bool showRocket;
-bool exploded;
-float xInc, yInc, zInc;
-float rocketX, rocketY, rocketZ;
-float launchTime;
-int maxSize;
-Color rocketColor, fireworkColor;
+#define MAX_ROCKETS 3
+#define SPARKS_PER_BURST 120
+
+//a rocket climbs toward where it bursts, leaving a trail of sparks
+struct Rocket {
+    ParticleEmitter trail;
+    PointQ step;
+    int stepsLeft;
+};
+
+ParticleSystem sparks;
+ParticleEmitter burst;
+Rocket rockets[MAX_ROCKETS];
+int rocketCount=0;
+int nextLaunch=0;
 
 
 
@@ -51,6 +54,7 @@ int squarral_zInc=1;
 int bound=0;
 int boundInc=1;
 unsigned char axis=0;
+VoxelTransform squarralAxes[6];
 bool rainbow=true;
 
 //maxBrightness is the brightness limit for each pixel.  All color data will be scaled down 
@@ -69,11 +73,9 @@ Color plasmaColor;
 /*********************************
  * FFTJoy variables *
  * *******************************/
-#define M 4
-float real[(int)pow(2,M)];
-float imaginary[(int)pow(2,M)];
-float maxValue=0;
-float sample;
+#define SPECTRUM_POINTS 64
+#define SPECTRUM_INTERVAL 106  //microseconds between samples: a spectrum up to 4.7kHz, which puts a soprano's vocal range in the middle of the cube
+AudioAnalyzer analyzer(SPECTRUM_POINTS, CUBE_SIZE);
 
 /**********************************
  * flip variables *
@@ -83,109 +85,90 @@ float sample;
 #define Y 14
 #define Z 15
 #define AUTOCYCLE_TIME 22222
-#define FACEPLANT 2300
-#define UPSIDE_DOWN 1850
-#define RIGHTSIDE_UP 2400
-#define LEFT_SIDE 1800
-#define RIGHT_SIDE 2400
-#define FLIP_TIMEOUT 3000
-#define FLIP_DEBOUNCE 250
-
-long lastFaceplant=-1*FLIP_TIMEOUT;
-bool upsideDown=false;
-bool sideways=false;
-bool autoCycle=true;    //start on autocycle by default
-int upsideDownTime=-1*FLIP_TIMEOUT;
-long lastAutoCycle=0;
-int lastLeft=-1*FLIP_TIMEOUT;
-int lastRight=-1*FLIP_TIMEOUT;
-int accelerometer[3];
-long lastChange=0;
+#define AUTOCYCLE_FADE_TIME 2000
+#define MANUAL_FADE_TIME 250
+#define DEMO_RATE 60   //the demos move on a frame per step, this many steps a second
 
+//the accelerometer is read in the background; flips and tilts come out of it as events
+MotionSampler motion;
+bool autoCycle=true;    //start on autocycle by default
 
-int demo=FIREWORKS;
 
 int frameCount=0;
 
-/*******************************
- * fade variables *
- * ****************************/
-bool fading=false;
-int fadeValue=255;
-int fadeSpeed=2;
-
 Cube cube=Cube();
 
 void initSquarral();
-void squarral();
+void squarral(Cube &cube);
 
 void initFireworks();
-void prepRocket();
+void launchRocket();
 void updateFireworks();
-float distance(float x, float y, float z, float x1, float y1, float z1);
 void add(Point& a, Point& b);
 
 void fade(float coeff);
-void zPlasma();
+void zPlasma(Cube &cube);
 
-void FFTJoy();
-short FFT(short int dir,int m,float *x,float *y);
+void FFTJoy(Cube &cube);
 
 void checkFlipState();
-void updateAccelerometer();
-void setFadeSpeed();
-void incrementDemo();
-void decrementDemo();
+
+/*******************************
+ * the demos, played one after the other *
+ * ****************************/
+class Fireworks : public Effect {
+  public:
+    void update(uint32_t) { updateFireworks(); }
+    void render(Cube &cube) { cube.draw(sparks); }
+};
+
+class Squarral : public Effect {
+  public:
+    void render(Cube &cube) { squarral(cube); }
+};
+
+class Plasma : public Effect {
+  public:
+    void render(Cube &cube) { zPlasma(cube); }
+};
+
+//scrolls the spectrum back through the cube, so it builds on the frame before
+class Spectrum : public Effect {
+  public:
+    void render(Cube &cube) { FFTJoy(cube); }
+    bool keepsFrame(void) { return true; }
+};
+
+Fireworks fireworks;
+Squarral squarralDemo;
+Plasma plasma;
+Spectrum spectrum;
+EffectScheduler demos(cube);
+FrameGovernor governor(cube, DEMO_RATE, DEMO_RATE);
 
 void setup() {
  cube.begin();
+ motion.begin();
  initSquarral();
  initFireworks();
+ demos.add(fireworks, AUTOCYCLE_TIME);
+ demos.add(squarralDemo, AUTOCYCLE_TIME);
+ demos.add(plasma, AUTOCYCLE_TIME);
+ demos.add(spectrum, AUTOCYCLE_TIME);
+ demos.setTransition(AUTOCYCLE_FADE_TIME);
 }
 
 void loop() {
-    
-  if(fading)
-        cube.fade();
-    else
-    {
-        if(demo!=FFT_JOY)
-			cube.clear();	//background(black);
-        switch(demo)
-        {
-            case(FIREWORKS):
-                updateFireworks();
-            break;
-            case(PLASMA):
-                zPlasma();
-            break;
-            case(SQUARRAL):
-                squarral();
-            break;
-            case(FFT_JOY):
-                FFTJoy();
-            break;
-            
-        }
-        frameCount++;
-    }
+    governor.beginFrame();
+    //move the demos on in fixed steps, then draw them once however many steps were taken
+    while(governor.step())
+        demos.update(governor.stepMicros());
+    demos.render();
+    frameCount++;
     //check to see how if the cube has been flipped
     checkFlipState();
 
-    cube.show();
-    
-    if(fading)
-    {
-        fadeValue-=fadeSpeed;
-        //if we're done fading)
-        if(fadeValue<=0)
-        {
-            fading=false;
-            fadeValue=255;
-        }
-        /*else
-            fade(0.0625f);*/
-    }
+    governor.endFrame();
 }
 
 /*void fade(float coeff)
@@ -213,75 +196,81 @@ void loop() {
  
 void updateFireworks()
 {
-	if(showRocket)
-        cube.sphere(rocketX,rocketY,rocketZ,radius, rocketColor);
-    if(exploded)
-         cube.shell(rocketX,rocketY,rocketZ,radius,fireworkColor);
-
-        if(exploded)
-            radius+=speed;  //the sphere gets bigger
-        if(showRocket)
+    //launch a rocket every so often, several can be in the air at once
+    if(--nextLaunch<=0 && rocketCount<MAX_ROCKETS)
+    {
+        launchRocket();
+        nextLaunch=20+rand()%40;
+    }
+
+    for(int i=0;i<rocketCount;)
+    {
+        Rocket &rocket=rockets[i];
+        rocket.trail.position+=rocket.step;
+        sparks.emit(rocket.trail);
+        if(--rocket.stepsLeft>0)
         {
-            rocketX+=xInc;
-            rocketY+=yInc;
-            rocketZ+=zInc;
+            i++;
+            continue;
         }
-        //if our sphere gets too large, restart the animation in another random spot
-        if(radius>maxSize)
-            prepRocket();
-        if(abs(distance(centerX,centerY,centerZ,rocketX, rocketY, rocketZ)-radius)<2)
-		{
-			showRocket=false;
-			exploded=true;
-		}
-}
+        //it's reached the top: burst into a ball of sparks of a random color
+        burst.position=rocket.trail.position;
+        burst.color=CHSV(rand()%256, 255, 2*maxBrightness);
+        burst.life=40+rand()%40;
+        sparks.burst(burst, SPARKS_PER_BURST);
+        rockets[i]=rockets[--rocketCount];
+    }
 
-float distance(float x, float y, float z, float x1, float y1, float z1)
-{
-    return(sqrt(pow(x-x1,2)+pow(y-y1,2)+pow(z-z1,2)));
+    sparks.step();
 }
 
-void prepRocket()
+void launchRocket()
 {
-	radius=0;
-	centerX=rand()%8;
-	centerY=rand()%8;
-	centerZ=rand()%8;
-	fireworkColor.red=rand()%brightness;
-	fireworkColor.green=rand()%brightness;
-	fireworkColor.blue=rand()%brightness;
-	launchX=rand()%8;
-	launchZ=rand()%8;
-	rocketX=launchX;
-	rocketY=0;
-	rocketZ=launchZ;
-	launchTime=15+rand()%25;
-	xInc=(centerX-rocketX)/launchTime;
-	yInc=(centerY-rocketY)/launchTime;
-	zInc=(centerZ-rocketZ)/launchTime;
-	showRocket=true;
-	exploded=false;
-	speed=0.15;
-	maxSize=2+rand()%6;
-	//speed=rand()%5;
-	//speed*=0.1;
+    Rocket &rocket=rockets[rocketCount++];
+    int launchTime=15+rand()%25;
+    PointQ target((2+rand()%4)*POINTQ_ONE, (2+rand()%4)*POINTQ_ONE, (4+rand()%4)*POINTQ_ONE);
+    rocket.trail.position=PointQ((rand()%8)*POINTQ_ONE, (rand()%8)*POINTQ_ONE, 0);
+    rocket.step=PointQ((target.x-rocket.trail.position.x)/launchTime,
+                       (target.y-rocket.trail.position.y)/launchTime,
+                       (target.z-rocket.trail.position.z)/launchTime);
+    rocket.stepsLeft=launchTime;
 }
 
 void initFireworks()
 {
-    rocketColor.red=255;
-    rocketColor.green=150;
-    rocketColor.blue=100;
-    prepRocket();
+    //the trail drifts down and dies out quickly
+    for(int i=0;i<MAX_ROCKETS;i++)
+    {
+        ParticleEmitter &trail=rockets[i].trail;
+        trail.rate=POINTQ_ONE;  //a spark every step
+        trail.vz=-PARTICLE_VELOCITY_ONE/32;
+        trail.spread=PARTICLE_VELOCITY_ONE/64;
+        trail.life=12;
+        trail.color=CRGB(120,70,50);
+        trail.colorSpread=30;
+    }
+    //the sparks fly out, slow down and fall
+    burst.spread=PARTICLE_VELOCITY_ONE/5;
+    burst.colorSpread=20;
+    sparks.setGravity(0, 0, -6);
+    sparks.setDrag(2500);
 }
 
 void initSquarral() 
 {
   position={0,0,0};
   increment={1,0,0};
+  //the six ways the spiral can be laid into the cube
+  squarralAxes[1].permute(AXIS_Z, AXIS_X, AXIS_Y);
+  squarralAxes[2].permute(AXIS_Y, AXIS_Z, AXIS_X);
+  squarralAxes[3].permute(AXIS_Z, AXIS_X, AXIS_Y);
+  squarralAxes[3].mirror(AXIS_Y);
+  squarralAxes[4].permute(AXIS_Y, AXIS_Z, AXIS_X);
+  squarralAxes[4].mirror(AXIS_Z);
+  squarralAxes[5].mirror(AXIS_Y);
 }
 
-void squarral() 
+void squarral(Cube &cube) 
 {
     add(position, increment);
     if((increment.x==1)&&(position.x==cube.size-1-bound))
@@ -338,38 +327,7 @@ void squarral()
     trailPoints[0].x=pixel.x;
     trailPoints[0].y=pixel.y;
     trailPoints[0].z=pixel.z;
-    switch(axis){
-        case(0):
-            pixel.x=position.x;
-            pixel.y=position.y;
-            pixel.z=position.z;
-            break;
-        case(1):
-            pixel.x=position.z;
-            pixel.y=position.x;
-            pixel.z=position.y;
-            break;
-        case(2):
-            pixel.x=position.y;
-            pixel.y=position.z;
-            pixel.z=position.x;
-            break;
-        case(3):
-            pixel.x=position.z;
-            pixel.y=cube.size-1-position.x;
-            pixel.z=position.y;
-            break;
-        case(4):
-            pixel.x=position.y;
-            pixel.y=position.z;
-            pixel.z=cube.size-1-position.x;
-            break;
-        case(5):
-            pixel.x=position.x;
-            pixel.y=cube.size-1-position.y;
-            pixel.z=position.z;
-            break;
-    }
+    pixel=squarralAxes[axis].map(position);
         
     voxelColor=cube.colorMap(frame%1000,0,1000);
     cube.setVoxel((int)pixel.x, (int)pixel.y, (int)pixel.z, voxelColor);
@@ -407,7 +365,7 @@ void add(Point& a, Point& b)
  * zplasma functions *
  * *****************************/
  
-void zPlasma()
+void zPlasma(Cube &cube)
 {
 	phase += phaseIncrement;
 	// The two points move along Lissajious curves, see: http://en.wikipedia.org/wiki/Lissajous_curve
@@ -468,121 +426,30 @@ void zPlasma()
 /********************************************
  *   FFT JOY functions
  * *****************************************/
- void FFTJoy()
+ void FFTJoy(Cube &cube)
  {
-    for(int i=0;i<pow(2,M);i++)
-    {
-        real[i]=analogRead(MICROPHONE)-2048;
-        delayMicroseconds(212);  //this sets our 'sample rate'.  I went through a bunch of trial and error to 
-                                //find a good sample rate to put a soprano's vocal range in the spectrum of the cube
-      //  Serial.print(real[i]);
-        imaginary[i]=0;
-    }
-    FFT(1, M, real, imaginary);
-    for(int i=0;i<pow(2,M);i++)
+    analyzer.sample(MICROPHONE, SPECTRUM_POINTS, SPECTRUM_INTERVAL);
+    analyzer.analyze();
+    Color peakColor;
+    peakColor.red=maxBrightness;
+    peakColor.green=maxBrightness;
+    peakColor.blue=maxBrightness;
+    for(int i=0;i<analyzer.bands();i++)
     {
-        imaginary[i]=sqrt(pow(imaginary[i],2)+pow(real[i],2));
-//        Serial.print(imaginary[i]);
-        if(imaginary[i]>maxValue)
-            maxValue=imaginary[i];
-    }
-    if(maxValue>100)
-        maxValue--;
-//    Serial.println();
-    for(int i=0;i<pow(2,M)/2;i++)
-    {
-        imaginary[i]=cube.size*imaginary[i]/maxValue;
+        int level=analyzer.level(i,cube.size-1);
+        int peak=analyzer.peakLevel(i,cube.size-1);
         int y;
-        for(y=0;y<=imaginary[i];y++)
+        for(y=0;y<=level;y++)
             cube.setVoxel(i,y,cube.size-1,cube.colorMap(y,0,cube.size));
         for(;y<cube.size;y++)
             cube.setVoxel(i,y,cube.size-1,Black);
+        //the peak of the band hangs above it for a moment before it falls
+        if(peak>level)
+            cube.setVoxel(i,peak,cube.size-1,peakColor);
     }
-    for(int z=0;z<cube.size-1;z++)
-        for(int x=0;x<cube.size;x++)
-            for(int y=0;y<cube.size;y++)
-            {
-                Color col=cube.getVoxel(x,y,z+1);
-                cube.setVoxel(x,y,z,col);
-//                char output[50];
-//                sprintf(output, "%d %d %d:  %d %d %d", x,y,z+1, col.red, col.green, col.blue);
-//                Serial.println(output);
-            }
-
-    sample++;
-    if(sample>=pow(2,M))
-        sample-=pow(2,M);
-}
-
-
-short FFT(short int dir,int m,float *x,float *y)
-{
-   int n,i,i1,j,k,i2,l,l1,l2;
-   float c1,c2,tx,ty,t1,t2,u1,u2,z;
-
-   /* Calculate the number of points */
-   n = 1;
-   for (i=0;i<m;i++) 
-      n *= 2;
-
-   /* Do the bit reversal */
-   i2 = n >> 1;
-   j = 0;
-   for (i=0;i<n-1;i++) {
-      if (i < j) {
-         tx = x[i];
-         ty = y[i];
-         x[i] = x[j];
-         y[i] = y[j];
-         x[j] = tx;
-         y[j] = ty;
-      }
-      k = i2;
-      while (k <= j) {
-         j -= k;
-         k >>= 1;
-      }
-      j += k;
-   }
-
-   /* Compute the FFT */
-   c1 = -1.0; 
-   c2 = 0.0;
-   l2 = 1;
-   for (l=0;l<m;l++) {
-      l1 = l2;
-      l2 <<= 1;
-      u1 = 1.0; 
-      u2 = 0.0;
-      for (j=0;j<l1;j++) {
-         for (i=j;i<n;i+=l2) {
-            i1 = i + l1;
-            t1 = u1 * x[i1] - u2 * y[i1];
-            t2 = u1 * y[i1] + u2 * x[i1];
-            x[i1] = x[i] - t1; 
-            y[i1] = y[i] - t2;
-            x[i] += t1;
-            y[i] += t2;
-         }
-         z =  u1 * c1 - u2 * c2;
-         u2 = u1 * c2 + u2 * c1;
-         u1 = z;
-      }
-      c2 = sqrt((1.0 - c1) / 2.0);
-      if (dir == 1) 
-         c2 = -c2;
-      c1 = sqrt((1.0 + c1) / 2.0);
-   }
-
-   /* Scaling for forward transform */
-   if (dir == 1) {
-      for (i=0;i<n;i++) {
-         x[i] /= n;
-         y[i] /= n;
-      }
-   }
-
-   return(0);
+    //scroll the spectrum one slab down, keeping the newest one on top
+    cube.translate(0,0,-1);
+    cube.copySlice(cube.size-2,cube.size-1);
 }
 
 
@@ -592,99 +459,34 @@ short FFT(short int dir,int m,float *x,float *y)
  
  void checkFlipState()
  {
-    updateAccelerometer();
-    /*
-    if(accelerometer[2]<UPSIDE_DOWN)  //if the cube is upside-down, set the upside-down flag and mark the time when it was flipped
-    {
-        upsideDownTime=millis();
-  //      Serial.println("I'm upside-down!");
-    }
-    */
-    if(accelerometer[0]>FACEPLANT)  //if the cube is upside-down, set the upside-down flag and mark the time when it was flipped
-    {
-        lastFaceplant=millis();
-  //      Serial.println("I'm upside-down!");
-    }
-    if(accelerometer[1]<LEFT_SIDE)  //if the cube is flipped to either side
-    {
-        lastLeft=millis();
-//        Serial.println("I'm on my left side");
-    }
-    if(accelerometer[1]>RIGHT_SIDE)
-    {
-        lastRight=millis();
-  //      Serial.println("I'm on my right side");
-    }
-
-    if(accelerometer[2]>RIGHTSIDE_UP)
+    motion.update();
+    int event;
+    while((event=motion.nextEvent())!=MOTION_NONE)
     {
-        if(((millis()-lastFaceplant)<FLIP_TIMEOUT)&&(millis()-lastFaceplant>FLIP_DEBOUNCE))
+        if(event==MOTION_FLIP)  //the cube was put on its face and back upright: toggle autocycle
         {
             autoCycle=!autoCycle;
-            lastFaceplant=millis()-FLIP_TIMEOUT;
+            demos.setAutoAdvance(autoCycle);
+            demos.setTransition(AUTOCYCLE_FADE_TIME);
             Color flash;
             flash.red=maxBrightness;
             flash.green=maxBrightness;
             flash.blue=maxBrightness;
             cube.background(flash);
         }
-        if(((millis()-lastLeft)<FLIP_TIMEOUT)&&(millis()-lastChange>FLIP_DEBOUNCE))
+        if(event==MOTION_TILT_LEFT)  //turned to the left and back
         {
-    //        Serial.println("turned to the left and back");
             autoCycle=false;
-            lastChange=millis();
-            decrementDemo();
-            lastLeft=millis()-FLIP_TIMEOUT;
+            demos.setAutoAdvance(false);
+            demos.setTransition(MANUAL_FADE_TIME);
+            demos.previous();
         }
-        if(((millis()-lastRight)<FLIP_TIMEOUT)&&(millis()-lastChange>FLIP_DEBOUNCE))
+        if(event==MOTION_TILT_RIGHT)  //turned to the right and back
         {
-       //     Serial.println("turned to the right and back");
             autoCycle=false;
-            lastChange=millis();
-            incrementDemo();
-            lastRight=millis()-FLIP_TIMEOUT;
+            demos.setAutoAdvance(false);
+            demos.setTransition(MANUAL_FADE_TIME);
+            demos.next();
         }
     }
-    
-    if(autoCycle)
-        if(millis()-lastAutoCycle>AUTOCYCLE_TIME)   //in autocycle, change demos every 15 seconds
-        {
-            incrementDemo();
-//            Serial.print("autocycling...Demo is ");
-//            Serial.println(demo);
-            lastAutoCycle=millis();
-        }
-        
  }
- 
-void updateAccelerometer()
-{
-    for(int i=0;i<3;i++)
-        accelerometer[i]=analogRead(X+i);
-}
-
-void setFadeSpeed()
-{
-    if(autoCycle)
-        fadeSpeed=2;
-    else
-        fadeSpeed=20;
-}
- 
- void incrementDemo()
- {
-     demo++;
-     setFadeSpeed();
-     fading=true;
-     if(demo>=DEMO_ROUTINES)
-        demo=0;
- }
- 
-  void decrementDemo()
- {
-     demo--;
-     setFadeSpeed();
-     fading=true;
-     if(demo<0)
-        demo=DEMO_ROUTINES-1;
- }
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include <math.h>
+#include "beta-cube-library-fastled.h"
+#include "benchmark.h"
+
+// Checks that the integer sphere and shell rasterizers in the library light exactly the same voxels
+// as the original floating point versions, and reports how long each version takes per call.
+// Results are printed over Serial, one line per test.
+
+Cube cube=Cube();
+Color reference[PIXEL_COUNT];
+Color onColor=Color(50, 50, 50);
+
+/** The original filled sphere: a sqrt for every voxel of the (2r+1)^3 box around the center. */
+void referenceSphere(int x, int y, int z, int r, Color col)
+{
+	for(int dx = -r; dx <= r; dx++)
+		for(int dy = -r; dy <= r; dy++)
+			for(int dz = -r; dz <= r; dz++)
+				if(sqrt(dx*dx + dy*dy + dz*dz) <= r) {
+					int i = x + dx, j = y + dy, k = z + dz;
+					if(i >= 0 && j >= 0 && k >= 0 && i < cube.size && j < cube.size && k < cube.size)
+						reference[(k*cube.size*cube.size) + (i*cube.size) + j] = col;
+				}
+}
+
+/** The original shell: three pow() calls and a sqrt for every voxel of the cube. */
+void referenceShell(float x, float y, float z, float r, float thickness, Color col)
+{
+	for(int i=0;i<cube.size;i++)
+		for(int j=0;j<cube.size;j++)
+			for(int k=0;k<cube.size;k++)
+				if(abs(sqrt(pow(i-x,2)+pow(j-y,2)+pow(k-z,2))-r)<thickness)
+					reference[(k*cube.size*cube.size) + (i*cube.size) + j] = col;
+}
+
+void resetAll()
+{
+	for(int i = 0; i < PIXEL_COUNT; i++)
+		reference[i] = Black;
+	cube.fade(1.0f, false);		// clears without sending a frame to the LEDs
+}
+
+/** Count the voxels where the cube and the reference disagree. */
+int mismatches()
+{
+	int count = 0;
+	for(int i = 0; i < PIXEL_COUNT; i++)
+		if(cube.getVoxel(i) != reference[i])
+			count++;
+	return count;
+}
+
+void report(const char *name, int calls, int errors, unsigned long referenceMicros, unsigned long integerMicros)
+{
+	Serial.printf("%s calls=%d mismatches=%d float_us_per_call=%.2f int_us_per_call=%.2f\n",
+			name, calls, errors, (float)referenceMicros / calls, (float)integerMicros / calls);
+}
+
+void benchmarkSpheres()
+{
+	int calls = 0, errors = 0;
+	unsigned long referenceMicros = 0, integerMicros = 0;
+	for(int r = 0; r <= 6; r++)
+		for(int x = -2; x < cube.size + 2; x++)
+			for(int y = -2; y < cube.size + 2; y += 3)
+				for(int z = -2; z < cube.size + 2; z += 3) {
+					resetAll();
+					unsigned long start = benchmarkMicros();
+					referenceSphere(x, y, z, r, onColor);
+					referenceMicros += benchmarkMicros() - start;
+					start = benchmarkMicros();
+					cube.sphere(x, y, z, r, onColor);
+					integerMicros += benchmarkMicros() - start;
+					errors += mismatches();
+					calls++;
+				}
+	report("sphere", calls, errors, referenceMicros, integerMicros);
+}
+
+void benchmarkShells(float thickness)
+{
+	int calls = 0, errors = 0;
+	unsigned long referenceMicros = 0, integerMicros = 0;
+	// radii grow in the same steps as the fireworks demo
+	for(float r = 0; r <= 7; r += 0.15)
+		for(float x = -1.3; x < cube.size + 1; x += 1.37)
+			for(float y = -0.8; y < cube.size; y += 2.21)
+				for(float z = 0.5; z < cube.size; z += 3.1) {
+					resetAll();
+					unsigned long start = benchmarkMicros();
+					referenceShell(x, y, z, r, thickness, onColor);
+					referenceMicros += benchmarkMicros() - start;
+					start = benchmarkMicros();
+					cube.shell(x, y, z, r, thickness, onColor);
+					integerMicros += benchmarkMicros() - start;
+					errors += mismatches();
+					calls++;
+				}
+	report(thickness < 0.2 ? "shell_thin" : "shell_thick", calls, errors, referenceMicros, integerMicros);
+}
+
+void setup() {
+	Serial.begin(9600);
+	cube.begin();
+	benchmarkSpheres();
+	benchmarkShells(0.1);
+	benchmarkShells(0.6);
+}
+
+void loop() {
+}
@@ -20,6 +20,18 @@ CLEDController *CLEDController::m_pHead = NULL;
 CLEDController *CLEDController::m_pTail = NULL;
 static uint32_t lastshow = 0;
 
+// wait until minMicros have passed since the last frame, sleeping through whole milliseconds so the
+// system keeps running instead of spinning on micros() for all of it
+static void waitForRefresh(uint32_t minMicros) {
+	uint32_t elapsed = micros() - lastshow;
+	if(elapsed < minMicros) {
+		uint32_t rest = minMicros - elapsed;
+		if(rest >= 1000) { ::delay(rest / 1000); }
+		delayMicroseconds(rest % 1000);
+	}
+	lastshow = micros();
+}
+
 // uint32_t CRGB::Squant = ((uint32_t)((__TIME__[4]-'0') * 28))<<16 | ((__TIME__[6]-'0')*50)<<8 | ((__TIME__[7]-'0')*28);
 
 CFastLED::CFastLED() {
@@ -43,8 +55,7 @@ CLEDController &CFastLED::addLeds(CLEDController *pLed,
 
 void CFastLED::show(uint8_t scale) {
 	// guard against showing too rapidly
-	while(m_nMinMicros && ((micros()-lastshow) < m_nMinMicros));
-	lastshow = micros();
+	waitForRefresh(m_nMinMicros);
 
 	CLEDController *pCur = CLEDController::head();
 	while(pCur) {
@@ -80,8 +91,7 @@ CLEDController & CFastLED::operator[](int x) {
 }
 
 void CFastLED::showColor(const struct CRGB & color, uint8_t scale) {
-	while(m_nMinMicros && ((micros()-lastshow) < m_nMinMicros));
-	lastshow = micros();
+	waitForRefresh(m_nMinMicros);
 
 	CLEDController *pCur = CLEDController::head();
 	while(pCur) {
@@ -0,0 +1,56 @@
+#ifndef _L3D_BENCHMARK_H
+#define _L3D_BENCHMARK_H
+
+/**   Clocks for timing code in benchmarks.
+      On the device benchmarkTicks() reads the DWT cycle counter. The clockless LED driver uses the
+      same counter and resets it while it clocks out a frame, so code that calls show() has to be timed
+      with benchmarkMicros() instead. On the host both read the monotonic clock: micros() there is the
+      virtual clock of the simulation, which only moves when the sketch delays or shows a frame.
+*/
+
+#include "FastLED.h"
+
+#if defined(FASTLED_HOST_PLATFORM)
+#include <time.h>
+
+inline void benchmarkBegin(void) { }
+
+/** Current time in ticks of the fastest clock available. */
+inline uint32_t benchmarkTicks(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint32_t)((uint64_t)t.tv_sec * 1000000000ULL + t.tv_nsec);
+}
+
+/** Length of a number of ticks in nanoseconds. */
+inline float benchmarkTicksToNanos(uint32_t ticks) { return ticks; }
+
+/** Current time in microseconds, for code that calls show(). */
+inline uint32_t benchmarkMicros(void) { return benchmarkTicks() / 1000; }
+
+#define BENCHMARK_PLATFORM "host"
+
+#else
+
+/** Enable the cycle counter. */
+inline void benchmarkBegin(void)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+/** Current time in ticks of the fastest clock available. */
+inline uint32_t benchmarkTicks(void) { return DWT->CYCCNT; }
+
+/** Length of a number of ticks in nanoseconds. */
+inline float benchmarkTicksToNanos(uint32_t ticks) { return ticks * (1000.0f / (F_CPU / 1000000)); }
+
+/** Current time in microseconds, for code that calls show(). */
+inline uint32_t benchmarkMicros(void) { return micros(); }
+
+#define BENCHMARK_PLATFORM "photon"
+
+#endif
+
+#endif
@@ -1,8 +1,35 @@
 #include <math.h>
 #include "beta-cube-library-fastled.h"
+#include "cube-raster.h"
+#include "cube-motion.h"
+
+/** Rasterizer sink that writes straight into an LED buffer. */
+struct LedSink {
+  CRGB *leds;
+  CRGB color;
+
+  LedSink(CRGB *leds, Color col) : leds(leds), color(col.red, col.green, col.blue) {}
+
+  void plot(int x, int y, int z) {
+    if(Cube::contains(x, y, z))
+      this->leds[Cube::index(x, y, z)] = this->color;
+  }
+  void set(int x, int y, int z) { this->leds[Cube::index(x, y, z)] = this->color; }
+  void span(int x, int z, int y0, int y1) {
+    CRGB *row = &this->leds[Cube::index(x, 0, z)];
+    for(int y = y0; y <= y1; y++)
+      row[y] = this->color;
+  }
+};
+
+/** The stops of the default color map: blue, cyan, green, yellow, red, magenta and back to blue. */
+static const Color defaultColorMapStops[6] = {
+  Color(0, 0, 255), Color(0, 255, 255), Color(0, 255, 0), Color(255, 255, 0), Color(255, 0, 0), Color(255, 0, 255)
+};
 
 /** Construct a new cube.
-  @param s Size of one side of the cube in number of LEDs.
+  @param s Size of one side of the cube in number of LEDs. Only kept for compatibility: the size is
+  set at compile time by CUBE_SIZE.
   @param mb Maximum brightness value. Used to prevent the LEDs from drawing too much current (which causes the colors to distort).
 
   @return A new Cube object.
@@ -11,7 +38,22 @@ Cube::Cube(unsigned int s, unsigned int mb) : \
     maxBrightness(mb),
     onlinePressed(false),
     lastOnline(true),
-    size(s)
+    leds(buffers[0]),
+    frontLeds(buffers[1]),
+    controller(NULL),
+    doubleBuffered(false),
+    preserveBackBuffer(false),
+    dirty(&regions[0]),
+    frontDirty(&regions[1]),
+    wiring(NULL),
+    baseWiring(NULL),
+    upright(false),
+    motion(NULL),
+    target(NULL),
+    colorMapStops(defaultColorMapStops),
+    colorMapStopCount(6),
+    colorMapPalette(NULL),
+    colorMapBrightness(-1)
 { }
 
 /** Construct a new cube with default settings.
@@ -24,14 +66,30 @@ Cube::Cube() : \
     maxBrightness(50),
     onlinePressed(false),
     lastOnline(true), 
-    size(8)
+    leds(buffers[0]),
+    frontLeds(buffers[1]),
+    controller(NULL),
+    doubleBuffered(false),
+    preserveBackBuffer(false),
+    dirty(&regions[0]),
+    frontDirty(&regions[1]),
+    wiring(NULL),
+    baseWiring(NULL),
+    upright(false),
+    motion(NULL),
+    target(NULL),
+    colorMapStops(defaultColorMapStops),
+    colorMapStopCount(6),
+    colorMapPalette(NULL),
+    colorMapBrightness(-1)
 { }
 
 /** Initialization of cube resources and environment. */
 void Cube::begin(void) 
 {
   center=Point((this->size-1)/2,(this->size-1)/2,(this->size-1)/2);
-  LEDS.addLeds<PIXEL_TYPE,PIXEL_PIN,COLOR_ORDER>(this->leds,PIXEL_COUNT);
+  this->controller = &LEDS.addLeds<PIXEL_TYPE,PIXEL_PIN,COLOR_ORDER>(this->leds,PIXEL_COUNT);
+  this->bindOutput();
   
   //initialize Particle variables
   int (Cube::*setPort)(String) = &Cube::setPort;
@@ -53,10 +111,9 @@ void Cube::begin(void)
   */
 void Cube::setVoxel(int x, int y, int z, Color col)
 {
-  if(x >= 0 && y >= 0 && z >= 0 &&
-      x < this->size && y < this->size && z < this->size) {
-    int index = (z*this->size*this->size) + (x*this->size) + y;
-	this->leds[index] = CRGB(col.red, col.green, col.blue);
+  if(contains(x, y, z)) {
+	this->leds[index(x, y, z)] = CRGB(col.red, col.green, col.blue);
+	this->dirty->include(x, y, z);
   }
 }
 
@@ -68,6 +125,7 @@ void Cube::setVoxel(int x, int y, int z, Color col)
 void Cube::setVoxel(int index, Color col)
 {
 	this->leds[index] = CRGB(col.red, col.green, col.blue);
+	this->dirty->include(indexX(index), indexY(index), indexZ(index));
 }
 
 /** Set a voxel at a position to a color.
@@ -80,6 +138,16 @@ void Cube::setVoxel(Point p, Color col)
   this->setVoxel(p.x, p.y, p.z, col);
 }
 
+/** Set a voxel at a fixed point position to a color.
+
+  @param p Coordinate of the LED to set; the voxel it is in is set.
+  @param col Color to set the LED to.
+  */
+void Cube::setVoxel(PointQ p, Color col)
+{
+  this->setVoxel(p.voxelX(), p.voxelY(), p.voxelZ(), col);
+}
+
 /** Get the color of a voxel at a position.
 
   @param index Coordinate of the LED to get the color from.
@@ -96,8 +164,8 @@ Color Cube::getVoxel(int index)
   */
 Color Cube::getVoxel(int x, int y, int z)
 {
-  int index = (z * this->size * this->size) + (x * this->size) + y;
-  Color pixelColor = Color(this->leds[index].r, this->leds[index].g, this->leds[index].b);
+  int i = index(x, y, z);
+  Color pixelColor = Color(this->leds[i].r, this->leds[i].g, this->leds[i].b);
   return pixelColor;
 }
 
@@ -110,6 +178,15 @@ Color Cube::getVoxel(Point p)
   return this->getVoxel(p.x, p.y, p.z);
 }
 
+/** Get the color of a voxel at a fixed point position.
+
+  @param p Coordinate of the LED to get the color from.
+  */
+Color Cube::getVoxel(PointQ p)
+{
+  return this->getVoxel(p.voxelX(), p.voxelY(), p.voxelZ());
+}
+
 /** Draw a line in 3D space.
   Uses the 3D form of Bresenham's algorithm.
 
@@ -119,102 +196,261 @@ Color Cube::getVoxel(Point p)
   */
 void Cube::line(int x1, int y1, int z1, int x2, int y2, int z2, Color col)
 {
-  Point currentPoint = Point(x1, y1, z1);
-
-  int dx = x2 - x1;
-  int dy = y2 - y1;
-  int dz = z2 - z1;
-  int x_inc = (dx < 0) ? -1 : 1;
-  int l = abs(dx);
-  int y_inc = (dy < 0) ? -1 : 1;
-  int m = abs(dy);
-  int z_inc = (dz < 0) ? -1 : 1;
-  int n = abs(dz);
-  int dx2 = l << 1;
-  int dy2 = m << 1;
-  int dz2 = n << 1;
-
-  if((l >= m) && (l >= n)) {
-    int err_1 = dy2 - l;
-    int err_2 = dz2 - l;
-
-    for(int i = 0; i < l; i++) {
-      this->setVoxel(currentPoint, col);
-
-      if(err_1 > 0) {
-        currentPoint.y += y_inc;
-        err_1 -= dx2;
-      }
+  this->markDirty(x1, y1, z1, x2, y2, z2);
+  LedSink sink(this->leds, col);
+  rasterLine(x1, y1, z1, x2, y2, z2, sink);
+}
 
-      if(err_2 > 0) {
-        currentPoint.z += z_inc;
-        err_2 -= dx2;
-      }
+/** Draw a line in 3D space.
+  Uses the 3D form of Bresenham's algorithm.
 
-      err_1 += dy2;
-      err_2 += dz2;
-      currentPoint.x += x_inc;
-    }
-  } else if((m >= l) && (m >= n)) {
-    int err_1 = dx2 - m;
-    int err_2 = dz2 - m;
+  @param p1 Coordinate of start of line.
+  @param p2 Coordinate of end of line.
+  @param col Color of the line.
+  */
+void Cube::line(Point p1, Point p2, Color col)
+{
+  this->line(p1.x, p1.y, p1.z, p2.x, p2.y, p2.z, col);
+}
 
-    for(int i = 0; i < m; i++) {
-      this->setVoxel(currentPoint, col);
+/** Draw a line in 3D space between the voxels two fixed point positions are in.
+  Uses the 3D form of Bresenham's algorithm.
 
-      if(err_1 > 0) {
-        currentPoint.x += x_inc;
-        err_1 -= dy2;
-      }
+  @param p1 Coordinate of start of line.
+  @param p2 Coordinate of end of line.
+  @param col Color of the line.
+  */
+void Cube::line(PointQ p1, PointQ p2, Color col)
+{
+  this->line(p1.voxelX(), p1.voxelY(), p1.voxelZ(), p2.voxelX(), p2.voxelY(), p2.voxelZ(), col);
+}
 
-      if(err_2 > 0) {
-        currentPoint.z += z_inc;
-        err_2 -= dy2;
-      }
+/** Add a fraction of a color to a voxel, if it is inside the cube.
 
-      err_1 += dx2;
-      err_2 += dz2;
-      currentPoint.y += y_inc;
-    }
+  @param weight Fraction of the color, 0 to 256.
+  @param blend BLEND_ADD to add the color to the voxel, BLEND_MAX to keep the brighter of each channel.
+*/
+void Cube::blendVoxel(int x, int y, int z, CRGB c, int weight, uint8_t blend)
+{
+  if(weight <= 0 || !contains(x, y, z))
+    return;
+  if(weight < 256)
+    c.nscale8(weight);
+  CRGB &voxel = this->leds[index(x, y, z)];
+  if(blend == BLEND_MAX) {
+    if(c.r > voxel.r) voxel.r = c.r;
+    if(c.g > voxel.g) voxel.g = c.g;
+    if(c.b > voxel.b) voxel.b = c.b;
   } else {
-    int err_1 = dy2 - n;
-    int err_2 = dx2 - n;
+    voxel += c;
+  }
+}
 
-    for(int i = 0; i < n; i++) {
-      this->setVoxel(currentPoint, col);
+/** Draw an anti-aliased line between points that need not lie on voxel centers.
+  A 3D form of Wu's algorithm: the line is stepped one voxel at a time along the axis it changes most
+  along, and at each step its color is shared between the four voxels around it across the other two
+  axes, in proportion to how close it passes to each. The voxels at the ends get the part of the color
+  that matches how much of their length the line covers, so a moving line fades from voxel to voxel
+  instead of jumping. The line is clipped to the cube before it is stepped.
 
-      if(err_1 > 0) {
-        currentPoint.y += y_inc;
-        err_1 -= dz2;
-      }
+  @param p1 Start of the line.
+  @param p2 End of the line.
+  @param col Color of the line.
+  @param blend BLEND_ADD to add to what is already drawn, BLEND_MAX to keep the brighter of each channel.
+*/
+void Cube::lineAA(Point p1, Point p2, Color col, uint8_t blend)
+{
+  this->segmentAA(p1, p2, col, blend, false, false);
+}
 
-      if(err_2 > 0) {
-        currentPoint.x += x_inc;
-        err_2 -= dz2;
-      }
+/** Draw a chain of anti-aliased lines through a list of points.
+  With BLEND_ADD the shared ends of two lines add up to the full color; with BLEND_MAX both lines
+  draw the shared end at the full color.
+
+  @param points The points, in order.
+  @param count Number of points.
+  @param col Color of the lines.
+  @param blend BLEND_ADD or BLEND_MAX, as for lineAA.
+*/
+void Cube::polylineAA(const Point *points, int count, Color col, uint8_t blend)
+{
+  for(int i = 0; i + 1 < count; i++)
+    this->segmentAA(points[i], points[i + 1], col, blend,
+        blend == BLEND_MAX && i > 0, blend == BLEND_MAX && i + 2 < count);
+}
 
-      err_1 += dy2;
-      err_2 += dx2;
-      currentPoint.z += z_inc;
+/** Draw an anti-aliased line between fixed point positions, as lineAA does for Points. The line is
+  clipped and stepped in fixed point only.
+
+  @param p1 Start of the line.
+  @param p2 End of the line.
+  @param col Color of the line.
+  @param blend BLEND_ADD to add to what is already drawn, BLEND_MAX to keep the brighter of each channel.
+*/
+void Cube::lineAA(PointQ p1, PointQ p2, Color col, uint8_t blend)
+{
+  this->segmentAA(p1, p2, col, blend, false, false);
+}
+
+/** Draw a chain of anti-aliased lines through a list of fixed point positions, as polylineAA does for
+  Points.
+
+  @param points The points, in order.
+  @param count Number of points.
+  @param col Color of the lines.
+  @param blend BLEND_ADD or BLEND_MAX, as for lineAA.
+*/
+void Cube::polylineAA(const PointQ *points, int count, Color col, uint8_t blend)
+{
+  for(int i = 0; i + 1 < count; i++)
+    this->segmentAA(points[i], points[i + 1], col, blend,
+        blend == BLEND_MAX && i > 0, blend == BLEND_MAX && i + 2 < count);
+}
+
+/** Draw one anti-aliased line for lineAA and polylineAA: clip it, then step it in fixed point.
+
+  @param fullStart, fullEnd Draw that end at the full color instead of by how much of it the line covers.
+*/
+void Cube::segmentAA(Point p1, Point p2, Color col, uint8_t blend, bool fullStart, bool fullEnd)
+{
+  float a[3] = { p1.x, p1.y, p1.z };
+  float d[3] = { p2.x - p1.x, p2.y - p1.y, p2.z - p1.z };
+
+  // clip to the part of space that can light a voxel: within one voxel of the cube on every axis
+  float t0 = 0, t1 = 1;
+  for(int axis = 0; axis < 3; axis++) {
+    float lo = -1 - a[axis], hi = this->size - a[axis];
+    if(d[axis] == 0) {
+      if(lo >= 0 || hi <= 0)
+        return;
+    } else {
+      float ta = lo / d[axis], tb = hi / d[axis];
+      if(ta > tb) { float t = ta; ta = tb; tb = t; }
+      if(ta > t0) t0 = ta;
+      if(tb < t1) t1 = tb;
     }
   }
+  if(t0 > t1)
+    return;
+  if(t0 > 0) fullStart = false;
+  if(t1 < 1) fullEnd = false;
+  int32_t s[3], e[3];
+  for(int axis = 0; axis < 3; axis++) {
+    s[axis] = (int32_t)floor((a[axis] + t0 * d[axis]) * POINTQ_ONE + 0.5f);
+    e[axis] = (int32_t)floor((a[axis] + t1 * d[axis]) * POINTQ_ONE + 0.5f);
+  }
+  this->stepAA(s, e, col, blend, fullStart, fullEnd);
+}
+
+/** Draw one anti-aliased line between fixed point positions for lineAA and polylineAA: clip it in
+  16.16 fixed point, then step it.
 
-  this->setVoxel(currentPoint, col);
+  @param fullStart, fullEnd Draw that end at the full color instead of by how much of it the line covers.
+*/
+void Cube::segmentAA(PointQ p1, PointQ p2, Color col, uint8_t blend, bool fullStart, bool fullEnd)
+{
+  int32_t a[3] = { p1.x, p1.y, p1.z };
+  int32_t d[3] = { p2.x - p1.x, p2.y - p1.y, p2.z - p1.z };
+
+  // clip as for Points, with t from 0 to 65536 along the line
+  const int32_t whole = 65536;
+  int32_t t0 = 0, t1 = whole;
+  for(int axis = 0; axis < 3; axis++) {
+    int32_t lo = -POINTQ_ONE - a[axis], hi = this->size * POINTQ_ONE - a[axis];
+    if(d[axis] == 0) {
+      if(lo >= 0 || hi <= 0)
+        return;
+    } else {
+      int32_t ta = (int32_t)((int64_t)lo * whole / d[axis]), tb = (int32_t)((int64_t)hi * whole / d[axis]);
+      if(ta > tb) { int32_t t = ta; ta = tb; tb = t; }
+      if(ta > t0) t0 = ta;
+      if(tb < t1) t1 = tb;
+    }
+  }
+  if(t0 > t1)
+    return;
+  if(t0 > 0) fullStart = false;
+  if(t1 < whole) fullEnd = false;
+  int32_t s[3], e[3];
+  for(int axis = 0; axis < 3; axis++) {
+    s[axis] = a[axis] + (int32_t)(((int64_t)t0 * d[axis] + whole / 2) >> 16);
+    e[axis] = a[axis] + (int32_t)(((int64_t)t1 * d[axis] + whole / 2) >> 16);
+  }
+  this->stepAA(s, e, col, blend, fullStart, fullEnd);
 }
 
-/** Draw a line in 3D space.
-  Uses the 3D form of Bresenham's algorithm.
+/** Step a clipped anti-aliased line. A 3D form of Wu's algorithm: the line is stepped one voxel at a
+  time along the axis it changes most along, and at each step its color is shared between the four voxels
+  around it across the other two axes, in proportion to how close it passes to each.
 
-  @param p1 Coordinate of start of line.
-  @param p2 Coordinate of end of line.
-  @param col Color of the line.
-  */
-void Cube::line(Point p1, Point p2, Color col)
+  @param s, e Ends of the line in 8.8 fixed point, within one voxel of the cube.
+  @param fullStart, fullEnd Draw that end at the full color instead of by how much of it the line covers.
+*/
+void Cube::stepAA(const int32_t *s0, const int32_t *e0, Color col, uint8_t blend, bool fullStart, bool fullEnd)
 {
-  this->line(p1.x, p1.y, p1.z, p2.x, p2.y, p2.z, col);
+  CRGB c = CRGB(col.red, col.green, col.blue);
+  int32_t s[3], e[3];
+  // the voxels either side of the line, and half a voxel more where the ends are rounded to voxel centers
+  int lo[3], hi[3];
+  for(int axis = 0; axis < 3; axis++) {
+    s[axis] = s0[axis];
+    e[axis] = e0[axis];
+    lo[axis] = (((s[axis] < e[axis]) ? s[axis] : e[axis]) - 128) >> 8;
+    hi[axis] = (((s[axis] < e[axis]) ? e[axis] : s[axis]) + 128 + 255) >> 8;
+  }
+  this->markDirty(lo[0], lo[1], lo[2], hi[0], hi[1], hi[2]);
+
+  // the axis the line changes most along, and the other two
+  int32_t d[3] = { abs(e[0] - s[0]), abs(e[1] - s[1]), abs(e[2] - s[2]) };
+  int major = (d[0] >= d[1] && d[0] >= d[2]) ? 0 : (d[1] >= d[2]) ? 1 : 2;
+  int ua = (major == 0) ? 1 : 0;
+  int va = (major == 2) ? 1 : 2;
+  if(e[major] < s[major]) {
+    for(int axis = 0; axis < 3; axis++) { int32_t t = s[axis]; s[axis] = e[axis]; e[axis] = t; }
+    bool t = fullStart; fullStart = fullEnd; fullEnd = t;
+  }
+  int32_t length = e[major] - s[major];
+
+  // positions in 24.8 fixed point along the major axis, 16.16 across it
+  int32_t m0 = s[major];
+  int32_t m1 = e[major];
+  int first = (m0 + 128) >> 8;
+  int last = (m1 + 128) >> 8;
+  if(first < 0) first = 0;
+  if(last > this->size - 1) last = this->size - 1;
+  int32_t du = length ? (int32_t)(((int64_t)(e[ua] - s[ua]) * 65536) / length) : 0;
+  int32_t dv = length ? (int32_t)(((int64_t)(e[va] - s[va]) * 65536) / length) : 0;
+  int32_t u = s[ua] * 256 + (int32_t)(((int64_t)(first * 256 - m0) * du) >> 8);
+  int32_t v = s[va] * 256 + (int32_t)(((int64_t)(first * 256 - m0) * dv) >> 8);
+
+  int p[3];
+  for(int m = first; m <= last; m++, u += du, v += dv) {
+    // how much of this voxel's length along the major axis the line covers
+    int32_t from = m * 256 - 128, to = m * 256 + 128;
+    if(from < m0 && !fullStart) from = m0;
+    if(to > m1 && !fullEnd) to = m1;
+    int32_t cover = to - from;
+    if(length == 0)
+      cover = 256;
+    if(cover <= 0)
+      continue;
+
+    int iu = u >> 16, iv = v >> 16;
+    int32_t fu = (u >> 8) & 0xff, fv = (v >> 8) & 0xff;
+    p[major] = m;
+    for(int corner = 0; corner < 4; corner++) {
+      int32_t wu = (corner & 1) ? fu : 256 - fu;
+      int32_t wv = (corner & 2) ? fv : 256 - fv;
+      p[ua] = iu + (corner & 1);
+      p[va] = iv + ((corner >> 1) & 1);
+      this->blendVoxel(p[0], p[1], p[2], c, (wu * wv >> 8) * cover >> 8, blend);
+    }
+  }
 }
 
 /** Draw a filled sphere.
+  Rasterized with integers only: each row of the sphere is a span whose half width is the largest
+  w with w*w <= r*r - dz*dz - dx*dx, found by shrinking the width of the previous row.
 
   @param x, y, z Position of the center of the sphere.
   @param r Radius of the sphere.
@@ -222,11 +458,11 @@ void Cube::line(Point p1, Point p2, Color col)
   */
 void Cube::sphere(int x, int y, int z, int r, Color col)
 {
-  for(int dx = -r; dx <= r; dx++)
-    for(int dy = -r; dy <= r; dy++)
-      for(int dz = -r; dz <= r; dz++)
-        if(sqrt(dx*dx + dy*dy + dz*dz) <= r)
-          this->setVoxel(x + dx, y + dy, z + dz, col);
+  if(r < 0)
+    return;
+  this->markDirty(x - r, y - r, z - r, x + r, y + r, z + r);
+  LedSink sink(this->leds, col);
+  rasterSphere<CUBE_SIZE>(x, y, z, r, 0, this->size - 1, sink);
 }
 
 /** Draw a filled sphere.
@@ -240,6 +476,17 @@ void Cube::sphere(Point p, int r, Color col)
   this->sphere(p.x, p.y, p.z, r, col);
 }
 
+/** Draw a filled sphere centered on the voxel a fixed point position is in.
+
+  @param p Position of the center of the sphere.
+  @param r Radius of the sphere.
+  @param col Color of the sphere.
+  */
+void Cube::sphere(PointQ p, int r, Color col)
+{
+  this->sphere(p.voxelX(), p.voxelY(), p.voxelZ(), r, col);
+}
+
 /** Draw a shell (empty sphere).
 
   @param x Position of the center of the shell.
@@ -250,12 +497,7 @@ void Cube::sphere(Point p, int r, Color col)
 */
 void Cube::shell(float x, float y,float z, float r, Color col)
 {
-  float thickness =0.1;
-  for(int i=0;i<size;i++)
-    for(int j=0;j<size;j++)
-      for(int k=0;k<size;k++)
-		if(abs(sqrt(pow(i-x,2)+pow(j-y,2)+pow(k-z,2))-r)<thickness)
-		  this->setVoxel(i,j,k,col);
+  this->shell(x, y, z, r, 0.1, col);
 }
 
 /** Draw a shell (empty sphere).
@@ -269,11 +511,12 @@ void Cube::shell(float x, float y,float z, float r, Color col)
 */
 void Cube::shell(float x, float y,float z, float r, float thickness, Color col)
 {
-  for(int i=0;i<size;i++)
-    for(int j=0;j<size;j++)
-      for(int k=0;k<size;k++) 
-		if(abs(sqrt(pow(i-x,2)+pow(j-y,2)+pow(k-z,2))-r)<thickness)
-		  this->setVoxel(i,j,k,col);
+  int i0, i1, j0, j1, k0, k1;
+  if(!shellBounds<CUBE_SIZE>(x, y, z, r, thickness, i0, i1, j0, j1, k0, k1))
+    return;
+  this->markDirty(i0, j0, k0, i1, j1, k1);
+  LedSink sink(this->leds, col);
+  rasterShell(x, y, z, r, thickness, i0, i1, j0, j1, k0, k1, sink);
 }
 
 /** Draw a shell (empty sphere).
@@ -299,6 +542,77 @@ void Cube::shell(Point p, float r, float thickness, Color col)
   this->shell(p.x, p.y, p.z, r, thickness, col);
 }
 
+/** Draw a shell (empty sphere) in fixed point, with the default thickness of 0.1 voxels (26/256).
+
+  @param p Position of the center of the shell.
+  @param r Radius of the shell, in 8.8 fixed point.
+  @param col Color of the shell.
+*/
+void Cube::shell(PointQ p, int16_t r, Color col)
+{
+  this->shell(p, r, 26, col);
+}
+
+/** Draw a shell (empty sphere) in fixed point.
+  Needs no floating point math, so it is faster than the Point versions on the Photon.
+
+  @param p Position of the center of the shell.
+  @param r Radius of the shell, in 8.8 fixed point.
+  @param thickness Thickness of the shell, in 8.8 fixed point.
+  @param col Color of the shell.
+*/
+void Cube::shell(PointQ p, int16_t r, int16_t thickness, Color col)
+{
+  int i0, i1, j0, j1, k0, k1;
+  if(!shellBoundsQ<CUBE_SIZE>(p, r, thickness, i0, i1, j0, j1, k0, k1))
+    return;
+  this->markDirty(i0, j0, k0, i1, j1, k1);
+  LedSink sink(this->leds, col);
+  rasterShellQ(p, r, thickness, i0, i1, j0, j1, k0, k1, sink);
+}
+
+/** Draw the commands recorded in a list.
+  The list is compiled first if it has changed since it was last drawn. If its runs do not fit in the
+  storage of the list, the commands are drawn one by one instead.
+
+  @param list The commands to draw.
+*/
+void Cube::draw(CubeCommandList &list)
+{
+  if(!list.compiled && !list.overflowed)
+    list.compile();
+  if(!list.compiled) {
+    for(int c = 0; c < list.count; c++) {
+      const CubeCommand &command = list.commands[c];
+      const int16_t *i = command.args.i;
+      const float *f = command.args.f;
+      Color col = Color(command.color.r, command.color.g, command.color.b);
+      switch(command.type) {
+        case CUBE_COMMAND_VOXEL: this->setVoxel(i[0], i[1], i[2], col); break;
+        case CUBE_COMMAND_LINE: {
+          const int16_t *e = command.args.line.ends;
+          this->line(e[0], e[1], e[2], e[3], e[4], e[5], col);
+          break;
+        }
+        case CUBE_COMMAND_SPHERE: this->sphere(i[0], i[1], i[2], i[3], col); break;
+        case CUBE_COMMAND_SHELL: this->shell(f[0], f[1], f[2], f[3], f[4], col); break;
+      }
+    }
+    return;
+  }
+
+  for(int r = 0; r < list.runCount; r++) {
+    const CubeRun &run = list.runs[r];
+    CRGB *out = &this->leds[run.start];
+    for(int n = 0; n < run.length; n++)
+      out[n] = run.color;
+  }
+  if(!list.bounds.isEmpty()) {
+    this->dirty->include(list.bounds.x0, list.bounds.y0, list.bounds.z0);
+    this->dirty->include(list.bounds.x1, list.bounds.y1, list.bounds.z1);
+  }
+}
+
 /** Set the entire cube to one color.
 
   @param col The color to set all LEDs in the cube to.
@@ -307,10 +621,14 @@ void Cube::background(Color col)
 {
   //LEDS.showColor(CRGB(col.red, col.green, col.blue)); 
   //Using for() loop to iteract through the leds[] array is faster than using the FastLED implementation
-  for(int x = 0; x < this->size; x++)
-    for(int y = 0; y < this->size; y++)
-      for(int z = 0; z < this->size; z++)
-        this->setVoxel(x, y, z, col);
+  if(col == Black) {
+    this->clearDirty();
+  } else {
+    CRGB c = CRGB(col.red, col.green, col.blue);
+    for(int i = 0; i < PIXEL_COUNT; i++)
+      this->leds[i] = c;
+    *this->dirty = DirtyRegion(0, 0, 0, this->size - 1, this->size - 1, this->size - 1);
+  }
   this->show();
 }
 
@@ -320,36 +638,446 @@ void Cube::background(Color col)
 */
 void Cube::fade(float coeff, bool show)
 {
-    Color voxelColor;
-	for(int x = 0; x < this->size;x++)
-		for(int y = 0; y < this->size; y++)
-			for(int z = 0; z < this->size; z++)
-			{
-				voxelColor=getVoxel(x,y,z);
-				if(voxelColor.red>0)
-					voxelColor.red-=voxelColor.red*coeff;
-				if(voxelColor.green>0)
-					 voxelColor.green-=voxelColor.green*coeff;
-				if(voxelColor.blue>0)
-					voxelColor.blue-=voxelColor.blue*coeff;
-				this->setVoxel(x,y,z, voxelColor);    
-			}
+	// only voxels inside the dirty region can be lit; shrink the region to the ones that still are
+	DirtyRegion *r = this->dirty;
+	DirtyRegion lit;
+	if(!r->isEmpty())
+		for(int z = r->z0; z <= r->z1; z++)
+			for(int x = r->x0; x <= r->x1; x++)
+				for(int y = r->y0; y <= r->y1; y++)
+				{
+					CRGB &voxel = this->leds[index(x, y, z)];
+					if(voxel.red>0)
+						voxel.red-=voxel.red*coeff;
+					if(voxel.green>0)
+						voxel.green-=voxel.green*coeff;
+					if(voxel.blue>0)
+						voxel.blue-=voxel.blue*coeff;
+					if(voxel)
+						lit.include(x, y, z);
+				}
+	*r = lit;
 	if(show) this->show();
 }
 
-void Cube::fadeall() { for(int i = 0; i < PIXEL_COUNT; i++) { this->leds[i].nscale8(250); } }
+void Cube::fadeall() { this->scaleVolume(250); }
+
+/** Get the part of the cube that has been drawn into since it was last cleared.
+  Voxels outside of this region are guaranteed to be black.
+
+  @return The dirty region of the buffer currently being drawn into.
+*/
+DirtyRegion Cube::getDirtyRegion(void)
+{
+  return *this->dirty;
+}
+
+/** Grow the dirty region by a box, clipped to the cube.
+
+  @param x0, y0, z0 One corner of the box.
+  @param x1, y1, z1 The opposite corner of the box.
+*/
+void Cube::markDirty(int x0, int y0, int z0, int x1, int y1, int z1)
+{
+  int t;
+  if(x0 > x1) { t = x0; x0 = x1; x1 = t; }
+  if(y0 > y1) { t = y0; y0 = y1; y1 = t; }
+  if(z0 > z1) { t = z0; z0 = z1; z1 = t; }
+  if(x1 < 0 || y1 < 0 || z1 < 0 || x0 >= this->size || y0 >= this->size || z0 >= this->size)
+    return;
+  this->dirty->include(x0 < 0 ? 0 : x0, y0 < 0 ? 0 : y0, z0 < 0 ? 0 : z0);
+  this->dirty->include(x1 >= this->size ? this->size - 1 : x1,
+                       y1 >= this->size ? this->size - 1 : y1,
+                       z1 >= this->size ? this->size - 1 : z1);
+}
+
+/** Get the whole drawing buffer, for code that works on all voxels at once.
+  Voxels are in the order of VoxelGrid::index. The whole cube is marked as drawn into. The buffer
+  changes when show() swaps buffers, so get it again after every show().
+
+  @return The PIXEL_COUNT voxels of the buffer being drawn into.
+*/
+CRGB *Cube::voxels(void)
+{
+  this->markDirty(0, 0, 0, this->size - 1, this->size - 1, this->size - 1);
+  return this->leds;
+}
+
+/** Get one slab of the drawing buffer, with x varying slowest and y fastest.
+  The slab is marked as drawn into. Valid until the next show().
+
+  @param z The slab, 0 to size - 1.
+
+  @return The size * size voxels of the slab.
+*/
+CRGB *Cube::slice(int z)
+{
+  this->markDirty(0, 0, z, this->size - 1, this->size - 1, z);
+  return &this->leds[index(0, 0, z)];
+}
+
+/** Get one row of the drawing buffer along y.
+  The row is marked as drawn into. Valid until the next show().
+
+  @param x, z The row, each 0 to size - 1.
+
+  @return The size voxels of the row.
+*/
+CRGB *Cube::row(int x, int z)
+{
+  this->markDirty(x, 0, z, x, this->size - 1, z);
+  return &this->leds[index(x, 0, z)];
+}
+
+/** Fill a box aligned with the axes with a color. The box is clipped to the cube.
+
+  @param x0, y0, z0 One corner of the box.
+  @param x1, y1, z1 The opposite corner of the box, included in it.
+  @param col Color to fill the box with.
+*/
+void Cube::fillBox(int x0, int y0, int z0, int x1, int y1, int z1, Color col)
+{
+  int t;
+  if(x0 > x1) { t = x0; x0 = x1; x1 = t; }
+  if(y0 > y1) { t = y0; y0 = y1; y1 = t; }
+  if(z0 > z1) { t = z0; z0 = z1; z1 = t; }
+  if(x0 < 0) x0 = 0;
+  if(y0 < 0) y0 = 0;
+  if(z0 < 0) z0 = 0;
+  if(x1 >= this->size) x1 = this->size - 1;
+  if(y1 >= this->size) y1 = this->size - 1;
+  if(z1 >= this->size) z1 = this->size - 1;
+  if(x0 > x1 || y0 > y1 || z0 > z1)
+    return;
+  this->markDirty(x0, y0, z0, x1, y1, z1);
+  CRGB c = CRGB(col.red, col.green, col.blue);
+  for(int z = z0; z <= z1; z++) {
+    if(y0 == 0 && y1 == this->size - 1) {
+      // whole rows follow each other in the buffer
+      fill_solid(&this->leds[index(x0, 0, z)], (x1 - x0 + 1) * this->size, c);
+    } else {
+      for(int x = x0; x <= x1; x++)
+        fill_solid(&this->leds[index(x, y0, z)], y1 - y0 + 1, c);
+    }
+  }
+}
+
+/** Copy one slab over another.
+
+  @param fromZ The slab to copy.
+  @param toZ The slab to overwrite. Nothing happens if either slab is outside the cube.
+*/
+void Cube::copySlice(int fromZ, int toZ)
+{
+  if(fromZ == toZ || (unsigned)fromZ >= (unsigned)this->size || (unsigned)toZ >= (unsigned)this->size)
+    return;
+  memcpy8(&this->leds[index(0, 0, toZ)], &this->leds[index(0, 0, fromZ)], sizeof(CRGB) * this->size * this->size);
+  // the copy is only lit where the source was
+  DirtyRegion *r = this->dirty;
+  if(!r->isEmpty() && fromZ >= r->z0 && fromZ <= r->z1)
+    this->markDirty(r->x0, r->y0, toZ, r->x1, r->y1, toZ);
+}
+
+/** Scale every voxel of the cube by the same amount, with FastLED's nscale8.
+  Only the rows inside the dirty region are visited; they follow each other in the buffer within
+  each slab, so each slab is scaled in one call.
+
+  @param scale Fraction to keep, in 256ths: 255 keeps almost all, 0 turns everything off.
+*/
+void Cube::scaleVolume(uint8_t scale)
+{
+  DirtyRegion *r = this->dirty;
+  if(r->isEmpty())
+    return;
+  int count = (r->x1 - r->x0 + 1) * this->size;
+  for(int z = r->z0; z <= r->z1; z++)
+    nscale8(&this->leds[index(r->x0, 0, z)], count, scale);
+}
+
+/** Blend a whole volume of voxels over the cube, with FastLED's nblend.
+
+  @param overlay PIXEL_COUNT voxels in the order of VoxelGrid::index.
+  @param amount How much of the overlay to blend in, 0 to 255.
+*/
+void Cube::blendVolume(const CRGB *overlay, fract8 amount)
+{
+  if(amount == 0)
+    return;
+  this->markDirty(0, 0, 0, this->size - 1, this->size - 1, this->size - 1);
+  nblend(this->leds, const_cast<CRGB *>(overlay), PIXEL_COUNT, amount);
+}
+
+/** Blur the cube, spreading the light of every voxel to its 26 neighbors, with blur3d.
+  Used over several frames it gives glow, smoke and afterglow; like FastLED's blur2d, the light also
+  fades a little with every call.
+
+  @param amount How much to spread: 0 is none, 64 moderate, 172 the most that stays smooth.
+*/
+void Cube::blur(fract8 amount)
+{
+  DirtyRegion *r = this->dirty;
+  if(r->isEmpty())
+    return;
+  blur3d<VoxelGrid<CUBE_SIZE> >(this->leds, this->size, this->size, this->size, amount);
+  // each pass spreads light one voxel further along its axis
+  this->markDirty(r->x0 - 1, r->y0 - 1, r->z0 - 1, r->x1 + 1, r->y1 + 1, r->z1 + 1);
+}
+
+/** Range of one output axis of a transform that a range of its source axis lands on.
+
+  @param t The transform.
+  @param i The output axis.
+  @param lo, hi The range of source coordinates.
+  @param wrap True to wrap the range around the cube, false to clip it to the cube.
+  @param outLo, outHi Set to the range landed on.
+
+  @return False if nothing of the range is left inside the cube.
+*/
+static bool transformRange(const VoxelTransform &t, int i, int lo, int hi, bool wrap, int &outLo, int &outHi)
+{
+  const int n = CUBE_SIZE;
+  int a = t.sign[i] < 0 ? t.offset[i] - hi : t.offset[i] + lo;
+  int b = a + hi - lo;
+  if(wrap) {
+    int w = ((a % n) + n) % n;
+    b += w - a;
+    a = w;
+    if(b >= n) { a = 0; b = n - 1; }	// the range wraps around, so take the whole axis
+  } else {
+    if(a < 0) a = 0;
+    if(b >= n) b = n - 1;
+  }
+  outLo = a;
+  outHi = b;
+  return a <= b;
+}
+
+/** Rotate, mirror or move the whole cube, as described by a VoxelTransform.
+  Voxels are moved in place, each once, by following the cycles of the rearrangement, so no second
+  buffer is needed. The source of every voxel is the sum of one precomputed offset per axis. Moving the
+  cube along z only, without wrapping, shifts whole slabs with memmove instead.
+
+  @param t The rearrangement.
+*/
+void Cube::transform(const VoxelTransform &t)
+{
+  const int n = this->size;
+  DirtyRegion *r = this->dirty;
+  if(r->isEmpty() || t.isIdentity())
+    return;
+
+  // where the lit part of the cube ends up, with and without wrapping
+  int lo[3] = { r->x0, r->y0, r->z0 };
+  int hi[3] = { r->x1, r->y1, r->z1 };
+  int moved[6], kept[6];
+  bool lit = true;
+  for(int i = 0; i < 3; i++) {
+    transformRange(t, i, lo[t.axis[i]], hi[t.axis[i]], true, moved[i], moved[i + 3]);
+    lit &= transformRange(t, i, lo[t.axis[i]], hi[t.axis[i]], t.wrap, kept[i], kept[i + 3]);
+  }
+
+  if(!t.wrap && t.axis[0] == AXIS_X && t.axis[1] == AXIS_Y && t.axis[2] == AXIS_Z &&
+      t.sign[0] > 0 && t.sign[1] > 0 && t.sign[2] > 0 && t.offset[0] == 0 && t.offset[1] == 0) {
+    // a scroll along z: move the lit slabs that stay inside, then clear the ones left behind
+    int dz = t.offset[2];
+    int from = r->z0 > -dz ? r->z0 : -dz;
+    int to = r->z1 < n - 1 - dz ? r->z1 : n - 1 - dz;
+    bool moves = from <= to;
+    if(moves)
+      memmove8(&this->leds[index(0, 0, from + dz)], &this->leds[index(0, 0, from)], sizeof(CRGB) * n * n * (to - from + 1));
+    int rowLength = r->y1 - r->y0 + 1;
+    for(int z = r->z0; z <= r->z1; z++) {
+      if(moves && z >= from + dz && z <= to + dz)
+        continue;
+      for(int x = r->x0; x <= r->x1; x++)
+        memset8(&this->leds[index(x, r->y0, z)], 0, sizeof(CRGB) * rowLength);
+    }
+  } else {
+    // index of the source of each output coordinate, per axis, and whether it lies outside the cube
+    int source[3][CUBE_SIZE];
+    bool outside[3][CUBE_SIZE];
+    for(int i = 0; i < 3; i++) {
+      int stride = index(t.axis[i] == AXIS_X, t.axis[i] == AXIS_Y, t.axis[i] == AXIS_Z);
+      for(int q = 0; q < n; q++) {
+        int c = t.sign[i] < 0 ? t.offset[i] - q : q - t.offset[i];
+        outside[i][q] = (unsigned)c >= (unsigned)n;
+        source[i][q] = (((c % n) + n) % n) * stride;
+      }
+    }
+
+    // with wrapping the rearrangement is a permutation; walk each of its cycles once
+    uint8_t visited[(PIXEL_COUNT + 7) / 8];
+    memset8(visited, 0, sizeof(visited));
+    for(int start = 0; start < PIXEL_COUNT; start++) {
+      if(visited[start >> 3] & (1 << (start & 7)))
+        continue;
+      CRGB first = this->leds[start];
+      int i = start;
+      for(;;) {
+        visited[i >> 3] |= 1 << (i & 7);
+        int from = source[0][indexX(i)] + source[1][indexY(i)] + source[2][indexZ(i)];
+        if(from == start) {
+          this->leds[i] = first;
+          break;
+        }
+        this->leds[i] = this->leds[from];
+        i = from;
+      }
+    }
+
+    // without wrapping, what came in through a face is black instead
+    if(!t.wrap)
+      for(int z = moved[2]; z <= moved[5]; z++)
+        for(int x = moved[0]; x <= moved[3]; x++)
+          for(int y = moved[1]; y <= moved[4]; y++)
+            if(outside[0][x] || outside[1][y] || outside[2][z])
+              this->leds[index(x, y, z)] = CRGB::Black;
+  }
+
+  *r = lit ? DirtyRegion(kept[0], kept[1], kept[2], kept[3], kept[4], kept[5]) : DirtyRegion();
+}
+
+/** Move the whole cube by whole voxels.
+
+  @param dx, dy, dz How far to move it along each axis.
+  @param wrap If true, what moves past a face comes back in through the opposite one. If false, it is
+  lost and what moves in is black.
+*/
+void Cube::translate(int dx, int dy, int dz, bool wrap)
+{
+  VoxelTransform t;
+  t.translate(dx, dy, dz);
+  t.wrap = wrap;
+  this->transform(t);
+}
 
 /** Clear the entire cube.
+
+  @param show If false, the cube is cleared without showing it, e.g. before drawing the next frame.
 */
-void Cube::clear()
+void Cube::clear(bool show)
 {
   //LEDS.clear(true);
   //Using for() loop to iteract through the leds[] array is faster than using the FastLED implementation
-  this->background(Black);
+  if(show)
+    this->background(Black);
+  else
+    this->clearDirty();
+}
+
+/** Turn the drawing buffer black, visiting only the part that was drawn into. */
+void Cube::clearDirty(void)
+{
+  DirtyRegion *r = this->dirty;
+  if(!r->isEmpty()) {
+    int rowLength = r->y1 - r->y0 + 1;
+    for(int z = r->z0; z <= r->z1; z++)
+      for(int x = r->x0; x <= r->x1; x++)
+        memset8(&this->leds[index(x, r->y0, z)], 0, sizeof(CRGB) * rowLength);
+  }
+  *r = DirtyRegion();
+}
+
+/** Draw into a VoxelBuffer instead of the cube's own buffer, e.g. to render several effects and
+  combine them. All drawing methods work on the buffer and its dirty region, and show() does nothing
+  until drawing goes back to the cube.
+
+  @param buffer The buffer to draw into, or NULL to draw into the cube again.
+*/
+void Cube::setTarget(VoxelBuffer *buffer)
+{
+  if(!this->target) {
+    this->ownLeds = this->leds;
+    this->ownDirty = this->dirty;
+  }
+  if(buffer) {
+    this->leds = buffer->leds;
+    this->dirty = &buffer->dirty;
+    buffer->changed = true;
+  } else if(this->target) {
+    this->leds = this->ownLeds;
+    this->dirty = this->ownDirty;
+  }
+  this->target = buffer;
+}
+
+/** Get the buffer being drawn into in place of the cube's own.
+
+  @return The buffer given to setTarget, or NULL if drawing goes to the cube.
+*/
+VoxelBuffer *Cube::getTarget(void)
+{
+  return this->target;
+}
+
+/** Copy what has been drawn into a buffer, with its dirty region.
+
+  @param buffer The buffer to copy into.
+*/
+void Cube::copyTo(VoxelBuffer &buffer)
+{
+  memcpy8(buffer.leds, this->leds, sizeof(buffer.leds));
+  buffer.dirty = *this->dirty;
+  buffer.changed = true;
+}
+
+/** Replace what has been drawn with the contents of a buffer.
+
+  @param buffer The buffer to copy from.
+*/
+void Cube::copyFrom(const VoxelBuffer &buffer)
+{
+  memcpy8(this->leds, buffer.leds, sizeof(buffer.leds));
+  *this->dirty = buffer.dirty;
+}
+
+/** Replace what has been drawn with a mix of two buffers, in one pass with FastLED's blend.
+
+  @param from The buffer shown at amount 0.
+  @param to The buffer shown at amount 255.
+  @param amount How far to go from one to the other, 0 to 255.
+*/
+void Cube::crossFade(const VoxelBuffer &from, const VoxelBuffer &to, fract8 amount)
+{
+  blend(from.leds, to.leds, this->leds, PIXEL_COUNT, amount);
+  DirtyRegion r = from.dirty;
+  if(!to.dirty.isEmpty()) {
+    r.include(to.dirty.x0, to.dirty.y0, to.dirty.z0);
+    r.include(to.dirty.x1, to.dirty.y1, to.dirty.z1);
+  }
+  *this->dirty = r;
+}
+
+/** Input a value 0 to 255 to get a color value.
+	The colours are a transition r - g - b - back to r.
+	The colors are looked up in a table built on the first call.
+
+	@param wheelPos Value to map into a color.
+
+	@return Color from value.
+*/
+Color Cube::Wheel(byte wheelPos) {
+	static CRGBPalette256 table;
+	static bool built = false;
+	if(!built) {
+		for(int i = 0; i < 256; i++) {
+			if(i < 85)
+				table[i] = CRGB(i * 3, 255 - i * 3, 0);
+			else if(i < 170)
+				table[i] = CRGB(255 - (i - 85) * 3, 0, (i - 85) * 3);
+			else
+				table[i] = CRGB(0, (i - 170) * 3, 255 - (i - 170) * 3);
+		}
+		built = true;
+	}
+	const CRGB &c = table[wheelPos];
+	return Color(c.r, c.g, c.b);
 }
 
 /** Input a value 0 to 255 to get a color value.
 	The colours are a transition r - g - b - back to r.
+	The color is looked up in the table of Wheel(wheelPos) and dimmed with scale8, so the only float
+	math is turning the opacity into a fraction of 256 once.
 
 	@param wheelPos Value to map into a color.
 	@param opacity How dim or bright the output color should be
@@ -358,21 +1086,16 @@ void Cube::clear()
 	@return Color from value.
 */
 Color Cube::Wheel(byte wheelPos, float opacity) {
-	if(wheelPos < 85) {
-		return Color((wheelPos * 3) * opacity, (255 - wheelPos * 3) * opacity, 0);
-	}
-	else if(wheelPos < 170) {
-		wheelPos -= 85;
-		return Color((255 - wheelPos * 3) * opacity, 0, (wheelPos * 3) * opacity);
-	}
-	else {
-		wheelPos -= 170;
-		return Color(0, (wheelPos * 3) * opacity, (255 - wheelPos * 3) * opacity);
-    }
+	if(opacity >= 1.0f)
+		return this->Wheel(wheelPos);
+	fract8 scale = (opacity > 0) ? (fract8)(opacity * 256) : 0;
+	Color c = this->Wheel(wheelPos);
+	return Color(scale8(c.red, scale), scale8(c.green, scale), scale8(c.blue, scale));
 }
 
 /** Map a value into a color.
-	The set of colors fades from blue to green to red and back again.
+	The set of colors fades from blue to green to red and back again, or through the gradient set
+	with setColorMap. Values outside min to max wrap around.
 
 	@param val Value to map into a color.
 	@param min Minimum value that val will take.
@@ -382,47 +1105,93 @@ Color Cube::Wheel(byte wheelPos, float opacity) {
 */
 Color Cube::colorMap(float val, float min, float max)
 {
-  const float range = 1024;
-  val = range * (val-min) / (max-min);
-
-  Color colors[6];
-
-  colors[0].red = 0;
-  colors[0].green = 0;
-  colors[0].blue = this->maxBrightness;
-
-  colors[1].red = 0;
-  colors[1].green = this->maxBrightness;
-  colors[1].blue = this->maxBrightness;
-
-  colors[2].red = 0;
-  colors[2].green = this->maxBrightness;
-  colors[2].blue = 0;
-
-  colors[3].red = this->maxBrightness;
-  colors[3].green = this->maxBrightness;
-  colors[3].blue = 0;
-
-  colors[4].red = this->maxBrightness;
-  colors[4].green = 0;
-  colors[4].blue = 0;
-
-  colors[5].red = this->maxBrightness;
-  colors[5].green = 0;
-  colors[5].blue = this->maxBrightness;
-
-  if(val <= range/6)
-    return this->lerpColor(colors[0], colors[1], val, 0, range/6);
-  else if(val <= 2 * range / 6)
-    return(this->lerpColor(colors[1], colors[2], val, range / 6, 2 * range / 6));
-  else if(val <= 3 * range / 6)
-    return(this->lerpColor(colors[2], colors[3], val, 2 * range / 6, 3*range / 6));
-  else if(val <= 4 * range / 6)
-    return(this->lerpColor(colors[3], colors[4], val, 3 * range / 6, 4*range / 6));
-  else if(val <= 5 * range / 6)
-    return(this->lerpColor(colors[4], colors[5], val, 4 * range / 6, 5*range / 6));
-  else
-    return(this->lerpColor(colors[5], colors[0], val, 5 * range / 6, range));
+  float position = COLOR_MAP_SIZE * (val - min) / (max - min);
+  if(!(position >= 0 && position < COLOR_MAP_SIZE)) {
+    position -= floor(position / COLOR_MAP_SIZE) * COLOR_MAP_SIZE;
+    if(!(position >= 0 && position < COLOR_MAP_SIZE))
+      position = 0;
+  }
+  return this->colorMap((int)position);
+}
+
+/** Map a position on the color map into a color, without any floating point math.
+	The table of colors is rebuilt here when maxBrightness or the gradient has changed since it
+	was last built; otherwise this is a single lookup.
+
+	@param position Position on the color map, 0 to COLOR_MAP_SIZE - 1. Other values wrap around.
+
+	@return Color at that position.
+*/
+Color Cube::colorMap(int position)
+{
+  if(this->colorMapBrightness != this->maxBrightness)
+    this->buildColorMap();
+  return this->colorMapTable[position & (COLOR_MAP_SIZE - 1)];
+}
+
+/** Use a gradient through evenly spaced colors for colorMap, from the first color through to the
+	last and back to the first.
+	The colors are kept by reference, so they must stay valid while in use; after changing them, call
+	setColorMap again. Full brightness in the colors is scaled to maxBrightness.
+
+	@param stops The colors of the gradient.
+	@param count Number of colors. If 0 the default gradient is used.
+*/
+void Cube::setColorMap(const Color *stops, int count)
+{
+  if(count <= 0) {
+    stops = defaultColorMapStops;
+    count = 6;
+  }
+  this->colorMapStops = stops;
+  this->colorMapStopCount = count;
+  this->colorMapPalette = NULL;
+  this->colorMapBrightness = -1;
+}
+
+/** Use a FastLED palette for colorMap, each entry covering COLOR_MAP_SIZE / 256 positions.
+	Any palette or gradient palette converts to a CRGBPalette256. The palette is kept by reference, so
+	it must stay valid while in use; after changing it, call setColorMap again.
+	Full brightness in the palette is scaled to maxBrightness.
+
+	@param palette The palette.
+*/
+void Cube::setColorMap(const CRGBPalette256 &palette)
+{
+  this->colorMapPalette = &palette;
+  this->colorMapBrightness = -1;
+}
+
+/** Go back to the default gradient of colorMap. */
+void Cube::resetColorMap(void)
+{
+  this->setColorMap(NULL, 0);
+}
+
+/** Build the table of colorMap for the current gradient and maxBrightness. */
+void Cube::buildColorMap(void)
+{
+  int brightness = this->maxBrightness;
+  if(this->colorMapPalette) {
+    const CRGBPalette256 &palette = *this->colorMapPalette;
+    for(int i = 0; i < COLOR_MAP_SIZE; i++) {
+      const CRGB &c = palette[i * 256 / COLOR_MAP_SIZE];
+      this->colorMapTable[i] = Color(c.r * brightness / 255, c.g * brightness / 255, c.b * brightness / 255);
+    }
+  } else {
+    int count = this->colorMapStopCount;
+    for(int k = 0; k < count; k++) {
+      const Color &a = this->colorMapStops[k];
+      const Color &b = this->colorMapStops[(k + 1) % count];
+      Color from = Color(a.red * brightness / 255, a.green * brightness / 255, a.blue * brightness / 255);
+      Color to = Color(b.red * brightness / 255, b.green * brightness / 255, b.blue * brightness / 255);
+      int start = COLOR_MAP_SIZE * k / count;
+      int end = COLOR_MAP_SIZE * (k + 1) / count;
+      for(int i = start; i < end; i++)
+        this->colorMapTable[i] = this->lerpColor(from, to, i, start, end);
+    }
+  }
+  this->colorMapBrightness = brightness;
 }
 
 /** Linear interpolation between colors.
@@ -446,13 +1215,242 @@ Color Cube::lerpColor(Color a, Color b, int val, int min, int max)
 
 /** Make changes to the cube visible.
   Causes pixel data to be written to the LED strips.
+  When double buffering is enabled, the frame that was drawn is published by pointing the LED
+  controller at it, and drawing continues in the other buffer.
+  When a wiring map is set, the frame is copied into LED order in a separate output buffer instead,
+  and drawing continues in the same buffer. An upright cube reads the accelerometer first, and turns the
+  frame in the same copy. The sampler given to setMotion is updated first.
+  Nothing happens while drawing goes to a VoxelBuffer (see setTarget).
 */
 void Cube::show()
 {
+	if(this->target)
+		return;
+	if(this->motion)
+		this->motion->update();
+	if(this->upright) {
+		if(this->motion) {
+			this->accelerometerX = this->motion->getX();
+			this->accelerometerY = this->motion->getY();
+			this->accelerometerZ = this->motion->getZ();
+		} else {
+			this->accelerometerX = analogRead(X) - 2048;
+			this->accelerometerY = analogRead(Y) - 2048;
+			this->accelerometerZ = analogRead(Z) - 2048;
+		}
+		this->updateOrientation(this->accelerometerX, this->accelerometerY, this->accelerometerZ);
+	}
+	if(this->wiring) {
+		const uint16_t *wiring = this->wiring;
+		CRGB *out = this->frontLeds;
+		for(int i = 0; i < PIXEL_COUNT; i++)
+			out[wiring[i]] = this->leds[i];
+	} else if(this->doubleBuffered) {
+		CRGB *finished = this->leds;
+		DirtyRegion *finishedDirty = this->dirty;
+		if(this->controller)
+			this->controller->setLeds(finished, PIXEL_COUNT);
+		this->leds = this->frontLeds;
+		this->frontLeds = finished;
+		this->dirty = this->frontDirty;
+		this->frontDirty = finishedDirty;
+		if(this->preserveBackBuffer) {
+			memcpy8(this->leds, this->frontLeds, sizeof(CRGB) * PIXEL_COUNT);
+			*this->dirty = *this->frontDirty;
+		}
+	}
 	LEDS.show();	//strip.show();
 	Particle.process();
 }
 
+/** Point the LED controller at the buffer that holds the frame being output. */
+void Cube::bindOutput(void)
+{
+	if(this->controller)
+		this->controller->setLeds((this->wiring || this->doubleBuffered) ? this->frontLeds : (this->target ? this->ownLeds : this->leds), PIXEL_COUNT);
+}
+
+/** Enable or disable double buffering.
+  While enabled, all drawing goes to a back buffer that is not streamed to the LEDs until show()
+  swaps it with the front buffer, so a frame is never output half drawn.
+  With a wiring map set, frames are always output from a separate buffer, so this has no effect
+  until the wiring map is removed.
+
+  @param enabled True to draw into a back buffer, false to draw straight into the output buffer.
+  @param preserve If true, show() copies the published frame into the new back buffer, for effects
+  that build on the previous frame (fade(), trails, scrolling). If false, the back buffer holds the
+  frame from two show() calls ago, which is fine for effects that redraw everything each frame.
+*/
+void Cube::setDoubleBuffered(bool enabled, bool preserve)
+{
+	if(enabled && !this->doubleBuffered && !this->wiring) {
+		// both buffers start out with what is currently on the cube
+		memcpy8(this->frontLeds, this->leds, sizeof(CRGB) * PIXEL_COUNT);
+		*this->frontDirty = *this->dirty;
+	}
+	this->doubleBuffered = enabled;
+	this->preserveBackBuffer = preserve;
+	this->bindOutput();
+}
+
+/** Check whether drawing goes to a back buffer.
+
+  @return True if double buffering is enabled.
+*/
+bool Cube::isDoubleBuffered(void)
+{
+	return this->doubleBuffered;
+}
+
+/** Set the order the LEDs are wired in.
+  Drawing always happens in voxel order; show() reorders each frame into LED order.
+
+  @param map The wiring of the cube. The table is used in place, so it must outlive the cube.
+*/
+void Cube::setWiring(const WiringMap &map)
+{
+	this->setWiring(map.physical);
+}
+
+/** Set the order the LEDs are wired in.
+
+  @param table Position along the LED chain of each voxel index, or NULL if the LEDs are wired in
+  voxel order. The table is used in place, so it can be a constant table in flash.
+*/
+void Cube::setWiring(const uint16_t *table)
+{
+	if(table) {
+		int i = 0;
+		while(i < PIXEL_COUNT && table[i] == i)
+			i++;
+		if(i == PIXEL_COUNT)
+			table = NULL;	// wired in voxel order, output straight from the drawing buffer
+	}
+	this->baseWiring = table;
+	this->updateOutputMap();
+}
+
+/** Pick the table show() copies frames through: the wiring map, turned to the cube's orientation. */
+void Cube::updateOutputMap(void)
+{
+	const uint16_t *table = this->baseWiring;
+	if(!this->orientation.isIdentity()) {
+		for(int i = 0; i < PIXEL_COUNT; i++) {
+			int x = indexX(i), y = indexY(i), z = indexZ(i);
+			this->orientation.map(x, y, z);
+			int led = index(x, y, z);
+			this->orientedWiring[i] = table ? table[led] : led;
+		}
+		table = this->orientedWiring;
+	}
+	if(!table && this->wiring && this->doubleBuffered) {
+		// the output buffer becomes the next back buffer
+		memcpy8(this->frontLeds, this->leds, sizeof(CRGB) * PIXEL_COUNT);
+		*this->frontDirty = *this->dirty;
+	}
+	this->wiring = table;
+	this->bindOutput();
+}
+
+/** Keep what is drawn upright: every show() reads the accelerometer and turns the output so that the
+  bottom of the drawing (z = 0) is on whichever face of the cube is down. Drawing is not affected; the
+  turn is applied while show() copies the frame out, through a precomputed table, so it costs nothing
+  per voxel beyond that copy. The accelerometer's axes are taken to be the cube's x, y and z.
+
+  @param enabled True to follow gravity, false to go back to the unturned output.
+*/
+void Cube::setUpright(bool enabled)
+{
+	this->upright = enabled;
+	if(!enabled)
+		this->setOrientation(0);
+}
+
+/** Check whether the output follows gravity.
+
+  @return True if setUpright is enabled.
+*/
+bool Cube::isUpright(void)
+{
+	return this->upright;
+}
+
+/** Turn the output toward a new direction of gravity, if it has clearly changed.
+  The face that is up is the one gravity pulls away from most strongly, but the output only turns once
+  another face wins by ORIENTATION_HYSTERESIS counts, and never while gravity is weaker than
+  ORIENTATION_MIN_GRAVITY (while the cube is shaken or falling). It turns the shortest way, by a quarter
+  turn over the edge the cube was tipped over, so what is drawn keeps facing the same way around.
+
+  @param x, y, z Accelerometer readings with the bias removed, positive along the axis pointing up.
+
+  @return True if the orientation changed.
+*/
+bool Cube::updateOrientation(int x, int y, int z)
+{
+	int g[3] = { x, y, z };
+	int best = 0;
+	for(int i = 1; i < 3; i++)
+		if(abs(g[i]) > abs(g[best]))
+			best = i;
+	if(abs(g[best]) < ORIENTATION_MIN_GRAVITY)
+		return false;
+
+	// the face the top of the drawing is on now
+	int up = 0;
+	while(this->orientation.axis[up] != AXIS_Z)
+		up++;
+	int upSign = this->orientation.sign[up];
+	int toward = g[best] < 0 ? -1 : 1;
+	if(best == up && toward == upSign)
+		return false;
+	if(abs(g[best]) - upSign * g[up] <= ORIENTATION_HYSTERESIS)
+		return false;
+
+	VoxelTransform turn;
+	if(best == up) {
+		turn.rotate((up + 1) % 3, 2);	// upside down
+	} else {
+		// a quarter turn about the third axis, whichever way takes the old top to the new one
+		turn.rotate(3 - up - best, 1);
+		int to = 0;
+		while(turn.axis[to] != up)
+			to++;
+		if(turn.sign[to] * upSign != toward) {
+			turn.identity();
+			turn.rotate(3 - up - best, -1);
+		}
+	}
+	this->orientation.then(turn);
+	this->updateOutputMap();
+	return true;
+}
+
+/** Turn the output to one of the 24 rotations of the cube.
+
+  @param orientation 0 to 23, as for VoxelTransform::orient; 0 is unturned.
+*/
+void Cube::setOrientation(int orientation)
+{
+	this->orientation.identity();
+	this->orientation.orient(orientation);
+	this->updateOutputMap();
+}
+
+/** Get the rotation the output is turned by.
+
+  @return 0 to 23, as for VoxelTransform::orient.
+*/
+int Cube::getOrientation(void)
+{
+	for(int o = 0; o < 24; o++) {
+		VoxelTransform t;
+		t.orient(o);
+		if(!memcmp(t.axis, this->orientation.axis, sizeof(t.axis)) && !memcmp(t.sign, this->orientation.sign, sizeof(t.sign)))
+			return o;
+	}
+	return 0;
+}
+
 /** Sets the brightness of the LED strips to a given value.
   @param value Brightness value to be set (0 - 255).
 
@@ -473,9 +1471,20 @@ int Cube::getBrightness(void)
 updates accelerometerX, accelerometerY and accelerometerZ, which are directly read from the analog pins, minus 2048 to remove the DC bias
 
 calculates theta and phi, which are the 3D rotation angles
+
+with a sampler set by setMotion, the filtered readings and fixed point angles of the sampler are taken instead, without reading the pins
  */
 void Cube::updateAccelerometer()
 {
+	if(this->motion) {
+		this->motion->update();
+		accelerometerX=this->motion->getX();
+		accelerometerY=this->motion->getY();
+		accelerometerZ=this->motion->getZ();
+		theta=this->motion->getTheta()*(360.0f/65536);
+		phi=this->motion->getPhi()*(360.0f/65536);
+		return;
+	}
 	accelerometerX=analogRead(X)-2048;
 	accelerometerY=analogRead(Y)-2048;
 	accelerometerZ=analogRead(Z)-2048;
@@ -483,6 +1492,17 @@ void Cube::updateAccelerometer()
 	phi=atan(accelerometerY/sqrt(pow(accelerometerX,2)+pow(accelerometerZ,2)))*180/3.14;
 }
 
+/** Read the accelerometer through a MotionSampler rather than the analog pins.
+  show() updates the sampler every frame, and upright output and updateAccelerometer() use its filtered
+  readings, so drawing never waits for the ADC.
+
+  @param sampler A started sampler, or NULL to read the pins again.
+*/
+void Cube::setMotion(MotionSampler *sampler)
+{
+	this->motion = sampler;
+}
+
 /** Initialize online/offline switch and the join wifi button */
 void Cube::initButtons() {
 
@@ -535,12 +1555,17 @@ void Cube::joinWifi()
     WiFi.listen();
 }
 
-/** Listen for the start of UDP streaming. */
+/** Listen for the start of UDP streaming.
+  Packets of the streaming protocol (see cube-stream.h) are read straight into the drawing buffer, or
+  applied to it in place for deltas, and the cube is shown once every fragment of a frame has arrived.
+  Packets of exactly PIXEL_COUNT bytes without a protocol header are decoded as one RGB332 byte per
+  voxel, x varying fastest, then y, then z, and shown right away.
+*/
 void Cube::listen() {
   int32_t bytesrecv = this->udp.parsePacket();
 
   // no data, nothing to do
-  if(bytesrecv == 0) return;
+  if(bytesrecv <= 0) return;
 
   if(millis() - this->lastUpdated > 60000) {
     //update the network settings every minute
@@ -548,19 +1573,55 @@ void Cube::listen() {
     this->lastUpdated = millis();
   }
 
-  if(bytesrecv == PIXEL_COUNT) {
-    char data[512];
-    this->udp.read(data, bytesrecv);
+  uint8_t head[STREAM_HEADER_SIZE];
+  int headLength = this->udp.read(head, (bytesrecv < STREAM_HEADER_SIZE) ? bytesrecv : STREAM_HEADER_SIZE);
+  StreamHeader header;
+  if(header.parse(head, headLength)) {
+    int payloadLength = bytesrecv - STREAM_HEADER_SIZE;
+    if(this->stream.accept(header, payloadLength, PIXEL_COUNT, millis()) != STREAM_FRAGMENT)
+      return;
+    if(header.type == STREAM_DELTA) {
+      uint8_t payload[STREAM_MAX_PACKET - STREAM_HEADER_SIZE];
+      if(payloadLength > (int)sizeof(payload))
+        return;
+      this->udp.read(payload, payloadLength);
+      if(this->stream.applyDelta(header, payload, payloadLength, (uint8_t *)this->leds, PIXEL_COUNT) != STREAM_FRAGMENT)
+        return;
+      this->markDirty(0, 0, 0, this->size - 1, this->size - 1, this->size - 1);
+    } else {
+      this->udp.read((uint8_t *)&this->leds[header.offset], payloadLength);
+      int last = header.offset + payloadLength / 3 - 1;
+      this->markDirty(0, 0, indexZ(header.offset), this->size - 1, this->size - 1, indexZ(last));
+    }
+    if(this->stream.finish(header) == STREAM_COMPLETE) {
+      this->show();
+      if(this->doubleBuffered && !this->preserveBackBuffer && !this->wiring) {
+        // deltas apply to the frame just shown, not to the one left in the back buffer
+        memcpy8(this->leds, this->frontLeds, sizeof(CRGB) * PIXEL_COUNT);
+        *this->dirty = *this->frontDirty;
+      }
+    }
+    return;
+  }
 
-    for(int x = 0; x < this->size; x++) {
+  if(bytesrecv == PIXEL_COUNT) {
+    // one slab at a time, the header bytes already read are the start of the first one
+    uint8_t slab[CUBE_SIZE*CUBE_SIZE];
+    for(int z = 0; z < this->size; z++) {
+      int have = 0;
+      if(z == 0) {
+        memcpy(slab, head, headLength);
+        have = headLength;
+      }
+      this->udp.read(slab + have, sizeof(slab) - have);
       for(int y = 0; y < this->size; y++) {
-        for(int z = 0; z < this->size; z++) {
-          int index = z*this->size + y*this->size + x;
-          Color pixelColor = Color((data[index]&0xE0)>>2, (data[index]&0x1C)<<1, (data[index]&0x03)<<4);   //colors with max brightness set to 64
-          this->setVoxel(x, y, z, pixelColor);
+        for(int x = 0; x < this->size; x++) {
+          uint8_t c = slab[y*this->size + x];
+          this->leds[index(x, y, z)] = CRGB((c&0xE0)>>2, (c&0x1C)<<1, (c&0x03)<<4);   //colors with max brightness set to 64
         }
       }
     }
+    this->markDirty(0, 0, 0, this->size - 1, this->size - 1, this->size - 1);
   }
   this->show();
 }
@@ -584,3 +1645,261 @@ int Cube::setPort(String _port) {
 	this->udp.begin(port);
 	return port;
 }
+
+/** Construct a black buffer. */
+VoxelBuffer::VoxelBuffer() :
+	changed(true)
+{
+	memset8(this->leds, 0, sizeof(this->leds));
+}
+
+/** Turn the buffer black, visiting only the part that was drawn into. */
+void VoxelBuffer::clear(void)
+{
+	DirtyRegion &r = this->dirty;
+	if(!r.isEmpty()) {
+		int rowLength = r.y1 - r.y0 + 1;
+		for(int z = r.z0; z <= r.z1; z++)
+			for(int x = r.x0; x <= r.x1; x++)
+				memset8(&this->leds[VoxelGrid<CUBE_SIZE>::index(x, r.y0, z)], 0, sizeof(CRGB) * rowLength);
+		this->changed = true;
+	}
+	r = DirtyRegion();
+}
+
+/** Construct a wiring map for LEDs wired in voxel order. */
+WiringMap::WiringMap()
+{
+	this->linear();
+}
+
+/** Wire the LEDs in voxel order: slab by slab along z, row by row along x, y varying fastest. */
+void WiringMap::linear(void)
+{
+	for(int i = 0; i < PIXEL_COUNT; i++)
+		this->physical[i] = i;
+}
+
+/** Wire the LEDs back and forth: every other row along y runs the opposite way.
+
+  @param alternateSlabs If true, every other slab also runs its rows from the last x to the first,
+  so the chain continues where the previous slab ended.
+*/
+void WiringMap::serpentine(bool alternateSlabs)
+{
+	const int n = CUBE_SIZE;
+	for(int z = 0; z < n; z++)
+		for(int x = 0; x < n; x++) {
+			int row = (alternateSlabs && (z & 1)) ? n - 1 - x : x;
+			for(int y = 0; y < n; y++) {
+				int col = (row & 1) ? n - 1 - y : y;
+				this->physical[VoxelGrid<CUBE_SIZE>::index(x, y, z)] = (z*n + row)*n + col;
+			}
+		}
+}
+
+/** Wire the LEDs as a chain of identical panels, one per slab along z.
+
+  @param panel Position within its panel of each voxel of a slab, indexed by x*CUBE_SIZE + y.
+  @param slabOrder Position along the chain of the panel holding each slab, or NULL if the panels
+  are chained in z order.
+*/
+void WiringMap::perSlab(const uint16_t *panel, const uint8_t *slabOrder)
+{
+	const int n = CUBE_SIZE;
+	for(int z = 0; z < n; z++) {
+		int slab = slabOrder ? slabOrder[z] : z;
+		for(int x = 0; x < n; x++)
+			for(int y = 0; y < n; y++)
+				this->physical[VoxelGrid<CUBE_SIZE>::index(x, y, z)] = slab*n*n + panel[x*n + y];
+	}
+}
+
+/** Copy a wiring table, e.g. one measured on a cube and stored in flash.
+
+  @param table Position along the LED chain of each voxel index.
+*/
+void WiringMap::load(const uint16_t *table)
+{
+	memcpy8(this->physical, table, sizeof(this->physical));
+}
+
+/** Check whether the LEDs are wired in voxel order.
+
+  @return True if every voxel maps to its own index.
+*/
+bool WiringMap::isLinear(void) const
+{
+	for(int i = 0; i < PIXEL_COUNT; i++)
+		if(this->physical[i] != i)
+			return false;
+	return true;
+}
+
+/** Construct a transform that leaves the cube as it is, without wrapping. */
+VoxelTransform::VoxelTransform() : wrap(false)
+{
+	this->identity();
+}
+
+/** Remove all steps, leaving the cube as it is. wrap is not changed. */
+void VoxelTransform::identity(void)
+{
+	for(int i = 0; i < 3; i++) {
+		this->axis[i] = i;
+		this->sign[i] = 1;
+		this->offset[i] = 0;
+	}
+}
+
+/** Add quarter turns about an axis through the center of the cube.
+  A positive quarter turn about z takes x toward y, about x takes y toward z, and about y takes z toward x.
+
+  @param about AXIS_X, AXIS_Y or AXIS_Z.
+  @param quarterTurns Number of quarter turns, negative to turn the other way.
+*/
+void VoxelTransform::rotate(int about, int quarterTurns)
+{
+	if(about < AXIS_X || about > AXIS_Z)
+		return;
+	int u = (about + 1) % 3, v = (about + 2) % 3;
+	VoxelTransform step;
+	step.axis[u] = v;
+	step.sign[u] = -1;
+	step.offset[u] = CUBE_SIZE - 1;
+	step.axis[v] = u;
+	for(int turns = ((quarterTurns % 4) + 4) % 4; turns > 0; turns--)
+		this->then(step);
+}
+
+/** Add one of the 24 rotations of the cube.
+  Orientation o first turns the cube o%4 quarter turns about z, then brings its top (the +z face) to
+  face o/4, in the order +z, -z, +x, -x, +y, -y. Orientation 0 leaves the cube as it is.
+
+  @param orientation 0 to 23.
+*/
+void VoxelTransform::orient(int orientation)
+{
+	static const int8_t faceAxis[6] = { AXIS_Z, AXIS_X, AXIS_Y, AXIS_Y, AXIS_X, AXIS_X };
+	static const int8_t faceTurns[6] = { 0, 2, 1, -1, -1, 1 };
+	if(orientation < 0 || orientation >= 24)
+		return;
+	this->rotate(AXIS_Z, orientation % 4);
+	this->rotate(faceAxis[orientation / 4], faceTurns[orientation / 4]);
+}
+
+/** Add a mirror image through the plane across the middle of an axis.
+
+  @param along AXIS_X, AXIS_Y or AXIS_Z, the axis that is reversed.
+*/
+void VoxelTransform::mirror(int along)
+{
+	if(along < AXIS_X || along > AXIS_Z)
+		return;
+	VoxelTransform step;
+	step.sign[along] = -1;
+	step.offset[along] = CUBE_SIZE - 1;
+	this->then(step);
+}
+
+/** Add a swap of axes: output x takes the source coordinate along xFrom, and so on.
+  Nothing is added unless the three axes are all different.
+
+  @param xFrom, yFrom, zFrom AXIS_X, AXIS_Y or AXIS_Z.
+*/
+void VoxelTransform::permute(int xFrom, int yFrom, int zFrom)
+{
+	if((unsigned)xFrom > AXIS_Z || (unsigned)yFrom > AXIS_Z || (unsigned)zFrom > AXIS_Z ||
+			xFrom == yFrom || yFrom == zFrom || xFrom == zFrom)
+		return;
+	VoxelTransform step;
+	step.axis[0] = xFrom;
+	step.axis[1] = yFrom;
+	step.axis[2] = zFrom;
+	this->then(step);
+}
+
+/** Add a move by whole voxels.
+
+  @param dx, dy, dz How far to move along each axis.
+*/
+void VoxelTransform::translate(int dx, int dy, int dz)
+{
+	this->offset[0] += dx;
+	this->offset[1] += dy;
+	this->offset[2] += dz;
+}
+
+/** Add all steps of another transform after the ones of this one. wrap is not changed.
+
+  @param next The transform to follow this one.
+*/
+void VoxelTransform::then(const VoxelTransform &next)
+{
+	VoxelTransform first = *this;
+	for(int i = 0; i < 3; i++) {
+		int from = next.axis[i];
+		this->axis[i] = first.axis[from];
+		this->sign[i] = next.sign[i] * first.sign[from];
+		this->offset[i] = next.sign[i] * first.offset[from] + next.offset[i];
+	}
+}
+
+/** Replace the transform with the one that undoes it. */
+void VoxelTransform::invert(void)
+{
+	VoxelTransform forward = *this;
+	for(int i = 0; i < 3; i++) {
+		int to = forward.axis[i];
+		this->axis[to] = i;
+		this->sign[to] = forward.sign[i];
+		this->offset[to] = -forward.sign[i] * forward.offset[i];
+	}
+}
+
+/** Check whether the transform leaves every voxel where it is.
+
+  @return True if no voxel moves.
+*/
+bool VoxelTransform::isIdentity(void) const
+{
+	for(int i = 0; i < 3; i++)
+		if(this->axis[i] != i || this->sign[i] < 0 || (this->wrap ? this->offset[i] % CUBE_SIZE : this->offset[i]) != 0)
+			return false;
+	return true;
+}
+
+/** Find where a voxel ends up.
+
+  @param x, y, z The voxel, replaced by where it ends up, wrapped around the cube if wrap is set.
+
+  @return True if the voxel ends up inside the cube.
+*/
+bool VoxelTransform::map(int &x, int &y, int &z) const
+{
+	int p[3] = { x, y, z };
+	int q[3];
+	for(int i = 0; i < 3; i++) {
+		q[i] = this->sign[i] * p[this->axis[i]] + this->offset[i];
+		if(this->wrap)
+			q[i] = ((q[i] % CUBE_SIZE) + CUBE_SIZE) % CUBE_SIZE;
+	}
+	x = q[0];
+	y = q[1];
+	z = q[2];
+	return VoxelGrid<CUBE_SIZE>::contains(x, y, z);
+}
+
+/** Find where a point ends up. Points are not wrapped.
+
+  @param p The point.
+
+  @return Where the point ends up.
+*/
+Point VoxelTransform::map(Point p) const
+{
+	float c[3] = { p.x, p.y, p.z };
+	return Point(this->sign[0] * c[this->axis[0]] + this->offset[0],
+	             this->sign[1] * c[this->axis[1]] + this->offset[1],
+	             this->sign[2] * c[this->axis[2]] + this->offset[2]);
+}
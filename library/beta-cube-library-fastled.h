@@ -1,14 +1,23 @@
 #ifndef _L3D_H
 #define _L3D_H
 
+#include <stddef.h>
 #include "FastLED.h"
+#include "cube-stream.h"
 FASTLED_USING_NAMESPACE;
 
 #if FASTLED_VERSION < 3001000
 #error "Requires FastLED 3.1 or later; check github for latest code."
 #endif
 
-#define PIXEL_COUNT 512
+/**   Number of voxels along each side of the cube.
+      Build with -DCUBE_SIZE=4 or -DCUBE_SIZE=16 for other cubes; everything below is sized from it.
+*/
+#ifndef CUBE_SIZE
+#define CUBE_SIZE 8
+#endif
+
+#define PIXEL_COUNT (CUBE_SIZE*CUBE_SIZE*CUBE_SIZE)
 #define PIXEL_PIN D0
 #define PIXEL_TYPE WS2812B
 #define COLOR_ORDER GRB
@@ -29,6 +38,15 @@ FASTLED_USING_NAMESPACE;
 #define Z 15 
 #endif
 
+/**   How many accelerometer counts more gravity must pull toward another face of the cube than toward the
+      one currently down before an upright cube turns its output, and how strong it must be at all. */
+#ifndef ORIENTATION_HYSTERESIS
+#define ORIENTATION_HYSTERESIS 100
+#endif
+#ifndef ORIENTATION_MIN_GRAVITY
+#define ORIENTATION_MIN_GRAVITY 200
+#endif
+
 /**   An RGB color. */
 struct Color {
   uint8_t red, green, blue;
@@ -37,6 +55,14 @@ struct Color {
   Color() : red(0), green(0), blue(0) {}
 };
 
+/**   Color has the layout of FastLED's CRGB: red, green and blue bytes with no padding. An array of
+      one can be cast to an array of the other, e.g. to hand the voxels of Cube::voxels() to code that
+      works on Colors, without copying.
+*/
+static_assert(sizeof(Color) == sizeof(CRGB) && offsetof(Color, red) == offsetof(CRGB, r) &&
+    offsetof(Color, green) == offsetof(CRGB, g) && offsetof(Color, blue) == offsetof(CRGB, b),
+    "Color must have the layout of CRGB");
+
 /**   A point in 3D space.  */
 struct Point {
   float x;
@@ -46,6 +72,242 @@ struct Point {
   Point(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
 };
 
+/**   One voxel in the 8.8 fixed point coordinates of PointQ. */
+#define POINTQ_ONE 256
+
+/**   A point in 3D space in 8.8 fixed point: each coordinate counts 1/256ths of a voxel, from -128 to
+      just under 128 voxels. The Photon has no floating point unit, so code that moves points every
+      frame is much faster with these than with Point. The constructor takes the raw 8.8 values;
+      PointQ(3 * POINTQ_ONE, 0, POINTQ_ONE / 2) is the point (3, 0, 0.5).
+*/
+struct PointQ {
+  int16_t x;
+  int16_t y;
+  int16_t z;
+  PointQ() : x(0), y(0), z(0) {}
+  PointQ(int16_t _x, int16_t _y, int16_t _z) : x(_x), y(_y), z(_z) {}
+  explicit PointQ(const Point &p) :
+    x(p.x * POINTQ_ONE + ((p.x < 0) ? -0.5f : 0.5f)),
+    y(p.y * POINTQ_ONE + ((p.y < 0) ? -0.5f : 0.5f)),
+    z(p.z * POINTQ_ONE + ((p.z < 0) ? -0.5f : 0.5f)) {}
+
+  Point toPoint() const { return Point(x / (float)POINTQ_ONE, y / (float)POINTQ_ONE, z / (float)POINTQ_ONE); }
+
+  /** The voxel the point is in, rounding toward zero as converting a Point to int does. */
+  int voxelX() const { return x / POINTQ_ONE; }
+  int voxelY() const { return y / POINTQ_ONE; }
+  int voxelZ() const { return z / POINTQ_ONE; }
+
+  PointQ &operator+=(const PointQ &b) { x += b.x; y += b.y; z += b.z; return *this; }
+  PointQ &operator-=(const PointQ &b) { x -= b.x; y -= b.y; z -= b.z; return *this; }
+  PointQ operator+(const PointQ &b) const { return PointQ(x + b.x, y + b.y, z + b.z); }
+  PointQ operator-(const PointQ &b) const { return PointQ(x - b.x, y - b.y, z - b.z); }
+};
+
+/**   An axis aligned box of voxels, inclusive on both ends.
+      Used to track which part of the cube has been drawn into since it was last cleared.
+*/
+struct DirtyRegion {
+  int8_t x0, y0, z0;
+  int8_t x1, y1, z1;
+  DirtyRegion() : x0(127), y0(127), z0(127), x1(-1), y1(-1), z1(-1) {}
+  DirtyRegion(int8_t _x0, int8_t _y0, int8_t _z0, int8_t _x1, int8_t _y1, int8_t _z1) :
+    x0(_x0), y0(_y0), z0(_z0), x1(_x1), y1(_y1), z1(_z1) {}
+
+  bool isEmpty() const { return x1 < x0; }
+
+  void include(int x, int y, int z) {
+    if(x < x0) x0 = x;
+    if(x > x1) x1 = x;
+    if(y < y0) y0 = y;
+    if(y > y1) y1 = y;
+    if(z < z0) z0 = z;
+    if(z > z1) z1 = z;
+  }
+};
+
+/**   The geometry of a cube of N x N x N voxels.
+      The size, the number of voxels and the mapping between coordinates and buffer indices are
+      compile time constants, so indexing reduces to shifts and adds when N is a power of two.
+      Voxels are stored slab by slab along z, then row by row along x, with y varying fastest.
+*/
+template<int N>
+struct VoxelGrid {
+  static_assert(N > 0 && N <= 127, "DirtyRegion stores voxel coordinates in an int8_t");
+
+  static constexpr int size = N;
+  static constexpr int voxelCount = N * N * N;
+
+  /** Index of the voxel at x, y, z in a buffer of voxelCount voxels. */
+  static constexpr int index(int x, int y, int z) { return (z * N + x) * N + y; }
+
+  /** Coordinates of the voxel at an index. */
+  static constexpr int indexX(int index) { return (index / N) % N; }
+  static constexpr int indexY(int index) { return index % N; }
+  static constexpr int indexZ(int index) { return index / (N * N); }
+
+  /** True if x, y, z is inside the cube. */
+  static constexpr bool contains(int x, int y, int z) {
+    return (unsigned)x < (unsigned)N && (unsigned)y < (unsigned)N && (unsigned)z < (unsigned)N;
+  }
+};
+
+template<int N> constexpr int VoxelGrid<N>::size;
+template<int N> constexpr int VoxelGrid<N>::voxelCount;
+
+/**   A volume of voxels that a Cube can draw into in place of its own buffer (see Cube::setTarget),
+      with the part of it drawn into. Starts out black.
+      changed is set whenever a Cube is given the buffer to draw into and when it is cleared or copied
+      into; whoever uses the contents resets it. Set it after writing leds directly.
+*/
+struct VoxelBuffer {
+  CRGB leds[PIXEL_COUNT];
+  DirtyRegion dirty;
+  bool changed;
+
+  VoxelBuffer();
+  void clear(void);
+};
+
+/**   Maps voxels to the order the LEDs are wired in.
+      Entry i of the table is the position along the LED chain of the voxel with index i (see
+      VoxelGrid::index). Every position must appear exactly once.
+*/
+class WiringMap {
+  public:
+    uint16_t physical[PIXEL_COUNT];
+
+    WiringMap();
+
+    void linear(void);
+    void serpentine(bool alternateSlabs=false);
+    void perSlab(const uint16_t *panel, const uint8_t *slabOrder=NULL);
+    void load(const uint16_t *table);
+    bool isLinear(void) const;
+};
+
+/** Axes, for VoxelTransform. */
+#define AXIS_X 0
+#define AXIS_Y 1
+#define AXIS_Z 2
+
+/**   A rearrangement of the whole cube: any of its 24 rotations, mirror images, moves by whole voxels and
+      combinations of them. Each method adds a step after the ones already there, so rotate(AXIS_Z, 1)
+      followed by translate(2, 0, 0) turns the cube a quarter, then moves it 2 voxels along x.
+      The steps are folded into one map: output axis i takes coordinate axis[i] of the source, negated when
+      sign[i] is negative, plus offset[i]. Cube::transform then moves every voxel once, however many steps
+      there are. When wrap is set, voxels moved past a face come back in through the opposite one; otherwise
+      they are lost and the voxels moved in from outside are black. As the steps are combined before anything
+      moves, only what the transform as a whole moves out of the cube is lost.
+*/
+class VoxelTransform {
+  public:
+    int8_t axis[3];
+    int8_t sign[3];
+    int16_t offset[3];
+    bool wrap;
+
+    VoxelTransform();
+
+    void identity(void);
+    void rotate(int about, int quarterTurns);
+    void orient(int orientation);
+    void mirror(int along);
+    void permute(int xFrom, int yFrom, int zFrom);
+    void translate(int dx, int dy, int dz);
+    void then(const VoxelTransform &next);
+    void invert(void);
+    bool isIdentity(void) const;
+    bool map(int &x, int &y, int &z) const;
+    Point map(Point p) const;
+};
+
+/** Command types of a CubeCommandList. */
+#define CUBE_COMMAND_VOXEL 0
+#define CUBE_COMMAND_LINE 1
+#define CUBE_COMMAND_SPHERE 2
+#define CUBE_COMMAND_SHELL 3
+
+/**   A drawing command recorded in a CubeCommandList.
+      Coordinates are kept as int16_t, or as floats for shells. x0 to x1, y0 to y1 and z0 to z1 are the
+      box of voxels the command can touch once clipped to the cube. Lines also keep the range of their
+      steps that falls inside the cube.
+*/
+struct CubeCommand {
+  uint8_t type;
+  uint8_t x0, x1, y0, y1, z0, z1;
+  CRGB color;
+  union {
+    int16_t i[6];
+    float f[5];
+    struct {
+      int16_t ends[6];
+      uint16_t first, last;
+    } line;
+  } args;
+};
+
+/**   A run of voxels of one color along y, produced by compiling a CubeCommandList. */
+struct CubeRun {
+  uint16_t start;
+  uint8_t length;
+  CRGB color;
+};
+
+/**   Drawing commands recorded to be drawn into a Cube later, as often as needed.
+      Commands are clipped to the cube and their colors converted once, when they are recorded.
+      Before the list is first drawn it is compiled into runs of voxels, slab by slab, which every
+      draw then copies into the cube without further checks until the list changes. Compiling does not
+      need the cube, so a scene can be prepared away from the code that draws frames.
+      The caller supplies the storage for commands and runs.
+*/
+class CubeCommandList {
+  friend class Cube;
+
+  private:
+    CubeCommand *commands;
+    int capacity;
+    int count;
+    CubeRun *runs;
+    int runCapacity;
+    int runCount;
+    bool compiled;
+    bool overflowed;
+    DirtyRegion bounds;
+
+    bool add(const CubeCommand &command);
+
+  public:
+    CubeCommandList(CubeCommand *commands, int capacity, CubeRun *runs, int runCapacity);
+
+    void clear(void);
+    bool setVoxel(int x, int y, int z, Color col);
+    bool setVoxel(Point p, Color col);
+    bool line(int x1, int y1, int z1, int x2, int y2, int z2, Color col);
+    bool line(Point p1, Point p2, Color col);
+    bool sphere(int x, int y, int z, int r, Color col);
+    bool sphere(Point p, int r, Color col);
+    bool shell(float x, float y, float z, float r, Color col);
+    bool shell(float x, float y, float z, float r, float thickness, Color col);
+    bool shell(Point p, float r, Color col);
+    bool shell(Point p, float r, float thickness, Color col);
+    bool compile(void);
+    bool isCompiled(void) const { return this->compiled; }
+    int commandCount(void) const { return this->count; }
+};
+
+class SdfScene;
+class MotionSampler;
+class LayerStack;
+class ParticleSystem;
+
+/**   Number of entries in the lookup table of Cube::colorMap. A power of two. */
+#define COLOR_MAP_SIZE 1024
+
+/** Ways of drawing a color over a voxel that is already lit. */
+#define BLEND_ADD 0
+#define BLEND_MAX 1
+
 /** Overloaded != operator. */
 inline bool operator!= (const Color& a, const Color& b) {
     if(a.red != b.red) return true;
@@ -76,22 +338,63 @@ inline bool operator== (const Point& a, const Point& b) {
     return true;
 }
 
+inline bool operator== (const PointQ& a, const PointQ& b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+inline bool operator!= (const PointQ& a, const PointQ& b) {
+    return !(a == b);
+}
+
 /**   An L3D LED cube.
       Provides methods for drawing in 3D. Controls the LED hardware.
+      The size of the cube is fixed at compile time by CUBE_SIZE.
 */
-class Cube {
+class Cube : public VoxelGrid<CUBE_SIZE> {
   private:
     bool onlinePressed;
     bool lastOnline;
-	CRGB leds[PIXEL_COUNT];
+	CRGB buffers[2][PIXEL_COUNT];
+	CRGB *leds;
+	CRGB *frontLeds;
+	CLEDController *controller;
+	bool doubleBuffered;
+	bool preserveBackBuffer;
+	DirtyRegion regions[2];
+	DirtyRegion *dirty;
+	DirtyRegion *frontDirty;
+	const uint16_t *wiring;
+	const uint16_t *baseWiring;
+	VoxelTransform orientation;
+	uint16_t orientedWiring[PIXEL_COUNT];
+	bool upright;
+	MotionSampler *motion;
+	VoxelBuffer *target;
+	CRGB *ownLeds;
+	DirtyRegion *ownDirty;
     UDP udp;
+    StreamReceiver stream;
     int lastUpdated;
     char localIP[24];
     char macAddress[20];
     int port;
+    Color colorMapTable[COLOR_MAP_SIZE];
+    const Color *colorMapStops;
+    int colorMapStopCount;
+    const CRGBPalette256 *colorMapPalette;
+    int colorMapBrightness;
+
+    void markDirty(int x0, int y0, int z0, int x1, int y1, int z1);
+    void clearDirty(void);
+    void blendVoxel(int x, int y, int z, CRGB c, int weight, uint8_t blend);
+    void segmentAA(Point p1, Point p2, Color col, uint8_t blend, bool fullStart, bool fullEnd);
+    void segmentAA(PointQ p1, PointQ p2, Color col, uint8_t blend, bool fullStart, bool fullEnd);
+    void stepAA(const int32_t *s, const int32_t *e, Color col, uint8_t blend, bool fullStart, bool fullEnd);
+    void buildColorMap(void);
+    void bindOutput(void);
+    void updateOutputMap(void);
 
   public:
-    int size;
     int maxBrightness;
     Point center;
     float theta, phi;
@@ -102,31 +405,77 @@ class Cube {
     void setVoxel(int x, int y, int z, Color col);
 	void setVoxel(int index, Color col);
     void setVoxel(Point p, Color col);
+    void setVoxel(PointQ p, Color col);
 	void setBrightness(int value);
     Color getVoxel(int x, int y, int z);
 	Color getVoxel(int index);
     Color getVoxel(Point p);
-	Color Wheel(byte wheelPos, float opacity=1.0);
+    Color getVoxel(PointQ p);
+	Color Wheel(byte wheelPos);
+	Color Wheel(byte wheelPos, float opacity);
 	int getBrightness(void);
     void line(int x1, int y1, int z1, int x2, int y2, int z2, Color col);
     void line(Point p1, Point p2, Color col);
+    void line(PointQ p1, PointQ p2, Color col);
+    void lineAA(Point p1, Point p2, Color col, uint8_t blend=BLEND_ADD);
+    void polylineAA(const Point *points, int count, Color col, uint8_t blend=BLEND_ADD);
+    void lineAA(PointQ p1, PointQ p2, Color col, uint8_t blend=BLEND_ADD);
+    void polylineAA(const PointQ *points, int count, Color col, uint8_t blend=BLEND_ADD);
     void sphere(int x, int y, int z, int r, Color col);
     void sphere(Point p, int r, Color col);
+    void sphere(PointQ p, int r, Color col);
     void shell(float x, float y, float z, float r, Color col);
     void shell(float x, float y, float z, float r, float thickness, Color col);
     void shell(Point p, float r, Color col);
     void shell(Point p, float r, float thickness, Color col);
+    void shell(PointQ p, int16_t r, Color col);
+    void shell(PointQ p, int16_t r, int16_t thickness, Color col);
+    void draw(CubeCommandList &list);
+    void draw(SdfScene &scene, int root=-1);
+    void draw(ParticleSystem &particles);
+    void composite(LayerStack &layers);
 	void updateAccelerometer();
+    void setMotion(MotionSampler *sampler);
     void background(Color col);
-	void clear();
+	void clear(bool show=true);
 	void fadeall();
 	void fade(float coeff=0.0625f, bool show=true);
+	DirtyRegion getDirtyRegion(void);
+
+    CRGB *voxels(void);
+    CRGB *slice(int z);
+    CRGB *row(int x, int z);
+    void fillBox(int x0, int y0, int z0, int x1, int y1, int z1, Color col);
+    void copySlice(int fromZ, int toZ);
+    void scaleVolume(uint8_t scale);
+    void blendVolume(const CRGB *overlay, fract8 amount);
+    void blur(fract8 amount);
+    void setTarget(VoxelBuffer *buffer);
+    VoxelBuffer *getTarget(void);
+    void copyTo(VoxelBuffer &buffer);
+    void copyFrom(const VoxelBuffer &buffer);
+    void crossFade(const VoxelBuffer &from, const VoxelBuffer &to, fract8 amount);
+    void transform(const VoxelTransform &t);
+    void translate(int dx, int dy, int dz, bool wrap=false);
 
     Color colorMap(float val, float min, float max);
+    Color colorMap(int position);
+    void setColorMap(const Color *stops, int count);
+    void setColorMap(const CRGBPalette256 &palette);
+    void resetColorMap(void);
     Color lerpColor(Color a, Color b, int val, int min, int max);
 
     void begin(void);
     void show(void);
+    void setDoubleBuffered(bool enabled, bool preserve=false);
+    bool isDoubleBuffered(void);
+    void setWiring(const WiringMap &map);
+    void setWiring(const uint16_t *table);
+    void setUpright(bool enabled);
+    bool isUpright(void);
+    bool updateOrientation(int x, int y, int z);
+    void setOrientation(int orientation);
+    int getOrientation(void);
     void listen(void);
     void initButtons(void);
     void onlineOfflineSwitch(void);
@@ -4,6 +4,10 @@
 #include <stdint.h>
 
 #include <math.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "FastLED.h"
 
@@ -427,6 +431,91 @@ void blurColumns(CRGB* leds, uint8_t width, uint8_t height, fract8 blur_amount)
 }
 
 
+// Lines blurred together by blurLines, at most; their carryover is kept on
+// the stack.
+#define BLUR_LINES_BLOCK 64
+
+// One step of blurLines over 'n' bytes: blur1d's loop body applied to every
+// channel of a run of adjacent pixels.  'prev' is the previous run along the
+// lines, or NULL on the first step.
+static void blurStep( uint8_t* cur, uint8_t* prev, uint8_t* carry, uint16_t n,
+                      uint8_t keep, uint8_t seep)
+{
+    uint16_t k = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i keep16 = _mm_set1_epi16( keep);
+    const __m128i seep16 = _mm_set1_epi16( seep);
+    for( ; k + 16 <= n; k += 16) {
+        __m128i c = _mm_loadu_si128( (const __m128i*)(cur + k));
+        __m128i lo = _mm_unpacklo_epi8( c, zero);
+        __m128i hi = _mm_unpackhi_epi8( c, zero);
+        __m128i part = _mm_packus_epi16( _mm_srli_epi16( _mm_mullo_epi16( lo, seep16), 8),
+                                         _mm_srli_epi16( _mm_mullo_epi16( hi, seep16), 8));
+        c = _mm_packus_epi16( _mm_srli_epi16( _mm_mullo_epi16( lo, keep16), 8),
+                              _mm_srli_epi16( _mm_mullo_epi16( hi, keep16), 8));
+        c = _mm_adds_epu8( c, _mm_loadu_si128( (const __m128i*)(carry + k)));
+        if( prev) {
+            __m128i p = _mm_loadu_si128( (const __m128i*)(prev + k));
+            _mm_storeu_si128( (__m128i*)(prev + k), _mm_adds_epu8( p, part));
+        }
+        _mm_storeu_si128( (__m128i*)(cur + k), c);
+        _mm_storeu_si128( (__m128i*)(carry + k), part);
+    }
+#endif
+    for( ; k < n; k++) {
+        uint8_t c = cur[k];
+        uint8_t part = scale8( c, seep);
+        c = qadd8( scale8( c, keep), carry[k]);
+        if( prev) prev[k] = qadd8( prev[k], part);
+        cur[k] = c;
+        carry[k] = part;
+    }
+}
+
+// blurLines: perform a blur1d on 'count' lines at once
+void blurLines( CRGB* leds, uint16_t count, uint16_t length, uint16_t stride, fract8 blur_amount)
+{
+    uint8_t keep = 255 - blur_amount;
+    uint8_t seep = blur_amount >> 1;
+    uint8_t carry[BLUR_LINES_BLOCK * 3];
+    for( uint16_t first = 0; first < count; first += BLUR_LINES_BLOCK) {
+        uint16_t n = count - first;
+        if( n > BLUR_LINES_BLOCK) n = BLUR_LINES_BLOCK;
+        n *= 3;
+        memset( carry, 0, n);
+        uint8_t* prev = NULL;
+        for( uint16_t i = 0; i < length; i++) {
+            uint8_t* cur = (uint8_t*)(leds + first + (uint32_t)i * stride);
+            blurStep( cur, prev, carry, n, keep, seep);
+            prev = cur;
+        }
+    }
+}
+
+// blurAxis: perform a blur1d along one axis of a volume
+void blurAxis( CRGB* leds, uint32_t total, uint8_t length, uint16_t stride, fract8 blur_amount)
+{
+    uint32_t span = (uint32_t)stride * length;
+    if( span == 0) return;
+    for( uint32_t start = 0; start < total; start += span) {
+        if( stride == 1) {
+            blur1d( leds + start, length, blur_amount);
+        } else {
+            blurLines( leds + start, stride, length, stride, blur_amount);
+        }
+    }
+}
+
+// blur3d: three-dimensional blur filter, for a volume stored x fastest
+void blur3d( CRGB* leds, uint8_t width, uint8_t height, uint8_t depth, fract8 blur_amount)
+{
+    uint32_t total = (uint32_t)width * height * depth;
+    blurAxis( leds, total, width, 1, blur_amount);
+    blurAxis( leds, total, height, width, blur_amount);
+    blurAxis( leds, total, depth, (uint16_t)width * height, blur_amount);
+}
+
 
 // CRGB HeatColor( uint8_t temperature)
 //
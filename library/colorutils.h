@@ -317,6 +317,38 @@ void blurRows( CRGB* leds, uint8_t width, uint8_t height, fract8 blur_amount);
 // blurColumns: perform a blur1d on each column of a rectangular matrix
 void blurColumns(CRGB* leds, uint8_t width, uint8_t height, fract8 blur_amount);
 
+// blurLines: perform a blur1d on 'count' lines at once.  Line j starts at
+// leds[j] and its pixels are 'stride' apart, so each step of the blur works
+// on a run of 'count' adjacent pixels, which is cache friendly and lets the
+// inner loop use SIMD instructions where the host has them.
+void blurLines( CRGB* leds, uint16_t count, uint16_t length, uint16_t stride, fract8 blur_amount);
+
+// blurAxis: perform a blur1d along one axis of a volume of 'total' pixels,
+// where that axis has 'length' pixels 'stride' apart, and the axes that vary
+// faster than it fill the 'stride' pixels in between.
+void blurAxis( CRGB* leds, uint32_t total, uint8_t length, uint16_t stride, fract8 blur_amount);
+
+// blur3d: three-dimensional blur filter. Spreads light to 26 XYZ neighbors,
+// as separable blur1d passes along x, then y, then z.  The volume is
+// stored x fastest, then y, then z: (z * height + y) * width + x.
+void blur3d( CRGB* leds, uint8_t width, uint8_t height, uint8_t depth, fract8 blur_amount);
+
+// blur3d<MAPPER>: the same, for a volume stored in another order.
+// MAPPER::index(x, y, z) gives the index of a pixel; it must fill the volume
+// with strides that are constant along each axis, like VoxelGrid::index, e.g.
+//     blur3d<VoxelGrid<8> >( leds, 8, 8, 8, 64);
+// The strides are worked out from the mapper at compile time, so no index is
+// computed per pixel.
+template <class MAPPER>
+void blur3d( CRGB* leds, uint8_t width, uint8_t height, uint8_t depth, fract8 blur_amount)
+{
+    uint32_t total = (uint32_t)width * height * depth;
+    CRGB* base = leds + MAPPER::index( 0, 0, 0);
+    blurAxis( base, total, width,  MAPPER::index( 1, 0, 0) - MAPPER::index( 0, 0, 0), blur_amount);
+    blurAxis( base, total, height, MAPPER::index( 0, 1, 0) - MAPPER::index( 0, 0, 0), blur_amount);
+    blurAxis( base, total, depth,  MAPPER::index( 0, 0, 1) - MAPPER::index( 0, 0, 0), blur_amount);
+}
+
 
 // CRGB HeatColor( uint8_t temperature)
 //
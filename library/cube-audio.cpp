@@ -0,0 +1,294 @@
+#include "cube-audio.h"
+
+/** sin(2 pi k / 256) in Q15, for k up to 3/4 of a turn so that cos(x) = sine[k + 64] needs no wrapping. */
+static const int16_t sine[AUDIO_FFT_MAX_POINTS * 3 / 4 + 1] = {
+  0, 804, 1608, 2410, 3212, 4011, 4808, 5602, 6393, 7179, 7962, 8739,
+  9512, 10278, 11039, 11793, 12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+  18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594, 23170, 23731, 24279, 24811,
+  25329, 25832, 26319, 26790, 27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+  30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971, 32137, 32285, 32412, 32521,
+  32609, 32678, 32728, 32757, 32767, 32757, 32728, 32678, 32609, 32521, 32412, 32285,
+  32137, 31971, 31785, 31580, 31356, 31113, 30852, 30571, 30273, 29956, 29621, 29268,
+  28898, 28510, 28105, 27683, 27245, 26790, 26319, 25832, 25329, 24811, 24279, 23731,
+  23170, 22594, 22005, 21403, 20787, 20159, 19519, 18868, 18204, 17530, 16846, 16151,
+  15446, 14732, 14010, 13279, 12539, 11793, 11039, 10278, 9512, 8739, 7962, 7179,
+  6393, 5602, 4808, 4011, 3212, 2410, 1608, 804, 0, -804, -1608, -2410,
+  -3212, -4011, -4808, -5602, -6393, -7179, -7962, -8739, -9512, -10278, -11039, -11793,
+  -12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530, -18204, -18868, -19519, -20159,
+  -20787, -21403, -22005, -22594, -23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+  -27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956, -30273, -30571, -30852, -31113,
+  -31356, -31580, -31785, -31971, -32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+  -32767
+};
+#define QUARTER_TURN (AUDIO_FFT_MAX_POINTS / 4)
+
+/** Indices of the complex FFT of the largest size, AUDIO_FFT_MAX_BITS - 1 bits, reversed. Smaller
+  sizes shift out the low bits. */
+static const uint8_t bitReverse[AUDIO_FFT_MAX_POINTS / 2] = {
+  0, 64, 32, 96, 16, 80, 48, 112, 8, 72, 40, 104, 24, 88, 56, 120,
+  4, 68, 36, 100, 20, 84, 52, 116, 12, 76, 44, 108, 28, 92, 60, 124,
+  2, 66, 34, 98, 18, 82, 50, 114, 10, 74, 42, 106, 26, 90, 58, 122,
+  6, 70, 38, 102, 22, 86, 54, 118, 14, 78, 46, 110, 30, 94, 62, 126,
+  1, 65, 33, 97, 17, 81, 49, 113, 9, 73, 41, 105, 25, 89, 57, 121,
+  5, 69, 37, 101, 21, 85, 53, 117, 13, 77, 45, 109, 29, 93, 61, 125,
+  3, 67, 35, 99, 19, 83, 51, 115, 11, 75, 43, 107, 27, 91, 59, 123,
+  7, 71, 39, 103, 23, 87, 55, 119, 15, 79, 47, 111, 31, 95, 63, 127
+};
+
+/** Construct an analyzer with silence in its history.
+
+  @param points Samples per transform: 64, 128 or 256.
+  @param bands Number of bands, up to AUDIO_MAX_BANDS.
+*/
+AudioAnalyzer::AudioAnalyzer(uint16_t points, uint8_t bands) :
+    head(0),
+    bits(7),
+    bandCount(0),
+    holdFrames(8),
+    peakKeep(60000),
+    ceiling(AUDIO_MIN_CEILING),
+    ceilingKeep(65200)
+{
+  memset(this->history, 0, sizeof(this->history));
+  memset(this->magnitudes, 0, sizeof(this->magnitudes));
+  this->setPoints(points);
+  this->setBands(bands);
+}
+
+/** Change the number of samples per transform. More points split the frequencies more finely, but take
+  longer to sample and to transform.
+
+  @param points 64, 128 or 256.
+
+  @return False, leaving the size as it was, if points is not one of them.
+*/
+bool AudioAnalyzer::setPoints(uint16_t points)
+{
+  uint8_t bits;
+  switch(points) {
+    case 64: bits = 6; break;
+    case 128: bits = 7; break;
+    case 256: bits = 8; break;
+    default: return false;
+  }
+  this->bits = bits;
+  if(this->bandCount)
+    this->setBands(this->bandCount);
+  return true;
+}
+
+/** Change the number of bands, and spread them evenly over the octaves from the lowest frequency
+  bin to the highest. At the low end, where bins are further apart than that, each band gets one bin.
+
+  @param bands 1 to AUDIO_MAX_BANDS.
+*/
+void AudioAnalyzer::setBands(uint8_t bands)
+{
+  if(bands < 1)
+    bands = 1;
+  if(bands > AUDIO_MAX_BANDS)
+    bands = AUDIO_MAX_BANDS;
+  // bin 0 is the bias of the microphone, so the bands cover bins 1 to bins() - 1
+  int last = this->bins();
+  float ratio = logf(last) / bands;
+  this->edges[0] = 1;
+  for(int b = 1; b <= bands; b++) {
+    int edge = (int)(expf(ratio * b) + 0.5f);
+    if(edge <= this->edges[b - 1])
+      edge = this->edges[b - 1] + 1;
+    if(edge > last - (bands - b))
+      edge = last - (bands - b);
+    this->edges[b] = edge;
+  }
+  this->bandCount = bands;
+  memset(this->bandLevels, 0, sizeof(this->bandLevels));
+  memset(this->peakLevels, 0, sizeof(this->peakLevels));
+  memset(this->peakTimers, 0, sizeof(this->peakTimers));
+}
+
+/** Change how the peaks of the bands fall back.
+
+  @param frames Calls to analyze() a peak stays put before it starts to fall.
+  @param keep How much of a falling peak is left after each call, out of 65536.
+*/
+void AudioAnalyzer::setPeakHold(uint8_t frames, uint16_t keep)
+{
+  this->holdFrames = frames;
+  this->peakKeep = keep;
+}
+
+/** Add a sample to the history, pushing out the oldest one.
+
+  @param sample The sample in Q15, bias removed.
+*/
+void AudioAnalyzer::addSample(int16_t sample)
+{
+  this->history[this->head] = sample;
+  this->head = (this->head + 1) & (AUDIO_FFT_MAX_POINTS - 1);
+}
+
+/** Read samples from the ADC into the history at a steady rate.
+
+  @param pin The analog pin of the microphone, read as 12 bits with the bias at 2048.
+  @param count How many samples to read, usually points().
+  @param intervalMicros Time from one sample to the next, which sets the highest frequency seen to
+  half of 1000000 / intervalMicros Hz.
+*/
+void AudioAnalyzer::sample(uint16_t pin, uint16_t count, uint16_t intervalMicros)
+{
+  uint32_t next = micros();
+  for(uint16_t i = 0; i < count; i++) {
+    while((int32_t)(micros() - next) < 0)
+      ;
+    next += intervalMicros;
+    int32_t s = (analogRead(pin) - 2048) << 4;
+    this->addSample(s > 32767 ? 32767 : s < -32768 ? -32768 : s);
+  }
+}
+
+/** Transform complex points in place, in Q15. The points are halved first, so that none is longer than
+  23170 even at full scale on both parts, and each stage halves its results so that none grows longer
+  than that: nothing can overflow, for any input. The whole transform is divided by twice the number
+  of points.
+
+  @param re, im The real and imaginary parts, in order; replaced by the transform.
+  @param bits log2 of the number of points, at most AUDIO_FFT_MAX_BITS - 1.
+*/
+void AudioAnalyzer::fft(int16_t *re, int16_t *im, uint8_t bits)
+{
+  const int n = 1 << bits;
+  const int unused = AUDIO_FFT_MAX_BITS - 1 - bits;
+  for(int i = 0; i < n; i++) {
+    int j = bitReverse[i] >> unused;
+    if(i < j) {
+      int16_t t = re[i]; re[i] = re[j] >> 1; re[j] = t >> 1;
+      t = im[i]; im[i] = im[j] >> 1; im[j] = t >> 1;
+    } else if(i == j) {
+      re[i] >>= 1;
+      im[i] >>= 1;
+    }
+  }
+
+  // twiddle j of a stage of span 2 * half is exp(-2 pi i j / (2 * half)), entry j * stride of the table
+  for(int half = 1, stride = AUDIO_FFT_MAX_POINTS / 2; half < n; half <<= 1, stride >>= 1) {
+    for(int j = 0; j < half; j++) {
+      int32_t c = sine[j * stride + QUARTER_TURN];
+      int32_t s = sine[j * stride];
+      for(int i = j; i < n; i += 2 * half) {
+        int k = i + half;
+        // (c - i s) times point k, halved with the 15 bits of the product
+        int32_t tr = (c * re[k] + s * im[k]) >> 16;
+        int32_t ti = (c * im[k] - s * re[k]) >> 16;
+        int32_t ur = re[i] >> 1, ui = im[i] >> 1;
+        re[k] = ur - tr;
+        im[k] = ui - ti;
+        re[i] = ur + tr;
+        im[i] = ui + ti;
+      }
+    }
+  }
+}
+
+/** The length of a vector without a square root, as the larger of max and 7/8 max + 1/2 min;
+  within 3% of the true length. */
+static inline uint32_t magnitudeOf(int32_t x, int32_t y)
+{
+  uint32_t a = x < 0 ? -x : x;
+  uint32_t b = y < 0 ? -y : y;
+  uint32_t big = a > b ? a : b, small = a > b ? b : a;
+  uint32_t estimate = big - (big >> 3) + (small >> 1);
+  return estimate > big ? estimate : big;
+}
+
+/** Transform the most recent points() samples, and update the bands, their peaks and the ceiling. */
+void AudioAnalyzer::analyze(void)
+{
+  const int n = this->points();
+  const int m = n / 2;
+  const int unused = AUDIO_FFT_MAX_BITS - this->bits;
+
+  // window the samples and pack even ones into the real parts, odd ones into the imaginary parts;
+  // the Hann window is sin^2(pi t / n) = (1 - cos(2 pi t / n)) / 2, symmetric about n / 2
+  uint16_t at = (this->head - n) & (AUDIO_FFT_MAX_POINTS - 1);
+  for(int t = 0; t < n; t++) {
+    int turn = (t <= m ? t : n - t) << unused;
+    int32_t window = (32767 - sine[turn + QUARTER_TURN]) >> 1;
+    int16_t windowed = (this->history[at] * window) >> 15;
+    at = (at + 1) & (AUDIO_FFT_MAX_POINTS - 1);
+    if(t & 1)
+      this->im[t >> 1] = windowed;
+    else
+      this->re[t >> 1] = windowed;
+  }
+
+  fft(this->re, this->im, this->bits - 1);
+
+  // split the transform of the packed points Z into the spectrum X of the real samples:
+  // X[k] = E[k] + W^k O[k], with E[k] = (Z[k] + Z*[m - k]) / 2 and O[k] = (Z[k] - Z*[m - k]) / 2i;
+  // fft divided Z by 2m, so leaving out the halves here keeps X divided by m as before
+  for(int k = 0; k < m; k++) {
+    int r = (m - k) & (m - 1);
+    int32_t er = this->re[k] + this->re[r];
+    int32_t ei = this->im[k] - this->im[r];
+    int32_t or_ = this->im[k] + this->im[r];
+    int32_t oi = this->re[r] - this->re[k];
+    int32_t c = sine[(k << unused) + QUARTER_TURN];
+    int32_t s = sine[k << unused];
+    int32_t xr = er + ((c * or_ + s * oi) >> 15);
+    int32_t xi = ei + ((c * oi - s * or_) >> 15);
+    uint32_t magnitude = magnitudeOf(xr, xi);
+    this->magnitudes[k] = magnitude > 0xffff ? 0xffff : magnitude;
+  }
+
+  uint16_t loudest = 0;
+  for(int b = 0; b < this->bandCount; b++) {
+    uint16_t level = 0;
+    for(int k = this->edges[b]; k < this->edges[b + 1]; k++)
+      if(this->magnitudes[k] > level)
+        level = this->magnitudes[k];
+    this->bandLevels[b] = level;
+    if(level > loudest)
+      loudest = level;
+
+    if(level >= this->peakLevels[b]) {
+      this->peakLevels[b] = level;
+      this->peakTimers[b] = this->holdFrames;
+    } else if(this->peakTimers[b]) {
+      this->peakTimers[b]--;
+    } else {
+      this->peakLevels[b] = ((uint32_t)this->peakLevels[b] * this->peakKeep) >> 16;
+    }
+  }
+
+  this->ceiling = ((uint32_t)this->ceiling * this->ceilingKeep) >> 16;
+  if(loudest > this->ceiling)
+    this->ceiling = loudest;
+  if(this->ceiling < AUDIO_MIN_CEILING)
+    this->ceiling = AUDIO_MIN_CEILING;
+}
+
+/** The level of a band as a height, such as the number of voxels of a column to light.
+
+  @param index The band, 0 for the lowest.
+  @param height The height of the loudest band of late.
+
+  @return 0 to height.
+*/
+uint8_t AudioAnalyzer::level(int index, uint8_t height) const
+{
+  uint32_t h = (uint32_t)this->bandLevels[index] * height / this->ceiling;
+  return h > height ? height : h;
+}
+
+/** The peak of a band as a height, on the same scale as level().
+
+  @param index The band, 0 for the lowest.
+  @param height The height of the loudest band of late.
+
+  @return 0 to height.
+*/
+uint8_t AudioAnalyzer::peakLevel(int index, uint8_t height) const
+{
+  uint32_t h = (uint32_t)this->peakLevels[index] * height / this->ceiling;
+  return h > height ? height : h;
+}
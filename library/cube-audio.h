@@ -0,0 +1,75 @@
+#ifndef _L3D_AUDIO_H
+#define _L3D_AUDIO_H
+
+#include "beta-cube-library-fastled.h"
+
+/**   log2 of the largest number of points an AudioAnalyzer transforms. Its twiddle and bit reversal
+      tables are built for this size and the smaller sizes step through them. */
+#define AUDIO_FFT_MAX_BITS 8
+#define AUDIO_FFT_MAX_POINTS (1 << AUDIO_FFT_MAX_BITS)
+
+/**   Most bands an AudioAnalyzer groups its frequencies into: a column of a cube of up to 16 each. */
+#ifndef AUDIO_MAX_BANDS
+#define AUDIO_MAX_BANDS 16
+#endif
+
+/**   The loudest band level is never taken to be quieter than this, so that silence is not scaled up
+      into a full display of noise. */
+#ifndef AUDIO_MIN_CEILING
+#define AUDIO_MIN_CEILING 100
+#endif
+
+/**   A spectrum analyzer for a microphone, in Q15 fixed point.
+      Samples go into a ring buffer of the last AUDIO_FFT_MAX_POINTS; analyze() takes the most recent
+      64, 128 or 256 of them through a Hann window and a real input FFT: the samples are packed two to a
+      complex point, transformed at half the size and split into the spectrum after, with twiddles and
+      bit reversal from tables. Magnitudes are approximated without a square root and grouped into
+      log spaced bands, so that each octave gets about the same share of the columns of the cube, and
+      every band keeps a peak that holds for a while and then decays.
+      Levels are scaled to the loudest band of late, which also decays, so quiet and loud sound both
+      fill the display.
+*/
+class AudioAnalyzer {
+  private:
+    int16_t history[AUDIO_FFT_MAX_POINTS];
+    uint16_t head;
+    int16_t re[AUDIO_FFT_MAX_POINTS / 2], im[AUDIO_FFT_MAX_POINTS / 2];
+    uint16_t magnitudes[AUDIO_FFT_MAX_POINTS / 2];
+    uint8_t bits;
+    uint8_t bandCount;
+    uint8_t edges[AUDIO_MAX_BANDS + 1];
+    uint16_t bandLevels[AUDIO_MAX_BANDS];
+    uint16_t peakLevels[AUDIO_MAX_BANDS];
+    uint8_t peakTimers[AUDIO_MAX_BANDS];
+    uint8_t holdFrames;
+    uint16_t peakKeep;
+    uint16_t ceiling;
+    uint16_t ceilingKeep;
+
+  public:
+    AudioAnalyzer(uint16_t points=128, uint8_t bands=8);
+
+    bool setPoints(uint16_t points);
+    void setBands(uint8_t bands);
+    void setPeakHold(uint8_t frames, uint16_t keep);
+    void setCeilingDecay(uint16_t keep) { this->ceilingKeep = keep; }
+
+    void addSample(int16_t sample);
+    void sample(uint16_t pin, uint16_t count, uint16_t intervalMicros);
+    void analyze(void);
+
+    uint16_t points(void) const { return 1 << this->bits; }
+    uint8_t bands(void) const { return this->bandCount; }
+    uint16_t bins(void) const { return 1 << (this->bits - 1); }
+    uint16_t magnitude(int bin) const { return this->magnitudes[bin]; }
+    uint16_t band(int index) const { return this->bandLevels[index]; }
+    uint16_t peak(int index) const { return this->peakLevels[index]; }
+    uint8_t firstBin(int index) const { return this->edges[index]; }
+    uint16_t getCeiling(void) const { return this->ceiling; }
+    uint8_t level(int index, uint8_t height) const;
+    uint8_t peakLevel(int index, uint8_t height) const;
+
+    static void fft(int16_t *re, int16_t *im, uint8_t bits);
+};
+
+#endif
@@ -0,0 +1,352 @@
+#include "beta-cube-library-fastled.h"
+#include "cube-raster.h"
+
+/** Rasterizer sink that turns the voxels of one slab into runs of a command list. */
+struct RunSink {
+  CubeRun *runs;
+  int capacity;
+  int count;
+  bool overflowed;
+  DirtyRegion bounds;
+  int slab;
+  CRGB color;
+
+  RunSink(CubeRun *runs, int capacity) : runs(runs), capacity(capacity), count(0), overflowed(false), slab(0) {}
+
+  void emit(int start, int length) {
+    if(this->count) {
+      // join the previous run if this one continues it along the same row
+      CubeRun &last = this->runs[this->count - 1];
+      if(last.color == this->color && last.start + last.length == start && last.length + length <= 255 &&
+          last.start / Cube::size == start / Cube::size) {
+        last.length += length;
+        this->bounds.include(Cube::indexX(start), Cube::indexY(start) + length - 1, this->slab);
+        return;
+      }
+    }
+    if(this->count == this->capacity) {
+      this->overflowed = true;
+      return;
+    }
+    CubeRun &run = this->runs[this->count++];
+    run.start = start;
+    run.length = length;
+    run.color = this->color;
+    this->bounds.include(Cube::indexX(start), Cube::indexY(start), this->slab);
+    this->bounds.include(Cube::indexX(start), Cube::indexY(start) + length - 1, this->slab);
+  }
+
+  void plot(int x, int y, int z) {
+    if(z == this->slab && Cube::contains(x, y, z))
+      this->emit(Cube::index(x, y, z), 1);
+  }
+  void set(int x, int y, int z) { this->emit(Cube::index(x, y, z), 1); }
+  void span(int x, int z, int y0, int y1) { this->emit(Cube::index(x, y0, z), y1 - y0 + 1); }
+};
+
+static inline bool fitsInt16(int v)
+{
+  return v >= -32768 && v <= 32767;
+}
+
+/** Clip a range of voxels along one axis to the cube.
+
+  @param lo, hi The range.
+  @param a, b Set to the range clipped.
+
+  @return False if the range misses the cube.
+*/
+static bool clipRange(int lo, int hi, uint8_t &a, uint8_t &b)
+{
+  if(hi < 0 || lo >= Cube::size)
+    return false;
+  a = (lo < 0) ? 0 : lo;
+  b = (hi >= Cube::size) ? Cube::size - 1 : hi;
+  return true;
+}
+
+/** Construct an empty command list.
+
+  @param commands Storage for up to capacity commands.
+  @param capacity Largest number of commands the list holds.
+  @param runs Storage for the runs the list compiles to.
+  @param runCapacity Largest number of runs. A list that needs more is drawn command by command instead.
+*/
+CubeCommandList::CubeCommandList(CubeCommand *commands, int capacity, CubeRun *runs, int runCapacity) :
+  commands(commands),
+  capacity(capacity),
+  count(0),
+  runs(runs),
+  runCapacity(runCapacity),
+  runCount(0),
+  compiled(false),
+  overflowed(false)
+{ }
+
+/** Remove all commands. */
+void CubeCommandList::clear(void)
+{
+  this->count = 0;
+  this->runCount = 0;
+  this->compiled = false;
+  this->overflowed = false;
+}
+
+/** Append a command and mark the list for compiling again.
+
+  @return False if the list is full.
+*/
+bool CubeCommandList::add(const CubeCommand &command)
+{
+  if(this->count == this->capacity)
+    return false;
+  this->commands[this->count++] = command;
+  this->compiled = false;
+  this->overflowed = false;
+  return true;
+}
+
+/** Record setting a voxel. Voxels outside the cube are dropped.
+
+  @param x, y, z Coordinate of the voxel.
+  @param col Color to set the voxel to.
+
+  @return False if the list is full.
+*/
+bool CubeCommandList::setVoxel(int x, int y, int z, Color col)
+{
+  if(!Cube::contains(x, y, z))
+    return true;
+  CubeCommand command;
+  command.type = CUBE_COMMAND_VOXEL;
+  command.x0 = command.x1 = x;
+  command.y0 = command.y1 = y;
+  command.z0 = command.z1 = z;
+  command.color = CRGB(col.red, col.green, col.blue);
+  command.args.i[0] = x;
+  command.args.i[1] = y;
+  command.args.i[2] = z;
+  return this->add(command);
+}
+
+/** Record setting a voxel.
+
+  @param p Coordinate of the voxel.
+  @param col Color to set the voxel to.
+
+  @return False if the list is full.
+*/
+bool CubeCommandList::setVoxel(Point p, Color col)
+{
+  return this->setVoxel(p.x, p.y, p.z, col);
+}
+
+/** Record drawing a line, as Cube::line does. The steps of the line that fall inside the cube are
+  found here, once, so compiling never walks the parts outside it. Lines that miss the cube are dropped.
+
+  @param x1, y1, z1 Coordinate of start of line.
+  @param x2, y2, z2 Coordinate of end of line.
+  @param col Color of the line.
+
+  @return False if the list is full or a coordinate does not fit in an int16_t.
+*/
+bool CubeCommandList::line(int x1, int y1, int z1, int x2, int y2, int z2, Color col)
+{
+  if(!fitsInt16(x1) || !fitsInt16(y1) || !fitsInt16(z1) || !fitsInt16(x2) || !fitsInt16(y2) || !fitsInt16(z2))
+    return false;
+  LineSteps steps(x1, y1, z1, x2, y2, z2);
+  int first = 0, last = steps.count;
+  for(int a = 0; a < 3; a++)
+    if(!steps.within(a, 0, Cube::size - 1, first, last))
+      return true;
+  CubeCommand command;
+  uint8_t *box[3][2] = { { &command.x0, &command.x1 }, { &command.y0, &command.y1 }, { &command.z0, &command.z1 } };
+  for(int a = 0; a < 3; a++) {
+    int from = steps.coordinate(a, first), to = steps.coordinate(a, last);
+    *box[a][0] = (from < to) ? from : to;
+    *box[a][1] = (from < to) ? to : from;
+  }
+  command.type = CUBE_COMMAND_LINE;
+  command.color = CRGB(col.red, col.green, col.blue);
+  int16_t *ends = command.args.line.ends;
+  ends[0] = x1;
+  ends[1] = y1;
+  ends[2] = z1;
+  ends[3] = x2;
+  ends[4] = y2;
+  ends[5] = z2;
+  command.args.line.first = first;
+  command.args.line.last = last;
+  return this->add(command);
+}
+
+/** Record drawing a line.
+
+  @param p1 Coordinate of start of line.
+  @param p2 Coordinate of end of line.
+  @param col Color of the line.
+
+  @return False if the list is full or a coordinate does not fit in an int16_t.
+*/
+bool CubeCommandList::line(Point p1, Point p2, Color col)
+{
+  return this->line(p1.x, p1.y, p1.z, p2.x, p2.y, p2.z, col);
+}
+
+/** Record drawing a filled sphere, as Cube::sphere does. Spheres that miss the cube are dropped.
+
+  @param x, y, z Position of the center of the sphere.
+  @param r Radius of the sphere.
+  @param col Color of the sphere.
+
+  @return False if the list is full or a coordinate does not fit in an int16_t.
+*/
+bool CubeCommandList::sphere(int x, int y, int z, int r, Color col)
+{
+  if(!fitsInt16(x) || !fitsInt16(y) || !fitsInt16(z) || !fitsInt16(r))
+    return false;
+  CubeCommand command;
+  if(r < 0 || !clipRange(x - r, x + r, command.x0, command.x1) || !clipRange(y - r, y + r, command.y0, command.y1) ||
+      !clipRange(z - r, z + r, command.z0, command.z1))
+    return true;
+  command.type = CUBE_COMMAND_SPHERE;
+  command.color = CRGB(col.red, col.green, col.blue);
+  command.args.i[0] = x;
+  command.args.i[1] = y;
+  command.args.i[2] = z;
+  command.args.i[3] = r;
+  return this->add(command);
+}
+
+/** Record drawing a filled sphere.
+
+  @param p Position of the center of the sphere.
+  @param r Radius of the sphere.
+  @param col Color of the sphere.
+
+  @return False if the list is full or a coordinate does not fit in an int16_t.
+*/
+bool CubeCommandList::sphere(Point p, int r, Color col)
+{
+  return this->sphere(p.x, p.y, p.z, r, col);
+}
+
+/** Record drawing a shell with the default thickness of Cube::shell.
+
+  @param x, y, z Position of the center of the shell.
+  @param r Radius of the shell.
+  @param col Color of the shell.
+
+  @return False if the list is full.
+*/
+bool CubeCommandList::shell(float x, float y, float z, float r, Color col)
+{
+  return this->shell(x, y, z, r, 0.1, col);
+}
+
+/** Record drawing a shell (empty sphere), as Cube::shell does. The box of voxels it can touch is found
+  here, once, and kept for compiling. Shells that miss the cube are dropped.
+
+  @param x, y, z Position of the center of the shell.
+  @param r Radius of the shell.
+  @param thickness Thickness of the shell.
+  @param col Color of the shell.
+
+  @return False if the list is full.
+*/
+bool CubeCommandList::shell(float x, float y, float z, float r, float thickness, Color col)
+{
+  int i0, i1, j0, j1, k0, k1;
+  if(!shellBounds<CUBE_SIZE>(x, y, z, r, thickness, i0, i1, j0, j1, k0, k1))
+    return true;
+  CubeCommand command;
+  command.type = CUBE_COMMAND_SHELL;
+  command.x0 = i0;
+  command.x1 = i1;
+  command.y0 = j0;
+  command.y1 = j1;
+  command.z0 = k0;
+  command.z1 = k1;
+  command.color = CRGB(col.red, col.green, col.blue);
+  command.args.f[0] = x;
+  command.args.f[1] = y;
+  command.args.f[2] = z;
+  command.args.f[3] = r;
+  command.args.f[4] = thickness;
+  return this->add(command);
+}
+
+/** Record drawing a shell with the default thickness of Cube::shell.
+
+  @param p Position of the center of the shell.
+  @param r Radius of the shell.
+  @param col Color of the shell.
+
+  @return False if the list is full.
+*/
+bool CubeCommandList::shell(Point p, float r, Color col)
+{
+  return this->shell(p.x, p.y, p.z, r, col);
+}
+
+/** Record drawing a shell (empty sphere).
+
+  @param p Position of the center of the shell.
+  @param r Radius of the shell.
+  @param thickness Thickness of the shell.
+  @param col Color of the shell.
+
+  @return False if the list is full.
+*/
+bool CubeCommandList::shell(Point p, float r, float thickness, Color col)
+{
+  return this->shell(p.x, p.y, p.z, r, thickness, col);
+}
+
+/** Compile the commands into runs of voxels. Cube::draw does this when the list has changed, so
+  calling it is only needed to move the work elsewhere.
+  Runs are produced slab by slab, and within a slab in the order the commands were recorded, so
+  drawing them lights the same voxels in the same colors as drawing the commands one by one.
+
+  @return False if the runs do not fit in the storage given to the constructor.
+*/
+bool CubeCommandList::compile(void)
+{
+  RunSink sink(this->runs, this->runCapacity);
+  for(int z = 0; z < Cube::size && !sink.overflowed; z++) {
+    sink.slab = z;
+    for(int c = 0; c < this->count; c++) {
+      const CubeCommand &command = this->commands[c];
+      if(z < command.z0 || z > command.z1)
+        continue;
+      const int16_t *i = command.args.i;
+      const float *f = command.args.f;
+      sink.color = command.color;
+      switch(command.type) {
+        case CUBE_COMMAND_VOXEL:
+          sink.set(i[0], i[1], i[2]);
+          break;
+        case CUBE_COMMAND_LINE: {
+          // only the steps of the line in this slab are walked
+          const int16_t *e = command.args.line.ends;
+          LineSteps steps(e[0], e[1], e[2], e[3], e[4], e[5]);
+          int first = command.args.line.first, last = command.args.line.last;
+          if(steps.within(AXIS_Z, z, z, first, last))
+            rasterLineSteps(steps, first, last, sink);
+          break;
+        }
+        case CUBE_COMMAND_SPHERE:
+          rasterSphere<CUBE_SIZE>(i[0], i[1], i[2], i[3], z, z, sink);
+          break;
+        case CUBE_COMMAND_SHELL:
+          rasterShell(f[0], f[1], f[2], f[3], f[4], command.x0, command.x1, command.y0, command.y1, z, z, sink);
+          break;
+      }
+    }
+  }
+  this->runCount = sink.overflowed ? 0 : sink.count;
+  this->bounds = sink.bounds;
+  this->compiled = !sink.overflowed;
+  this->overflowed = sink.overflowed;
+  return this->compiled;
+}
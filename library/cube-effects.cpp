@@ -0,0 +1,238 @@
+#include "cube-effects.h"
+
+/** Construct a scheduler with an empty playlist, cross-fading for a second and budgeting a frame at
+  60 frames per second.
+
+  @param cube The cube to draw into.
+*/
+EffectScheduler::EffectScheduler(Cube &cube) :
+    cube(&cube),
+    count(0),
+    current(-1),
+    outgoing(-1),
+    transition(1000000),
+    transitionElapsed(0),
+    played(0),
+    lastFrame(0),
+    budget(16667),
+    autoAdvance(true),
+    started(false)
+{ }
+
+/** Add an effect to the end of the playlist.
+
+  @param effect The effect. Used in place, so it must outlive the scheduler.
+  @param duration Milliseconds to play it for before moving on to the next one, or 0 to play it until
+  next() is called.
+
+  @return False if the playlist is full.
+*/
+bool EffectScheduler::add(Effect &effect, uint32_t duration)
+{
+  if(this->count == EFFECT_MAX_PLAYLIST)
+    return false;
+  EffectEntry &e = this->playlist[this->count++];
+  e.effect = &effect;
+  e.duration = duration;
+  e.averageMicros = 0;
+  e.worstMicros = 0;
+  e.overruns = 0;
+  e.updateMicros = 0;
+  e.calmFrames = 0;
+  return true;
+}
+
+/** Start playing an effect of the playlist, cross-fading from the one playing.
+  A transition still running is finished first.
+
+  @param index Position of the effect in the playlist.
+*/
+void EffectScheduler::play(int index)
+{
+  if(index < 0 || index >= this->count)
+    return;
+  if(this->outgoing >= 0)
+    this->finishTransition();
+  if(index == this->current)
+    return;
+
+  Effect *effect = this->playlist[index].effect;
+  this->playlist[index].updateMicros = 0;
+  if(this->current < 0 || this->transition == 0) {
+    this->current = index;
+    this->cube->clear(false);
+    effect->init(*this->cube);
+  } else {
+    // the outgoing effect carries on from what it last drew; the incoming one starts from black
+    this->cube->copyTo(this->buffers[0]);
+    this->buffers[1].clear();
+    this->outgoing = this->current;
+    this->current = index;
+    this->transitionElapsed = 0;
+    this->cube->setTarget(&this->buffers[1]);
+    effect->init(*this->cube);
+    this->cube->setTarget(NULL);
+  }
+  this->played = 0;
+}
+
+/** Move on to the next effect of the playlist, after the last one back to the first. */
+void EffectScheduler::next(void)
+{
+  if(this->count)
+    this->play((this->current + 1) % this->count);
+}
+
+/** Go back to the previous effect of the playlist, before the first one to the last. */
+void EffectScheduler::previous(void)
+{
+  if(this->count)
+    this->play((this->current + this->count - 1) % this->count);
+}
+
+/** End a transition: the incoming effect draws straight into the cube from now on. */
+void EffectScheduler::finishTransition(void)
+{
+  this->cube->copyFrom(this->buffers[1]);
+  this->outgoing = -1;
+}
+
+/** Move time on by one step: move on to the next effect when the one playing has played for its duration
+  and auto advance is on, carry a transition on, and update the effects playing. Call once per step of a
+  fixed step loop, and render() once per frame shown.
+
+  @param dt Microseconds the step covers.
+*/
+void EffectScheduler::update(uint32_t dt)
+{
+  if(!this->count)
+    return;
+  if(this->current < 0)
+    this->play(0);
+
+  this->played += dt;
+  uint32_t duration = this->playlist[this->current].duration;
+  if(this->autoAdvance && duration && this->outgoing < 0 && this->played / 1000 >= duration)
+    this->next();
+
+  if(this->outgoing >= 0) {
+    this->transitionElapsed += dt;
+    if(this->transitionElapsed >= this->transition)
+      this->finishTransition();
+  }
+  if(this->outgoing >= 0)
+    this->updateEffect(this->outgoing, dt);
+  this->updateEffect(this->current, dt);
+}
+
+/** Draw the effects playing into the cube, cross-fading them during a transition; call show() afterwards. */
+void EffectScheduler::render(void)
+{
+  if(!this->count)
+    return;
+  if(this->current < 0)
+    this->play(0);
+
+  if(this->outgoing >= 0) {
+    this->renderEffect(this->outgoing, &this->buffers[0]);
+    this->renderEffect(this->current, &this->buffers[1]);
+    this->cube->crossFade(this->buffers[0], this->buffers[1],
+        (uint64_t)this->transitionElapsed * 256 / this->transition);
+  } else {
+    this->renderEffect(this->current, NULL);
+  }
+}
+
+/** Update by the time since the last frame and render; call show() afterwards.
+  For loops that draw a frame per pass rather than stepping a fixed time.
+*/
+void EffectScheduler::frame(void)
+{
+  uint32_t now = micros();
+  uint32_t dt = this->started ? now - this->lastFrame : 0;
+  this->lastFrame = now;
+  this->started = true;
+  this->update(dt);
+  this->render();
+}
+
+/** Update one effect, timing it towards its next render.
+
+  @param index Position of the effect in the playlist.
+  @param dt Microseconds to move it on by.
+*/
+void EffectScheduler::updateEffect(int index, uint32_t dt)
+{
+  EffectEntry &e = this->playlist[index];
+  uint32_t start = micros();
+  e.effect->update(dt);
+  e.updateMicros += micros() - start;
+}
+
+/** Render one effect, timing it along with its updates since the last render, and stepping its quality
+  to keep it within the budget.
+
+  @param index Position of the effect in the playlist.
+  @param buffer The buffer to draw into, or NULL for the cube.
+*/
+void EffectScheduler::renderEffect(int index, VoxelBuffer *buffer)
+{
+  EffectEntry &e = this->playlist[index];
+  this->cube->setTarget(buffer);
+  if(!e.effect->keepsFrame())
+    this->cube->clear(false);
+  uint32_t start = micros();
+  e.effect->render(*this->cube);
+  uint32_t took = micros() - start + e.updateMicros;
+  e.updateMicros = 0;
+  this->cube->setTarget(NULL);
+
+  // running average over about 8 frames
+  e.averageMicros = e.averageMicros ? e.averageMicros + ((int32_t)(took - e.averageMicros) >> 3) : took;
+  if(took > e.worstMicros)
+    e.worstMicros = took;
+  if(!this->budget)
+    return;
+  if(took > this->budget)
+    e.overruns++;
+  if(e.averageMicros > this->budget) {
+    if(e.effect->lowerQuality())
+      e.averageMicros = 0;	// measure the new quality afresh
+    e.calmFrames = 0;
+  } else if(e.averageMicros < this->budget / 2) {
+    if(++e.calmFrames >= EFFECT_CALM_FRAMES) {
+      e.effect->raiseQuality();
+      e.calmFrames = 0;
+    }
+  } else {
+    e.calmFrames = 0;
+  }
+}
+
+/** Set how long cross-fades between effects take.
+
+  @param milliseconds Length of a transition, or 0 to cut straight to the next effect.
+*/
+void EffectScheduler::setTransition(uint32_t milliseconds)
+{
+  this->transition = milliseconds * 1000;
+}
+
+/** Choose whether effects move on by themselves once they have played for their duration.
+
+  @param enabled True to move on automatically, false to play the current effect until next() or play().
+*/
+void EffectScheduler::setAutoAdvance(bool enabled)
+{
+  this->autoAdvance = enabled;
+  this->played = 0;
+}
+
+/** Set the time an effect may take to update and render one frame.
+
+  @param micros Microseconds per frame, or 0 to never step the quality of effects.
+*/
+void EffectScheduler::setFrameBudget(uint32_t micros)
+{
+  this->budget = micros;
+}
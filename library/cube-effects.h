@@ -0,0 +1,95 @@
+#ifndef _L3D_EFFECTS_H
+#define _L3D_EFFECTS_H
+
+#include "beta-cube-library-fastled.h"
+
+/**   Largest number of effects in the playlist of an EffectScheduler. */
+#ifndef EFFECT_MAX_PLAYLIST
+#define EFFECT_MAX_PLAYLIST 16
+#endif
+
+/**   Frames an effect must stay within half its budget before its quality is raised again. */
+#ifndef EFFECT_CALM_FRAMES
+#define EFFECT_CALM_FRAMES 60
+#endif
+
+/**   An animation played by an EffectScheduler.
+      init is called every time the effect starts playing, update with the microseconds since its last
+      frame, and render to draw the frame. The cube may be drawing into a buffer of the scheduler's rather
+      than its own (see Cube::setTarget), so an effect draws only through the cube it is given, and the
+      frame is cleared before render unless keepsFrame() is true.
+      When rendering takes longer than the scheduler's frame budget, the scheduler calls lowerQuality,
+      and raiseQuality once it has been well within the budget for a while; effects that can draw with less
+      detail override them and return true when they changed something.
+*/
+class Effect {
+  public:
+    virtual ~Effect() {}
+
+    virtual void init(Cube &) {}
+    virtual void update(uint32_t) {}
+    virtual void render(Cube &cube) = 0;
+    virtual bool keepsFrame(void) { return false; }
+    virtual bool lowerQuality(void) { return false; }
+    virtual bool raiseQuality(void) { return false; }
+};
+
+/**   An effect in the playlist of an EffectScheduler, with how long it plays and how long it takes to render. */
+struct EffectEntry {
+  Effect *effect;
+  uint32_t duration;
+  uint32_t averageMicros;
+  uint32_t worstMicros;
+  uint32_t overruns;
+  uint32_t updateMicros;	// spent in update since the last render
+  uint16_t calmFrames;
+};
+
+/**   Plays a playlist of effects, one after the other, cross-fading from each to the next.
+      While one effect plays it draws straight into the cube. During a transition the outgoing and the
+      incoming effect each draw into a VoxelBuffer of their own, so effects that build on their previous
+      frame carry on undisturbed, and the two are mixed into the cube in one pass of fixed point blending.
+      The time every effect takes to update and render is tracked against the frame budget.
+*/
+class EffectScheduler {
+  private:
+    Cube *cube;
+    EffectEntry playlist[EFFECT_MAX_PLAYLIST];
+    int count;
+    int current;
+    int outgoing;
+    VoxelBuffer buffers[2];
+    uint32_t transition;
+    uint32_t transitionElapsed;
+    uint32_t played;
+    uint32_t lastFrame;
+    uint32_t budget;
+    bool autoAdvance;
+    bool started;
+
+    void updateEffect(int index, uint32_t dt);
+    void renderEffect(int index, VoxelBuffer *buffer);
+    void finishTransition(void);
+
+  public:
+    EffectScheduler(Cube &cube);
+
+    bool add(Effect &effect, uint32_t duration=0);
+    void play(int index);
+    void next(void);
+    void previous(void);
+    void update(uint32_t dt);
+    void render(void);
+    void frame(void);
+
+    void setTransition(uint32_t milliseconds);
+    void setAutoAdvance(bool enabled);
+    bool isAutoAdvancing(void) const { return this->autoAdvance; }
+    void setFrameBudget(uint32_t micros);
+    int currentIndex(void) const { return this->current; }
+    int effectCount(void) const { return this->count; }
+    bool inTransition(void) const { return this->outgoing >= 0; }
+    const EffectEntry &entry(int index) const { return this->playlist[index]; }
+};
+
+#endif
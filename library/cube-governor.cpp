@@ -0,0 +1,239 @@
+#include "cube-governor.h"
+
+/** Construct an empty histogram. */
+FrameHistogram::FrameHistogram()
+{
+  this->reset();
+}
+
+/** Forget all times recorded. */
+void FrameHistogram::reset(void)
+{
+  memset(this->buckets, 0, sizeof(this->buckets));
+  this->count = 0;
+  this->min = 0xffffffff;
+  this->max = 0;
+  this->total = 0;
+}
+
+/** Find the bucket a time falls into.
+
+  @param micros The time.
+
+  @return The index of its bucket.
+*/
+int FrameHistogram::bucketOf(uint32_t micros)
+{
+  if(micros < 16)
+    return micros;
+  int exponent = 31 - __builtin_clz(micros);
+  int bucket = 16 + (exponent - 4) * 8 + ((micros >> (exponent - 3)) & 7);
+  return bucket < FRAME_HISTOGRAM_BUCKETS ? bucket : FRAME_HISTOGRAM_BUCKETS - 1;
+}
+
+/** Find the shortest time that falls into a bucket.
+
+  @param bucket The index of the bucket.
+
+  @return The time.
+*/
+uint32_t FrameHistogram::bucketStart(int bucket)
+{
+  if(bucket < 16)
+    return bucket;
+  int exponent = 4 + (bucket - 16) / 8;
+  return (uint32_t)(8 + (bucket - 16) % 8) << (exponent - 3);
+}
+
+/** Record a time.
+
+  @param micros The time.
+*/
+void FrameHistogram::add(uint32_t micros)
+{
+  uint16_t &bucket = this->buckets[bucketOf(micros)];
+  if(bucket == 0xffff)
+    for(int i = 0; i < FRAME_HISTOGRAM_BUCKETS; i++)
+      this->buckets[i] >>= 1;
+  bucket++;
+  this->count++;
+  this->total += micros;
+  if(micros < this->min)
+    this->min = micros;
+  if(micros > this->max)
+    this->max = micros;
+}
+
+/** Estimate the time that a share of the recorded times do not exceed, from the middle of its bucket.
+
+  @param percent The share, 0 to 100.
+
+  @return The time, between the shortest and the longest recorded, or 0 if none were.
+*/
+uint32_t FrameHistogram::percentile(int percent) const
+{
+  if(!this->count)
+    return 0;
+  uint32_t inBuckets = 0;
+  for(int i = 0; i < FRAME_HISTOGRAM_BUCKETS; i++)
+    inBuckets += this->buckets[i];
+  uint32_t rank = (inBuckets * percent + 99) / 100;
+  if(!rank)
+    rank = 1;
+  uint32_t seen = 0;
+  int i = 0;
+  for( ; i < FRAME_HISTOGRAM_BUCKETS - 1; i++) {
+    seen += this->buckets[i];
+    if(seen >= rank)
+      break;
+  }
+  uint32_t start = bucketStart(i);
+  uint32_t time = (i + 1 < FRAME_HISTOGRAM_BUCKETS) ? (start + bucketStart(i + 1) - 1) / 2 : start;
+  if(time < this->min)
+    time = this->min;
+  if(time > this->max)
+    time = this->max;
+  return time;
+}
+
+/** Summarize the recorded times.
+
+  @return Their number, minimum, average, 95th percentile and maximum, all 0 if none were recorded.
+*/
+FrameStats FrameHistogram::stats(void) const
+{
+  FrameStats s;
+  s.count = this->count;
+  s.min = this->count ? this->min : 0;
+  s.average = this->count ? (uint32_t)(this->total / this->count) : 0;
+  s.p95 = this->percentile(95);
+  s.max = this->max;
+  return s;
+}
+
+/** Construct a governor for a cube.
+
+  @param cube The cube endFrame shows.
+  @param stepsPerSecond Simulation steps per second.
+  @param framesPerSecond Frames shown per second at most, or 0 to show them as fast as they are drawn.
+*/
+FrameGovernor::FrameGovernor(Cube &cube, uint16_t stepsPerSecond, uint16_t framesPerSecond) :
+    cube(&cube),
+    accumulator(0),
+    frameStart(0),
+    deadline(0),
+    maxSteps(4),
+    steps(0),
+    droppedSteps(0),
+    started(false)
+{
+  this->setStepRate(stepsPerSecond);
+  this->setFrameRate(framesPerSecond);
+}
+
+/** Start a frame: work out how many simulation steps are due since the last one.
+  At most maxSteps are run in one frame; if the simulation falls further behind than that, the steps
+  in excess are dropped and it runs slow rather than ever more behind.
+*/
+void FrameGovernor::beginFrame(void)
+{
+  uint32_t now = micros();
+  if(this->started) {
+    this->interval.add(now - this->frameStart);
+    this->accumulator += now - this->frameStart;
+  } else {
+    this->deadline = now;
+    this->started = true;
+  }
+  this->frameStart = now;
+  this->steps = 0;
+
+  int32_t most = (int32_t)this->stepLength * this->maxSteps;
+  if(this->accumulator > most) {
+    this->droppedSteps += (this->accumulator - most) / this->stepLength;
+    this->accumulator = most;
+  }
+}
+
+/** Take the next simulation step, if one is due. Call until it returns false.
+  Steps within an eighth of a step of being due are taken, so that jitter in the frame times does not
+  alternate between frames without a step and frames with two.
+
+  @return True if the simulation should advance by stepMicros().
+*/
+bool FrameGovernor::step(void)
+{
+  if(this->accumulator < (int32_t)(this->stepLength - this->stepLength / 8))
+    return false;
+  this->accumulator -= this->stepLength;
+  this->steps++;
+  return true;
+}
+
+/** How far the time of the frame is past the last simulation step, for drawing in between it and the
+  one before.
+
+  @return 0 at the last step, up to 255 just before the next one.
+*/
+uint8_t FrameGovernor::alpha(void) const
+{
+  if(this->accumulator <= 0)
+    return 0;
+  uint32_t a = ((uint32_t)this->accumulator << 8) / this->stepLength;
+  return a > 255 ? 255 : a;
+}
+
+/** Finish a frame: show the cube, then sleep until the next frame is due.
+  Whole milliseconds are slept with delay(), which keeps the system running; only the rest is waited
+  out. A frame that ends late starts the next one right away, without trying to catch up.
+*/
+void FrameGovernor::endFrame(void)
+{
+  uint32_t drawn = micros();
+  this->render.add(drawn - this->frameStart);
+  this->cube->show();
+  uint32_t shown = micros();
+  this->output.add(shown - drawn);
+
+  this->deadline += this->period;
+  int32_t rest = (int32_t)(this->deadline - shown);
+  if(rest <= 0) {
+    this->deadline = shown;
+    this->idle.add(0);
+    return;
+  }
+  if(rest >= 1000)
+    delay(rest / 1000);
+  int32_t left = (int32_t)(this->deadline - micros());
+  if(left > 0)
+    delayMicroseconds(left);
+  this->idle.add(micros() - shown);
+}
+
+/** Set how often the simulation advances.
+
+  @param stepsPerSecond Simulation steps per second, at least 1.
+*/
+void FrameGovernor::setStepRate(uint16_t stepsPerSecond)
+{
+  this->stepLength = 1000000 / (stepsPerSecond ? stepsPerSecond : 1);
+}
+
+/** Set how often frames are shown.
+
+  @param framesPerSecond Frames per second at most, or 0 to show them as fast as they are drawn.
+*/
+void FrameGovernor::setFrameRate(uint16_t framesPerSecond)
+{
+  this->period = framesPerSecond ? 1000000 / framesPerSecond : 0;
+}
+
+/** Forget the times recorded so far. */
+void FrameGovernor::resetStats(void)
+{
+  this->render.reset();
+  this->output.reset();
+  this->idle.reset();
+  this->interval.reset();
+  this->droppedSteps = 0;
+}
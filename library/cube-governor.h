@@ -0,0 +1,91 @@
+#ifndef _L3D_GOVERNOR_H
+#define _L3D_GOVERNOR_H
+
+#include "beta-cube-library-fastled.h"
+
+/**   Buckets of a FrameHistogram. Times under 16 us get a bucket each; above that every doubling of the
+      time is split into 8 buckets, so a bucket is at most 1/8 of its time wide. 128 buckets reach 262 ms;
+      longer times go into the last one.
+*/
+#ifndef FRAME_HISTOGRAM_BUCKETS
+#define FRAME_HISTOGRAM_BUCKETS 128
+#endif
+
+/**   Summary of a FrameHistogram, in microseconds. */
+struct FrameStats {
+  uint32_t count;
+  uint32_t min;
+  uint32_t average;
+  uint32_t p95;
+  uint32_t max;
+};
+
+/**   A histogram of times in microseconds, with their exact minimum, maximum and average.
+      Bucket counts are halved when one of them fills up, so the percentiles favor recent frames.
+*/
+class FrameHistogram {
+  private:
+    uint16_t buckets[FRAME_HISTOGRAM_BUCKETS];
+    uint32_t count;
+    uint32_t min, max;
+    uint64_t total;
+
+  public:
+    FrameHistogram();
+
+    void add(uint32_t micros);
+    void reset(void);
+    uint32_t percentile(int percent) const;
+    FrameStats stats(void) const;
+
+    static int bucketOf(uint32_t micros);
+    static uint32_t bucketStart(int bucket);
+};
+
+/**   Paces the main loop: simulation advances in fixed steps, independent of how long frames take to
+      draw, and frames are shown at a steady rate with the time left over slept away rather than spun.
+      A frame looks like:
+        governor.beginFrame();
+        while(governor.step())
+          simulate();                   // one fixed step of stepMicros()
+        draw(governor.alpha());         // blend the last two steps by alpha/256
+        governor.endFrame();            // show, then sleep until the next frame is due
+      The time spent simulating and drawing, in show(), and asleep is recorded frame by frame.
+*/
+class FrameGovernor {
+  private:
+    Cube *cube;
+    uint32_t stepLength;
+    uint32_t period;
+    int32_t accumulator;
+    uint32_t frameStart;
+    uint32_t deadline;
+    uint16_t maxSteps;
+    uint16_t steps;
+    uint32_t droppedSteps;
+    bool started;
+    FrameHistogram render, output, idle, interval;
+
+  public:
+    FrameGovernor(Cube &cube, uint16_t stepsPerSecond=60, uint16_t framesPerSecond=60);
+
+    void beginFrame(void);
+    bool step(void);
+    uint8_t alpha(void) const;
+    void endFrame(void);
+
+    void setStepRate(uint16_t stepsPerSecond);
+    void setFrameRate(uint16_t framesPerSecond);
+    void setMaxSteps(uint16_t steps) { this->maxSteps = steps; }
+    uint32_t stepMicros(void) const { return this->stepLength; }
+    uint16_t stepsThisFrame(void) const { return this->steps; }
+    uint32_t getDroppedSteps(void) const { return this->droppedSteps; }
+
+    const FrameHistogram &renderTimes(void) const { return this->render; }
+    const FrameHistogram &outputTimes(void) const { return this->output; }
+    const FrameHistogram &idleTimes(void) const { return this->idle; }
+    const FrameHistogram &frameTimes(void) const { return this->interval; }
+    void resetStats(void);
+};
+
+#endif
@@ -0,0 +1,256 @@
+#include "cube-layers.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/** Construct a black layer.
+
+  @param mode How the layer is combined with the ones below: LAYER_REPLACE, LAYER_ADD, LAYER_MAX,
+  LAYER_MULTIPLY, LAYER_SCREEN or LAYER_ALPHA.
+  @param opacity How much of the layer shows, 0 to 255.
+*/
+VoxelLayer::VoxelLayer(uint8_t mode, fract8 opacity) :
+    mode(mode),
+    opacity(opacity)
+{ }
+
+/** Change how the layer is combined with the ones below.
+
+  @param mode LAYER_REPLACE, LAYER_ADD, LAYER_MAX, LAYER_MULTIPLY, LAYER_SCREEN or LAYER_ALPHA.
+*/
+void VoxelLayer::setMode(uint8_t mode)
+{
+  if(mode != this->mode)
+    this->changed = true;
+  this->mode = mode;
+}
+
+/** Change how much of the layer shows.
+
+  @param opacity 0 to hide the layer, up to 255 for all of it.
+*/
+void VoxelLayer::setOpacity(fract8 opacity)
+{
+  if(opacity != this->opacity)
+    this->changed = true;
+  this->opacity = opacity;
+}
+
+/** Construct an empty stack. */
+LayerStack::LayerStack() :
+    count(0),
+    cacheTop(0)
+{ }
+
+/** Put a layer on top of the stack.
+
+  @param layer The layer. Used in place, so it must outlive the stack.
+
+  @return False if the stack is full.
+*/
+bool LayerStack::add(VoxelLayer &layer)
+{
+  if(this->count == LAYER_STACK_SIZE)
+    return false;
+  this->layers[this->count++] = &layer;
+  layer.changed = true;
+  return true;
+}
+
+/** Take a layer out of the stack.
+
+  @param layer The layer.
+
+  @return False if it was not in the stack.
+*/
+bool LayerStack::remove(VoxelLayer &layer)
+{
+  for(int i = 0; i < this->count; i++)
+    if(this->layers[i] == &layer) {
+      for(int j = i; j < this->count - 1; j++)
+        this->layers[j] = this->layers[j + 1];
+      this->count--;
+      if(i < this->count)
+        this->layers[i]->changed = true;	// everything above the gap has to be combined again
+      else if(this->cacheTop > i) {
+        // the cache holds the layer that was on top: start it again from nothing
+        this->cache.clear();
+        this->cacheTop = 0;
+      }
+      return true;
+    }
+  return false;
+}
+
+/** Combine one channel of a voxel with the one below, with lib8tion's scale8 and qadd8.
+  The same arithmetic as blendHalf, for the bytes it leaves over. LAYER_ALPHA is not handled.
+*/
+static inline uint8_t blendByte(uint8_t d, uint8_t s, uint8_t mode, fract8 opacity)
+{
+  bool full = opacity == 255;
+  if(mode == LAYER_MULTIPLY)
+    s = ((uint16_t)d * (s + 1)) >> 8;
+  else if(mode != LAYER_REPLACE && !full)
+    s = scale8(s, opacity);
+  switch(mode) {
+    case LAYER_ADD:
+      return qadd8(d, s);
+    case LAYER_MAX:
+      return d > s ? d : s;
+    case LAYER_SCREEN:
+      return qadd8(d, scale8(s, 255 - d));
+    default:
+      // as FastLED's nblend
+      return full ? s : scale8(d, 256 - opacity) + scale8(s, opacity);
+  }
+}
+
+#if defined(__SSE2__)
+static inline __m128i scale16(__m128i x, __m128i scale)
+{
+  return _mm_srli_epi16(_mm_mullo_epi16(x, scale), 8);
+}
+
+/** blendByte for eight channels widened to 16 bits; packing them back saturates the sums as qadd8 does. */
+static inline __m128i blendHalf(__m128i d, __m128i s, uint8_t mode, __m128i opacity, __m128i keep, bool full)
+{
+  if(mode == LAYER_MULTIPLY)
+    s = scale16(d, _mm_add_epi16(s, _mm_set1_epi16(1)));
+  else if(mode != LAYER_REPLACE && !full)
+    s = scale16(s, opacity);
+  switch(mode) {
+    case LAYER_ADD:
+      return _mm_add_epi16(d, s);
+    case LAYER_MAX:
+      return _mm_max_epi16(d, s);
+    case LAYER_SCREEN:
+      return _mm_add_epi16(d, scale16(s, _mm_sub_epi16(_mm_set1_epi16(255), d)));
+    default:
+      return full ? s : _mm_add_epi16(scale16(d, keep), scale16(s, opacity));
+  }
+}
+#endif
+
+/** Combine a run of voxels of a layer with the ones below.
+
+  @param dst The voxels below, replaced by the result.
+  @param src The voxels of the layer.
+  @param count Number of voxels.
+  @param mode How to combine them.
+  @param opacity How much of the layer shows, 1 to 255.
+*/
+static void blendVoxels(CRGB *dst, const CRGB *src, uint16_t count, uint8_t mode, fract8 opacity)
+{
+  if(mode == LAYER_ALPHA) {
+    for(uint16_t i = 0; i < count; i++)
+      if(src[i])
+        nblend(dst[i], src[i], opacity);
+    return;
+  }
+
+  uint8_t *d = (uint8_t *)dst;
+  const uint8_t *s = (const uint8_t *)src;
+  uint16_t n = count * 3;
+  uint16_t k = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i opacity16 = _mm_set1_epi16(opacity);
+  const __m128i keep16 = _mm_set1_epi16(256 - opacity);
+  bool full = opacity == 255;
+  for( ; k + 16 <= n; k += 16) {
+    __m128i below = _mm_loadu_si128((const __m128i *)(d + k));
+    __m128i layer = _mm_loadu_si128((const __m128i *)(s + k));
+    __m128i lo = blendHalf(_mm_unpacklo_epi8(below, zero), _mm_unpacklo_epi8(layer, zero), mode, opacity16, keep16, full);
+    __m128i hi = blendHalf(_mm_unpackhi_epi8(below, zero), _mm_unpackhi_epi8(layer, zero), mode, opacity16, keep16, full);
+    _mm_storeu_si128((__m128i *)(d + k), _mm_packus_epi16(lo, hi));
+  }
+#endif
+  for( ; k < n; k++)
+    d[k] = blendByte(d[k], s[k], mode, opacity);
+}
+
+/** Combine layers with what is below them, a slab at a time: each slab of the voxels below is loaded
+  once, every layer applied to it, and the result stored once.
+
+  @param below The voxels below the layers.
+  @param belowDirty The part of them that can be lit.
+  @param from The first layer to apply.
+  @param to One past the last layer to apply.
+  @param out Where to store the result. May be below.
+  @param outDirty Set to the part of the result that can be lit.
+*/
+void LayerStack::combine(const CRGB *below, const DirtyRegion &belowDirty, int from, int to, CRGB *out, DirtyRegion &outDirty)
+{
+  const int slabVoxels = CUBE_SIZE * CUBE_SIZE;
+  CRGB work[slabVoxels];
+
+  DirtyRegion region = belowDirty;
+  for(int i = from; i < to; i++) {
+    const DirtyRegion &r = this->layers[i]->dirty;
+    if(this->layers[i]->getOpacity() && !r.isEmpty()) {
+      region.include(r.x0, r.y0, r.z0);
+      region.include(r.x1, r.y1, r.z1);
+    }
+  }
+
+  for(int z = 0; z < CUBE_SIZE; z++) {
+    bool lit = !belowDirty.isEmpty() && z >= belowDirty.z0 && z <= belowDirty.z1;
+    if(lit)
+      memcpy8(work, below + z * slabVoxels, sizeof(work));
+    else
+      memset8(work, 0, sizeof(work));
+    for(int i = from; i < to; i++) {
+      VoxelLayer *layer = this->layers[i];
+      uint8_t mode = layer->getMode();
+      fract8 opacity = layer->getOpacity();
+      if(!opacity)
+        continue;
+      const DirtyRegion &r = layer->dirty;
+      if(r.isEmpty() || z < r.z0 || z > r.z1) {
+        // the layer is black here: only replace and multiply change anything, and only what is lit
+        if(!lit || (mode != LAYER_REPLACE && mode != LAYER_MULTIPLY))
+          continue;
+      } else {
+        lit = true;
+      }
+      blendVoxels(work, layer->leds + z * slabVoxels, slabVoxels, mode, opacity);
+    }
+    memcpy8(out + z * slabVoxels, work, sizeof(work));
+  }
+  outDirty = region;
+}
+
+/** Replace what has been drawn with the layers of a stack, combined from the bottom up.
+  The layers below the lowest one that changed since the last composite come from the stack's cache;
+  if none changed, this is a copy of it.
+
+  @param stack The layers.
+*/
+void Cube::composite(LayerStack &stack)
+{
+  int first = stack.count;
+  for(int i = 0; i < stack.count; i++)
+    if(stack.layers[i]->changed) {
+      first = i;
+      break;
+    }
+
+  if(first < stack.cacheTop) {
+    stack.cache.clear();
+    stack.cacheTop = 0;
+  }
+  if(first > stack.cacheTop) {
+    stack.combine(stack.cache.leds, stack.cache.dirty, stack.cacheTop, first, stack.cache.leds, stack.cache.dirty);
+    stack.cacheTop = first;
+  }
+
+  if(first == stack.count) {
+    memcpy8(this->leds, stack.cache.leds, sizeof(stack.cache.leds));
+    *this->dirty = stack.cache.dirty;
+  } else {
+    stack.combine(stack.cache.leds, stack.cache.dirty, first, stack.count, this->leds, *this->dirty);
+  }
+
+  for(int i = 0; i < stack.count; i++)
+    stack.layers[i]->changed = false;
+}
@@ -0,0 +1,65 @@
+#ifndef _L3D_LAYERS_H
+#define _L3D_LAYERS_H
+
+#include "beta-cube-library-fastled.h"
+
+/**   Largest number of layers in a LayerStack. */
+#ifndef LAYER_STACK_SIZE
+#define LAYER_STACK_SIZE 8
+#endif
+
+/** How a VoxelLayer is combined with the layers below it. */
+#define LAYER_REPLACE 0		// blend the whole layer over what is below, black included
+#define LAYER_ADD 1		// add, saturating at full brightness
+#define LAYER_MAX 2		// keep the brighter of the two, channel by channel
+#define LAYER_MULTIPLY 3	// darken what is below by the layer's color; white leaves it as it is
+#define LAYER_SCREEN 4		// brighten what is below by the layer's color, never past full brightness
+#define LAYER_ALPHA 5		// blend the layer's lit voxels over what is below; black voxels are transparent
+
+/**   A volume of voxels to be combined with others by a LayerStack, with a blend mode and an opacity.
+      Draw into it through a Cube with Cube::setTarget. Changing the mode or opacity marks it as changed.
+*/
+class VoxelLayer : public VoxelBuffer {
+  private:
+    uint8_t mode;
+    fract8 opacity;
+
+  public:
+    VoxelLayer(uint8_t mode=LAYER_ALPHA, fract8 opacity=255);
+
+    void setMode(uint8_t mode);
+    void setOpacity(fract8 opacity);
+    uint8_t getMode(void) const { return this->mode; }
+    fract8 getOpacity(void) const { return this->opacity; }
+};
+
+/**   Layers of voxels combined bottom to top into a Cube by Cube::composite.
+      Every slab of the cube is combined in one pass: what is below is loaded once, each layer applied to
+      it in turn, and the result stored once, with SSE2 on hosts that have it. Layers that add light only
+      visit the slabs they have drawn into.
+      The layers below the lowest one that changed since the last composite are kept combined in a cache,
+      so static layers at the bottom of the stack cost nothing per frame, and a composite in which no layer
+      changed is a copy of the cache.
+*/
+class LayerStack {
+  private:
+    VoxelLayer *layers[LAYER_STACK_SIZE];
+    int count;
+    VoxelBuffer cache;
+    int cacheTop;
+
+    void combine(const CRGB *below, const DirtyRegion &belowDirty, int from, int to, CRGB *out, DirtyRegion &outDirty);
+
+  public:
+    LayerStack();
+
+    bool add(VoxelLayer &layer);
+    bool remove(VoxelLayer &layer);
+    int layerCount(void) const { return this->count; }
+    VoxelLayer &layer(int index) { return *this->layers[index]; }
+    int cachedLayers(void) const { return this->cacheTop; }
+
+    friend class Cube;
+};
+
+#endif
@@ -0,0 +1,288 @@
+#include "cube-motion.h"
+#include "cube-raster.h"
+
+/** Milliseconds between samples. */
+#define MOTION_PERIOD (1000 / MOTION_SAMPLE_HZ)
+
+/** Number of samples in a number of milliseconds. */
+#define MOTION_TICKS(ms) ((ms) * MOTION_SAMPLE_HZ / 1000)
+
+/** Input of a gesture state machine sent when it has been in a state for longer than the state's timeout. */
+#define GESTURE_TIMEOUT 0xff
+
+/** States of the machine that follows the face the cube lies on. */
+#define POSE_STATE_IDLE 0
+#define POSE_STATE_FACEPLANT 1
+#define POSE_STATE_LEFT 2
+#define POSE_STATE_RIGHT 3
+#define POSE_STATE_LOST 4
+
+/** Leave a face and come back upright within 3 seconds to make a gesture. The machine starts lost, so
+    a cube switched on lying on its side makes no gesture until it has been stood upright. */
+static const GestureRule poseRules[] = {
+  { POSE_STATE_IDLE, POSE_FACEPLANT, POSE_STATE_FACEPLANT, MOTION_NONE },
+  { POSE_STATE_IDLE, POSE_LEFT, POSE_STATE_LEFT, MOTION_NONE },
+  { POSE_STATE_IDLE, POSE_RIGHT, POSE_STATE_RIGHT, MOTION_NONE },
+  { POSE_STATE_FACEPLANT, POSE_UPRIGHT, POSE_STATE_IDLE, MOTION_FLIP },
+  { POSE_STATE_LEFT, POSE_UPRIGHT, POSE_STATE_IDLE, MOTION_TILT_LEFT },
+  { POSE_STATE_RIGHT, POSE_UPRIGHT, POSE_STATE_IDLE, MOTION_TILT_RIGHT },
+  { POSE_STATE_FACEPLANT, GESTURE_TIMEOUT, POSE_STATE_LOST, MOTION_NONE },
+  { POSE_STATE_LEFT, GESTURE_TIMEOUT, POSE_STATE_LOST, MOTION_NONE },
+  { POSE_STATE_RIGHT, GESTURE_TIMEOUT, POSE_STATE_LOST, MOTION_NONE },
+  { POSE_STATE_LOST, POSE_UPRIGHT, POSE_STATE_IDLE, MOTION_NONE },
+};
+static const uint16_t poseTimeouts[] = { 0, MOTION_TICKS(3000), MOTION_TICKS(3000), MOTION_TICKS(3000), 0 };
+
+/** Samples a pose must last before it counts, so that passing through one on the way to another does not. */
+#define POSE_SETTLE_TICKS MOTION_TICKS(100)
+
+/** States of the machine that follows sudden movement, and its inputs. */
+#define MOTION_STATE_STILL 0
+#define MOTION_STATE_BUMP 1
+#define MOTION_STATE_SETTLE 2
+#define MOTION_STATE_SHAKE 3
+#define MOTION_QUIET 0
+#define MOTION_MOVING 1
+
+/** A bump over within 60 ms is a tap; one that goes on is shaking, which ends after 300 ms without movement.
+    After a tap the cube must be still for 150 ms, so that it ringing on does not make more. */
+static const GestureRule motionRules[] = {
+  { MOTION_STATE_STILL, MOTION_MOVING, MOTION_STATE_BUMP, MOTION_NONE },
+  { MOTION_STATE_BUMP, MOTION_QUIET, MOTION_STATE_SETTLE, MOTION_TAP },
+  { MOTION_STATE_BUMP, GESTURE_TIMEOUT, MOTION_STATE_SHAKE, MOTION_SHAKE },
+  { MOTION_STATE_SETTLE, MOTION_MOVING, MOTION_STATE_SETTLE, MOTION_NONE },
+  { MOTION_STATE_SETTLE, GESTURE_TIMEOUT, MOTION_STATE_STILL, MOTION_NONE },
+  { MOTION_STATE_SHAKE, MOTION_MOVING, MOTION_STATE_SHAKE, MOTION_NONE },
+  { MOTION_STATE_SHAKE, GESTURE_TIMEOUT, MOTION_STATE_STILL, MOTION_NONE },
+};
+static const uint16_t motionTimeouts[] = { 0, MOTION_TICKS(60), MOTION_TICKS(150), MOTION_TICKS(300) };
+
+/** Advance a gesture state machine by one sample.
+  The first rule for the state and the input is taken; taking a rule, even one back to the same state,
+  restarts the state's timeout.
+
+  @param rules, count The rules of the machine.
+  @param timeouts Samples after which each state gets GESTURE_TIMEOUT, or 0 for never.
+  @param state, ticks The state of the machine and the samples it has been in it.
+  @param input What the sample was classified as.
+
+  @return The gesture made, or MOTION_NONE.
+*/
+static uint8_t stepGesture(const GestureRule *rules, int count, const uint16_t *timeouts, uint8_t &state, uint16_t &ticks,
+    uint8_t input)
+{
+  if(ticks < 0xffff)
+    ticks++;
+  if(timeouts[state] && ticks >= timeouts[state])
+    input = GESTURE_TIMEOUT;
+  for(int i = 0; i < count; i++)
+    if(rules[i].state == state && rules[i].input == input) {
+      state = rules[i].next;
+      ticks = 0;
+      return rules[i].event;
+    }
+  return MOTION_NONE;
+}
+
+/** The angle of a vector, in 65536ths of a turn like sin16, within about a quarter of a degree.
+  Uses atan(t) ~ t*pi/4 + 0.273*t*(1-t) over the first eighth of a turn, mirrored into the others.
+
+  @param y, x The vector, each from -65535 to 65535.
+
+  @return The angle from the x axis toward the y axis, -32768 to 32767 (-180 to just under 180 degrees).
+*/
+int16_t atan2_16(int32_t y, int32_t x)
+{
+  uint32_t ax = x < 0 ? -x : x;
+  uint32_t ay = y < 0 ? -y : y;
+  if(ax == 0 && ay == 0)
+    return 0;
+  // the smaller over the larger, 0 to 1 in Q15
+  uint32_t t = ax > ay ? (ay << 15) / ax : (ax << 15) / ay;
+  uint32_t a = (8192 * t + 2847 * ((t * (32768 - t)) >> 15)) >> 15;
+  if(ay > ax)
+    a = 16384 - a;
+  if(x < 0)
+    a = 32768 - a;
+  return (int16_t)(y < 0 ? -(int32_t)a : (int32_t)a);
+}
+
+/** Construct a stopped sampler, for a cube standing upright. */
+MotionSampler::MotionSampler() :
+    head(0),
+    tail(0),
+    dropped(0),
+    nextSampleTime(0),
+    running(false),
+    primed(false),
+    theta(0),
+    phi(0),
+    activity(0),
+    pose(POSE_OTHER),
+    candidatePose(POSE_OTHER),
+    poseTicks(0),
+    poseState(POSE_STATE_LOST),
+    motionState(MOTION_STATE_STILL),
+    poseStateTicks(0),
+    motionStateTicks(0),
+    eventHead(0),
+    eventTail(0)
+{
+  this->filtered[0] = this->filtered[1] = this->filtered[2] = 0;
+}
+
+/** Start taking samples. */
+void MotionSampler::begin(void)
+{
+  this->nextSampleTime = millis();
+  this->running = true;
+}
+
+/** Stop taking samples. Samples already taken are still processed by update(). */
+void MotionSampler::end(void)
+{
+  this->running = false;
+}
+
+/** Read the accelerometer into the ring buffer. Called by update() for every sample that is due; call it
+  from the same thread as update() and anything else that reads the ADC. The sample is dropped if the ring
+  buffer is full.
+*/
+void MotionSampler::sample(void)
+{
+  uint32_t h = this->head;
+  if(h - this->tail >= MOTION_RING_SIZE) {
+    this->dropped++;
+    return;
+  }
+  MotionSample &s = this->ring[h & (MOTION_RING_SIZE - 1)];
+  s.x = analogRead(X) - 2048;
+  s.y = analogRead(Y) - 2048;
+  s.z = analogRead(Z) - 2048;
+  s.time = millis();
+  this->head = h + 1;
+}
+
+/** Take the samples that are due, then process the samples taken since the last call: filter them, work
+  out the tilt and look for gestures. The ADC is read here on the calling thread rather than from a timer,
+  so it is never read from two threads at once and does not interrupt other code reading it, such as
+  AudioAnalyzer::sample. Samples that fell due since the last call are all taken now, at their due times.
+  Cheap enough to call every frame; Cube::show() calls it for the sampler given to Cube::setMotion.
+
+  @return The number of samples processed.
+*/
+int MotionSampler::update(void)
+{
+  if(this->running) {
+    uint32_t now = millis();
+    if((int32_t)(now - this->nextSampleTime) > MOTION_PERIOD * MOTION_RING_SIZE)
+      this->nextSampleTime = now - MOTION_PERIOD * (MOTION_RING_SIZE - 1);
+    while((int32_t)(now - this->nextSampleTime) >= 0) {
+      this->sample();
+      this->ring[(this->head - 1) & (MOTION_RING_SIZE - 1)].time = this->nextSampleTime;
+      this->nextSampleTime += MOTION_PERIOD;
+    }
+  }
+  int count = 0;
+  while(this->tail != this->head) {
+    this->process(this->ring[this->tail & (MOTION_RING_SIZE - 1)]);
+    this->tail++;
+    count++;
+  }
+  if(count) {
+    int x = this->getX(), y = this->getY(), z = this->getZ();
+    this->theta = atan2_16(x, isqrt32(y*y + z*z));
+    this->phi = atan2_16(y, isqrt32(x*x + z*z));
+  }
+  return count;
+}
+
+/** Filter one sample and run it through the gesture state machines. */
+void MotionSampler::process(const MotionSample &s)
+{
+  int raw[3] = { s.x, s.y, s.z };
+  if(!this->primed) {
+    // start the filter at the first reading rather than at zero, which would look like a jolt
+    for(int i = 0; i < 3; i++)
+      this->filtered[i] = raw[i] * 256;
+    this->primed = true;
+  }
+  // low pass, in 24.8 fixed point
+  for(int i = 0; i < 3; i++)
+    this->filtered[i] += (raw[i] * 256 - this->filtered[i]) >> MOTION_FILTER_SHIFT;
+
+  // sudden movement changes the strength of the reading, where turning the cube only changes its direction
+  int x = this->getX(), y = this->getY(), z = this->getZ();
+  int32_t strength = isqrt32(raw[0]*raw[0] + raw[1]*raw[1] + raw[2]*raw[2]);
+  int32_t moving = strength - (int32_t)isqrt32(x*x + y*y + z*z);
+  if(moving < 0)
+    moving = -moving;
+  this->activity = moving;
+
+  // the face the cube lies on, once it has lasted
+  uint8_t now = POSE_OTHER;
+  if(z > MOTION_POSE_LEVEL)
+    now = POSE_UPRIGHT;
+  else if(x > MOTION_POSE_LEVEL)
+    now = POSE_FACEPLANT;
+  else if(y < -MOTION_POSE_LEVEL)
+    now = POSE_LEFT;
+  else if(y > MOTION_POSE_LEVEL)
+    now = POSE_RIGHT;
+  if(now != this->candidatePose) {
+    this->candidatePose = now;
+    this->poseTicks = 0;
+  } else if(this->poseTicks < POSE_SETTLE_TICKS) {
+    if(++this->poseTicks == POSE_SETTLE_TICKS)
+      this->pose = now;
+  }
+
+  this->queue(stepGesture(poseRules, sizeof(poseRules) / sizeof(poseRules[0]), poseTimeouts,
+      this->poseState, this->poseStateTicks, this->pose));
+  this->queue(stepGesture(motionRules, sizeof(motionRules) / sizeof(motionRules[0]), motionTimeouts,
+      this->motionState, this->motionStateTicks, moving > MOTION_BUMP_LEVEL ? MOTION_MOVING : MOTION_QUIET));
+}
+
+/** Add a gesture to the queue, unless it is MOTION_NONE or the queue is full. */
+void MotionSampler::queue(uint8_t event)
+{
+  uint8_t next = (this->eventHead + 1) % sizeof(this->events);
+  if(event == MOTION_NONE || next == this->eventTail)
+    return;
+  this->events[this->eventHead] = event;
+  this->eventHead = next;
+}
+
+/** Take the oldest gesture from the queue.
+
+  @return MOTION_FLIP, MOTION_TILT_LEFT, MOTION_TILT_RIGHT, MOTION_SHAKE or MOTION_TAP, or MOTION_NONE
+  if no gesture was made since the last call.
+*/
+int MotionSampler::nextEvent(void)
+{
+  if(this->eventTail == this->eventHead)
+    return MOTION_NONE;
+  uint8_t event = this->events[this->eventTail];
+  this->eventTail = (this->eventTail + 1) % sizeof(this->events);
+  return event;
+}
+
+/** Copy the most recent processed samples, e.g. to draw a graph of them.
+
+  @param out Where to copy the samples, oldest first.
+  @param count Largest number of samples to copy.
+
+  @return The number of samples copied, at most MOTION_RING_SIZE.
+*/
+int MotionSampler::history(MotionSample *out, int count)
+{
+  uint32_t end = this->tail;
+  // samples taken but not processed yet have refilled the oldest slots
+  uint32_t kept = MOTION_RING_SIZE - (this->head - end);
+  int available = end < kept ? end : kept;
+  if(count > available)
+    count = available;
+  for(int i = 0; i < count; i++)
+    out[i] = this->ring[(end - count + i) & (MOTION_RING_SIZE - 1)];
+  return count;
+}
@@ -0,0 +1,114 @@
+#ifndef _L3D_MOTION_H
+#define _L3D_MOTION_H
+
+#include "beta-cube-library-fastled.h"
+
+/**   Accelerometer samples taken per second. */
+#ifndef MOTION_SAMPLE_HZ
+#define MOTION_SAMPLE_HZ 100
+#endif
+
+/**   Number of samples the ring buffer holds, a power of two. Samples not processed by the time it
+      is full are dropped. */
+#ifndef MOTION_RING_SIZE
+#define MOTION_RING_SIZE 32
+#endif
+
+/**   Each sample moves the filtered readings 1/2^MOTION_FILTER_SHIFT of the way toward it. */
+#ifndef MOTION_FILTER_SHIFT
+#define MOTION_FILTER_SHIFT 3
+#endif
+
+/**   Accelerometer counts along an axis for the cube to count as lying on that face. */
+#ifndef MOTION_POSE_LEVEL
+#define MOTION_POSE_LEVEL 300
+#endif
+
+/**   Accelerometer counts by which a reading must be stronger or weaker than the filtered ones to count
+      as sudden movement, for taps and shaking. */
+#ifndef MOTION_BUMP_LEVEL
+#define MOTION_BUMP_LEVEL 400
+#endif
+
+/** Gestures reported by MotionSampler::nextEvent. */
+#define MOTION_NONE 0
+#define MOTION_FLIP 1
+#define MOTION_TILT_LEFT 2
+#define MOTION_TILT_RIGHT 3
+#define MOTION_SHAKE 4
+#define MOTION_TAP 5
+
+/** Faces the cube can lie on, as seen by MotionSampler::getPose. */
+#define POSE_OTHER 0
+#define POSE_UPRIGHT 1
+#define POSE_FACEPLANT 2
+#define POSE_LEFT 3
+#define POSE_RIGHT 4
+
+/**   One reading of the accelerometer, bias removed, and the time it was taken in milliseconds. */
+struct MotionSample {
+  int16_t x, y, z;
+  uint32_t time;
+};
+
+/**   A step of a gesture state machine: in state, on input, go to next and report event. */
+struct GestureRule {
+  uint8_t state;
+  uint8_t input;
+  uint8_t next;
+  uint8_t event;
+};
+
+int16_t atan2_16(int32_t y, int32_t x);
+
+/**   Samples the accelerometer at MOTION_SAMPLE_HZ into a ring buffer. update() takes the samples whose
+      time has passed, on the thread that calls it, so the ADC is only ever read from one thread. Call it
+      every frame; after a pause longer than the ring buffer holds, only the latest samples are taken.
+      update() filters the new samples with an integer low pass filter, works out the tilt with a
+      fixed point atan2, and runs them through two table driven state machines: one follows the face the
+      cube lies on (flip onto the front face and back, tilt to the left or right and back), the other
+      sudden movement (a tap, or shaking). Gestures are queued for nextEvent().
+*/
+class MotionSampler {
+  private:
+    MotionSample ring[MOTION_RING_SIZE];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t dropped;
+    uint32_t nextSampleTime;
+    bool running;
+    bool primed;
+    int32_t filtered[3];
+    int16_t theta, phi;
+    uint16_t activity;
+    uint8_t pose, candidatePose;
+    uint8_t poseTicks;
+    uint8_t poseState, motionState;
+    uint16_t poseStateTicks, motionStateTicks;
+    uint8_t events[8];
+    uint8_t eventHead, eventTail;
+
+    void process(const MotionSample &s);
+    void queue(uint8_t event);
+
+  public:
+    MotionSampler();
+
+    void begin(void);
+    void end(void);
+    void sample(void);
+    int update(void);
+    int nextEvent(void);
+    int history(MotionSample *out, int count);
+
+    int getX(void) const { return this->filtered[0] >> 8; }
+    int getY(void) const { return this->filtered[1] >> 8; }
+    int getZ(void) const { return this->filtered[2] >> 8; }
+    int16_t getTheta(void) const { return this->theta; }
+    int16_t getPhi(void) const { return this->phi; }
+    int getActivity(void) const { return this->activity; }
+    int getPose(void) const { return this->pose; }
+    uint32_t droppedSamples(void) const { return this->dropped; }
+};
+
+#endif
@@ -0,0 +1,253 @@
+#include "cube-particles.h"
+
+/** Construct an emitter at the origin that emits nothing until given a rate. */
+ParticleEmitter::ParticleEmitter() :
+    vx(0), vy(0), vz(0),
+    spread(0),
+    rate(0),
+    life(60),
+    color(CRGB::White),
+    colorSpread(0),
+    owed(0)
+{ }
+
+/** Construct an empty system without gravity or drag, culling particles that leave the cube. */
+ParticleSystem::ParticleSystem() :
+    count(0),
+    drag(0),
+    cull(true)
+{
+  this->gravity[0] = this->gravity[1] = this->gravity[2] = 0;
+}
+
+/** Add a particle.
+
+  @param position Where it starts.
+  @param vx, vy, vz Its velocity, in 1/PARTICLE_VELOCITY_ONE of a voxel per step.
+  @param color Its color at the start of its life.
+  @param lifeSteps How many steps it lives.
+
+  @return The index of the particle, or -1 if the pool is full. Indices change as particles die.
+*/
+int ParticleSystem::spawn(PointQ position, int16_t vx, int16_t vy, int16_t vz, CRGB color, uint16_t lifeSteps)
+{
+  if(this->count == PARTICLE_MAX)
+    return -1;
+  int i = this->count++;
+  this->x[i] = position.x;
+  this->y[i] = position.y;
+  this->z[i] = position.z;
+  this->vx[i] = vx;
+  this->vy[i] = vy;
+  this->vz[i] = vz;
+  this->life[i] = 0xffff;
+  this->decay[i] = lifeSteps > 1 ? (0xffff + lifeSteps - 1) / lifeSteps : 0xffff;	// dies on step lifeSteps
+  this->red[i] = color.r;
+  this->green[i] = color.g;
+  this->blue[i] = color.b;
+  return i;
+}
+
+/** Remove a particle. The last particle takes its index.
+
+  @param index The index of the particle.
+*/
+void ParticleSystem::kill(int index)
+{
+  int last = --this->count;
+  this->x[index] = this->x[last];
+  this->y[index] = this->y[last];
+  this->z[index] = this->z[last];
+  this->vx[index] = this->vx[last];
+  this->vy[index] = this->vy[last];
+  this->vz[index] = this->vz[last];
+  this->life[index] = this->life[last];
+  this->decay[index] = this->decay[last];
+  this->red[index] = this->red[last];
+  this->green[index] = this->green[last];
+  this->blue[index] = this->blue[last];
+}
+
+/** Spawn a step's worth of an emitter's stream; fractions of a particle are carried over to the next step.
+
+  @param emitter The emitter.
+
+  @return The number of particles spawned.
+*/
+int ParticleSystem::emit(ParticleEmitter &emitter)
+{
+  uint32_t owed = (uint32_t)emitter.owed + emitter.rate;
+  emitter.owed = owed & 0xff;
+  return this->burst(emitter, owed >> 8);
+}
+
+/** Spawn a number of particles from an emitter at once.
+
+  @param emitter The emitter.
+  @param particles How many to spawn.
+
+  @return The number spawned, fewer if the pool fills up.
+*/
+int ParticleSystem::burst(ParticleEmitter &emitter, int particles)
+{
+  // clamped so that the range fits random16 and the squares below sum within an int32
+  int32_t spread = emitter.spread < PARTICLE_MAX_SPREAD ? emitter.spread : PARTICLE_MAX_SPREAD;
+  uint16_t range = 2 * spread + 1;
+  int32_t limit = spread * spread;
+  int spawned = 0;
+  for( ; spawned < particles; spawned++) {
+    // a random velocity within a sphere, so bursts come out round rather than square
+    int32_t dx, dy, dz;
+    do {
+      dx = (int32_t)random16(range) - spread;
+      dy = (int32_t)random16(range) - spread;
+      dz = (int32_t)random16(range) - spread;
+    } while(dx * dx + dy * dy + dz * dz > limit);
+    CRGB c = emitter.color;
+    if(emitter.colorSpread) {
+      c.r = qsub8(c.r, random8(emitter.colorSpread));
+      c.g = qsub8(c.g, random8(emitter.colorSpread));
+      c.b = qsub8(c.b, random8(emitter.colorSpread));
+    }
+    int i = this->spawn(emitter.position, emitter.vx + dx, emitter.vy + dy, emitter.vz + dz, c, emitter.life);
+    if(i < 0)
+      break;
+  }
+  return spawned;
+}
+
+/** Add a constant acceleration to every particle, e.g. setGravity(0, 0, -8) to make them fall.
+
+  @param x, y, z The change in velocity per step, in 1/PARTICLE_VELOCITY_ONE of a voxel per step.
+*/
+void ParticleSystem::setGravity(int16_t x, int16_t y, int16_t z)
+{
+  this->gravity[0] = x;
+  this->gravity[1] = y;
+  this->gravity[2] = z;
+}
+
+/** Move all particles on by one step and remove the ones that have died.
+  Each pass runs over one field of all particles, so the compiler can keep it in registers or vectorize it.
+*/
+void ParticleSystem::step(void)
+{
+  int n = this->count;
+  if(this->gravity[0])
+    for(int i = 0; i < n; i++)
+      this->vx[i] += this->gravity[0];
+  if(this->gravity[1])
+    for(int i = 0; i < n; i++)
+      this->vy[i] += this->gravity[1];
+  if(this->gravity[2])
+    for(int i = 0; i < n; i++)
+      this->vz[i] += this->gravity[2];
+
+  // drag takes drag/65536 of the velocity off every step
+  if(this->drag) {
+    int32_t d = this->drag;
+    for(int i = 0; i < n; i++) {
+      this->vx[i] -= (this->vx[i] * d) >> 16;
+      this->vy[i] -= (this->vy[i] * d) >> 16;
+      this->vz[i] -= (this->vz[i] * d) >> 16;
+    }
+  }
+
+  // from 1/4096 to 1/256 of a voxel, rounding
+  const int shift = 4;
+  const int half = 1 << (shift - 1);
+  for(int i = 0; i < n; i++) {
+    this->x[i] += (this->vx[i] + half) >> shift;
+    this->y[i] += (this->vy[i] + half) >> shift;
+    this->z[i] += (this->vz[i] + half) >> shift;
+  }
+
+  // a particle a whole voxel outside the cube can no longer light any of it
+  const int16_t low = -POINTQ_ONE, high = CUBE_SIZE * POINTQ_ONE;
+  for(int i = 0; i < this->count; ) {
+    bool outside = this->cull &&
+        (this->x[i] <= low || this->x[i] >= high ||
+         this->y[i] <= low || this->y[i] >= high ||
+         this->z[i] <= low || this->z[i] >= high);
+    if(outside || this->life[i] <= this->decay[i]) {
+      this->kill(i);	// the last particle moves here and is looked at next
+    } else {
+      this->life[i] -= this->decay[i];
+      i++;
+    }
+  }
+}
+
+/** Add light to a voxel: a color scaled by a weight of 0 to 256, saturating. */
+static inline void splat(CRGB &voxel, const CRGB &c, uint16_t weight)
+{
+  voxel.r = qadd8(voxel.r, (c.r * weight) >> 8);
+  voxel.g = qadd8(voxel.g, (c.g * weight) >> 8);
+  voxel.b = qadd8(voxel.b, (c.b * weight) >> 8);
+}
+
+/** Draw the particles of a system, adding their light to what is drawn.
+  Each particle's color, faded by its age, is shared between the eight voxels around it in proportion to
+  how close it is to each, so particles glide between voxels instead of jumping.
+
+  @param particles The particles.
+*/
+void Cube::draw(ParticleSystem &particles)
+{
+  const int n = this->size;
+  const int last = n - 1;
+  int lo[3] = { n, n, n }, hi[3] = { -1, -1, -1 };
+
+  for(int i = 0; i < particles.count; i++) {
+    uint8_t bright = particles.life[i] >> 8;
+    CRGB c(scale8(particles.red[i], bright), scale8(particles.green[i], bright), scale8(particles.blue[i], bright));
+    if(!c)
+      continue;
+
+    int16_t p[3] = { particles.x[i], particles.y[i], particles.z[i] };
+    int v0[3], from[3], to[3];
+    uint16_t w[3][2];
+    bool in[3][2];
+    bool skip = false;
+    for(int a = 0; a < 3; a++) {
+      v0[a] = p[a] >> 8;	// rounds down, also below zero
+      uint16_t f = p[a] & 0xff;
+      w[a][0] = 256 - f;
+      w[a][1] = f;
+      in[a][0] = v0[a] >= 0 && v0[a] <= last;
+      in[a][1] = f && v0[a] + 1 >= 0 && v0[a] + 1 <= last;
+      if(!in[a][0] && !in[a][1]) {
+        skip = true;
+        break;
+      }
+      from[a] = in[a][0] ? v0[a] : v0[a] + 1;
+      to[a] = in[a][1] ? v0[a] + 1 : v0[a];
+    }
+    if(skip)
+      continue;
+    // only once the particle lights a voxel on every axis, or a miss on one axis would widen the others
+    for(int a = 0; a < 3; a++) {
+      if(from[a] < lo[a]) lo[a] = from[a];
+      if(to[a] > hi[a]) hi[a] = to[a];
+    }
+
+    for(int dz = 0; dz < 2; dz++) {
+      if(!in[2][dz])
+        continue;
+      for(int dx = 0; dx < 2; dx++) {
+        if(!in[0][dx])
+          continue;
+        uint16_t wxz = (w[0][dx] * w[2][dz]) >> 8;
+        CRGB *row = &this->leds[index(v0[0] + dx, 0, v0[2] + dz)];
+        for(int dy = 0; dy < 2; dy++)
+          if(in[1][dy])
+            splat(row[v0[1] + dy], c, (wxz * w[1][dy]) >> 8);
+      }
+    }
+  }
+
+  if(hi[0] >= 0) {
+    this->dirty->include(lo[0], lo[1], lo[2]);
+    this->dirty->include(hi[0], hi[1], hi[2]);
+  }
+}
@@ -0,0 +1,77 @@
+#ifndef _L3D_PARTICLES_H
+#define _L3D_PARTICLES_H
+
+#include "beta-cube-library-fastled.h"
+
+/**   Number of particles a ParticleSystem holds. Each takes 19 bytes. */
+#ifndef PARTICLE_MAX
+#define PARTICLE_MAX 1024
+#endif
+
+/**   Velocities count 1/PARTICLE_VELOCITY_ONE of a voxel per step, so that gravity and slow drifts
+      can be small fractions of a voxel per step. */
+#define PARTICLE_VELOCITY_ONE 4096
+
+/**   Largest spread an emitter uses, 4 voxels per step; larger spreads are taken as this. */
+#define PARTICLE_MAX_SPREAD 16384
+
+/**   Spawns particles from a point: a steady stream with ParticleSystem::emit, or all at once with
+      ParticleSystem::burst. Each particle gets the emitter's velocity plus a random velocity of up to
+      spread (at most PARTICLE_MAX_SPREAD) in any direction, and the color with each channel lowered by up to colorSpread at random.
+*/
+struct ParticleEmitter {
+  PointQ position;
+  int16_t vx, vy, vz;
+  uint16_t spread;
+  uint16_t rate;		// particles per step, in 8.8 fixed point so that streams can be thin
+  uint16_t life;		// steps a particle lives, fading out as it goes
+  CRGB color;
+  uint8_t colorSpread;
+  uint16_t owed;
+
+  ParticleEmitter();
+};
+
+/**   A pool of particles moving in fixed point, drawn into the cube with Cube::draw.
+      Particles are stored as a structure of arrays, one array per field, and live particles are kept
+      packed at the front: spawning takes the next free slot and killing moves the last live particle into
+      the hole, so both take constant time, nothing is allocated, and step() and drawing run straight
+      through the arrays.
+      Positions are in the 8.8 units of PointQ, with whole numbers at voxel centers; velocities in
+      1/PARTICLE_VELOCITY_ONE of a voxel per step. Each step adds gravity to the velocities, takes drag
+      off them, moves the particles, and ages them; they fade out over their life and die at its end, or
+      when they leave the cube if culling is on.
+*/
+class ParticleSystem {
+  private:
+    int16_t x[PARTICLE_MAX], y[PARTICLE_MAX], z[PARTICLE_MAX];
+    int16_t vx[PARTICLE_MAX], vy[PARTICLE_MAX], vz[PARTICLE_MAX];
+    uint16_t life[PARTICLE_MAX], decay[PARTICLE_MAX];
+    uint8_t red[PARTICLE_MAX], green[PARTICLE_MAX], blue[PARTICLE_MAX];
+    int count;
+    int16_t gravity[3];
+    uint16_t drag;
+    bool cull;
+
+  public:
+    ParticleSystem();
+
+    int spawn(PointQ position, int16_t vx, int16_t vy, int16_t vz, CRGB color, uint16_t lifeSteps);
+    void kill(int index);
+    void clear(void) { this->count = 0; }
+    int emit(ParticleEmitter &emitter);
+    int burst(ParticleEmitter &emitter, int particles);
+    void step(void);
+
+    void setGravity(int16_t x, int16_t y, int16_t z);
+    void setDrag(uint16_t drag) { this->drag = drag; }
+    void setCulling(bool enabled) { this->cull = enabled; }
+    int particleCount(void) const { return this->count; }
+    static int capacity(void) { return PARTICLE_MAX; }
+    PointQ position(int index) const { return PointQ(this->x[index], this->y[index], this->z[index]); }
+    uint8_t brightness(int index) const { return this->life[index] >> 8; }
+
+    friend class Cube;
+};
+
+#endif
@@ -0,0 +1,428 @@
+#ifndef _L3D_RASTER_H
+#define _L3D_RASTER_H
+
+#include <math.h>
+#include "beta-cube-library-fastled.h"
+
+/**   Rasterizers shared by Cube and CubeCommandList, so that a recorded command lights exactly the
+      voxels the Cube method of the same name would. Each one hands the voxels it covers to a sink:
+
+        sink.plot(x, y, z)         a voxel that may lie outside the cube
+        sink.set(x, y, z)          a voxel inside the cube
+        sink.span(x, z, y0, y1)    voxels y0 to y1 of a row inside the cube
+
+      Not part of the public API; only included by the library sources.
+*/
+
+/** Clip the extent of a shape along one axis to the cube.
+
+  @param c Center of the shape along the axis.
+  @param reach Distance from the center to the edge of the shape.
+  @param size Size of the cube.
+  @param lo, hi Set to the first and last voxel covered by the shape.
+
+  @return False if the shape misses the cube along this axis.
+*/
+static inline bool clipExtent(float c, float reach, int size, int &lo, int &hi)
+{
+  float a = c - reach;
+  float b = c + reach;
+  if(b < 0 || a > size - 1)
+    return false;
+  lo = (a <= 0) ? 0 : (int)ceil(a);
+  hi = (b >= size - 1) ? size - 1 : (int)floor(b);
+  return lo <= hi;
+}
+
+/** Convert to 16.16 fixed point, rounding to nearest. */
+static inline int32_t toFixed16(float v)
+{
+  return (int32_t)(v * 65536.0f + ((v < 0) ? -0.5f : 0.5f));
+}
+
+/** Integer square root, rounded down. For lengths of vectors where sqrt16's range is too small. */
+static inline uint32_t isqrt32(uint32_t n)
+{
+  if(n == 0)
+    return 0;
+  uint32_t root = 0;
+  uint32_t bit = 1UL << ((31 - __builtin_clz(n)) & ~1);
+  while(bit) {
+    if(n >= root + bit) {
+      n -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+/** Test whether a voxel is on a shell by measuring its distance to the center in floating point. */
+static inline bool onShell(int i, int j, int k, float x, float y, float z, float r, float thickness)
+{
+  return abs(sqrt(pow(i-x,2)+pow(j-y,2)+pow(k-z,2))-r)<thickness;
+}
+
+/** Rasterize a line with the 3D form of Bresenham's algorithm. Calls sink.plot for every voxel. */
+template<class Sink>
+void rasterLine(int x1, int y1, int z1, int x2, int y2, int z2, Sink &sink)
+{
+  int x = x1, y = y1, z = z1;
+  int dx = x2 - x1;
+  int dy = y2 - y1;
+  int dz = z2 - z1;
+  int x_inc = (dx < 0) ? -1 : 1;
+  int l = abs(dx);
+  int y_inc = (dy < 0) ? -1 : 1;
+  int m = abs(dy);
+  int z_inc = (dz < 0) ? -1 : 1;
+  int n = abs(dz);
+  int dx2 = l << 1;
+  int dy2 = m << 1;
+  int dz2 = n << 1;
+
+  if((l >= m) && (l >= n)) {
+    int err_1 = dy2 - l;
+    int err_2 = dz2 - l;
+
+    for(int i = 0; i < l; i++) {
+      sink.plot(x, y, z);
+
+      if(err_1 > 0) {
+        y += y_inc;
+        err_1 -= dx2;
+      }
+
+      if(err_2 > 0) {
+        z += z_inc;
+        err_2 -= dx2;
+      }
+
+      err_1 += dy2;
+      err_2 += dz2;
+      x += x_inc;
+    }
+  } else if((m >= l) && (m >= n)) {
+    int err_1 = dx2 - m;
+    int err_2 = dz2 - m;
+
+    for(int i = 0; i < m; i++) {
+      sink.plot(x, y, z);
+
+      if(err_1 > 0) {
+        x += x_inc;
+        err_1 -= dy2;
+      }
+
+      if(err_2 > 0) {
+        z += z_inc;
+        err_2 -= dy2;
+      }
+
+      err_1 += dx2;
+      err_2 += dz2;
+      y += y_inc;
+    }
+  } else {
+    int err_1 = dy2 - n;
+    int err_2 = dx2 - n;
+
+    for(int i = 0; i < n; i++) {
+      sink.plot(x, y, z);
+
+      if(err_1 > 0) {
+        y += y_inc;
+        err_1 -= dz2;
+      }
+
+      if(err_2 > 0) {
+        x += x_inc;
+        err_2 -= dz2;
+      }
+
+      err_1 += dy2;
+      err_2 += dx2;
+      z += z_inc;
+    }
+  }
+
+  sink.plot(x, y, z);
+}
+
+/** The voxels rasterLine steps through, in closed form, for finding the steps of a line that fall
+  inside a range of coordinates without walking it. The line takes count steps along its major axis, the
+  longest, and lights a voxel before each step and one after the last.
+*/
+struct LineSteps {
+  int start[3];
+  int inc[3];
+  int delta[3];
+  int major;
+  int count;
+
+  LineSteps(int x1, int y1, int z1, int x2, int y2, int z2) {
+    int ends[3] = { x2, y2, z2 };
+    this->start[0] = x1;
+    this->start[1] = y1;
+    this->start[2] = z1;
+    for(int a = 0; a < 3; a++) {
+      int d = ends[a] - this->start[a];
+      this->inc[a] = (d < 0) ? -1 : 1;
+      this->delta[a] = abs(d);
+    }
+    // ties go to x, then y, as in rasterLine
+    const int *d = this->delta;
+    this->major = (d[0] >= d[1] && d[0] >= d[2]) ? 0 : (d[1] >= d[2]) ? 1 : 2;
+    this->count = d[this->major];
+  }
+
+  /** How far a coordinate has moved from the start at a step, 0 to delta[axis]. */
+  int offset(int axis, int step) const {
+    if(axis == this->major)
+      return step;
+    if(!this->delta[axis])
+      return 0;
+    // Bresenham's error term crosses zero after this many steps
+    int64_t l = this->count;
+    return (2 * (int64_t)this->delta[axis] * step + l - 1) / (2 * l);
+  }
+
+  int coordinate(int axis, int step) const {
+    return this->start[axis] + this->inc[axis] * this->offset(axis, step);
+  }
+
+  /** Narrow a range of steps to the ones whose coordinate along an axis is within lo to hi.
+
+    @param first, last The range of steps, narrowed in place.
+
+    @return False if no step of the range is within lo to hi.
+  */
+  bool within(int axis, int lo, int hi, int &first, int &last) const {
+    if(first > last)
+      return false;
+    // the coordinate only ever moves one way, so measure along that way and search for the ends
+    int from = this->inc[axis] > 0 ? lo - this->start[axis] : this->start[axis] - hi;
+    int to = this->inc[axis] > 0 ? hi - this->start[axis] : this->start[axis] - lo;
+    if(to < this->offset(axis, first) || from > this->offset(axis, last))
+      return false;
+    int a = first, b = last;
+    while(a < b) {
+      int m = a + (b - a) / 2;
+      if(this->offset(axis, m) < from) a = m + 1; else b = m;
+    }
+    int c = a, d = last;
+    while(c < d) {
+      int m = c + (d - c + 1) / 2;
+      if(this->offset(axis, m) > to) d = m - 1; else c = m;
+    }
+    first = a;
+    last = c;
+    return true;
+  }
+};
+
+/** Rasterize steps first to last of a line, lighting the same voxels as rasterLine does for them.
+  Calls sink.plot for every voxel.
+*/
+template<class Sink>
+void rasterLineSteps(const LineSteps &line, int first, int last, Sink &sink)
+{
+  const int major = line.major;
+  const int l = line.count;
+  int p[3], err[3];
+  for(int a = 0; a < 3; a++) {
+    p[a] = line.coordinate(a, first);
+    // the error term of rasterLine after first steps
+    err[a] = (int)(2 * (int64_t)line.delta[a] * (first + 1) - l - 2 * (int64_t)l * line.offset(a, first));
+  }
+  for(int step = first; ; step++) {
+    sink.plot(p[0], p[1], p[2]);
+    if(step == last)
+      break;
+    for(int a = 0; a < 3; a++) {
+      if(a == major)
+        continue;
+      if(err[a] > 0) {
+        p[a] += line.inc[a];
+        err[a] -= 2 * l;
+      }
+      err[a] += 2 * line.delta[a];
+    }
+    p[major] += line.inc[major];
+  }
+}
+
+/** Rasterize the slabs k0 to k1 of a filled sphere with integers only. Calls sink.span for every row.
+  Each row is a span whose half width is the largest w with w*w <= r*r - dz*dz - dx*dx, found by
+  shrinking the width of the previous row.
+*/
+template<int N, class Sink>
+void rasterSphere(int x, int y, int z, int r, int k0, int k1, Sink &sink)
+{
+  if(r < 0)
+    return;
+  int r2 = r * r;
+  for(int dz = -r; dz <= r; dz++) {
+    int k = z + dz;
+    if(k < k0 || k > k1 || k < 0 || k >= N)
+      continue;
+    int rz2 = r2 - dz * dz;
+    int w = r;
+    for(int dx = 0; dx <= r; dx++) {
+      int rem = rz2 - dx * dx;
+      if(rem < 0)
+        break;
+      while(w * w > rem)
+        w--;
+      int j0 = (y - w < 0) ? 0 : y - w;
+      int j1 = (y + w >= N) ? N - 1 : y + w;
+      if(j0 > j1)
+        continue;
+      for(int side = 0; side < 2; side++) {
+        int i = side ? x - dx : x + dx;
+        if(side && dx == 0)
+          break;
+        if(i < 0 || i >= N)
+          continue;
+        sink.span(i, k, j0, j1);
+      }
+    }
+  }
+}
+
+/** Find the box of voxels a shell can touch.
+
+  @return False if the shell misses the cube.
+*/
+template<int N>
+bool shellBounds(float x, float y, float z, float r, float thickness, int &i0, int &i1, int &j0, int &j1, int &k0, int &k1)
+{
+  float outer = r + thickness;
+  return thickness > 0 && outer > 0 &&
+      clipExtent(x, outer, N, i0, i1) &&
+      clipExtent(y, outer, N, j0, j1) &&
+      clipExtent(z, outer, N, k0, k1);
+}
+
+/** Rasterize the part of a shell inside a box found by shellBounds. Calls sink.set for every voxel.
+  A voxel is on the shell when (r - thickness) < distance < (r + thickness).  Compare squared
+  distances in 16.16 fixed point instead, stepping them along each row with additions only.
+  Voxels that land within the rounding error of the fixed point math from either edge are decided
+  in floating point, so the result is voxel for voxel the same as evaluating the distance of every voxel.
+*/
+template<class Sink>
+void rasterShell(float x, float y, float z, float r, float thickness, int i0, int i1, int j0, int j1, int k0, int k1, Sink &sink)
+{
+  float outer = r + thickness;
+  float inner = r - thickness;
+  if(outer >= 16384 || abs(x) >= 16384 || abs(y) >= 16384 || abs(z) >= 16384) {
+    // out of fixed point range
+    for(int k = k0; k <= k1; k++)
+      for(int i = i0; i <= i1; i++)
+        for(int j = j0; j <= j1; j++)
+          if(onShell(i, j, k, x, y, z, r, thickness))
+            sink.set(i, j, k);
+    return;
+  }
+
+  const int64_t one = 65536;
+  int64_t outerQ = toFixed16(outer);
+  int64_t outer2 = outerQ * outerQ;
+  int64_t outerSlack = 4 * outerQ + 64;
+  int64_t inner2 = -1;
+  int64_t innerSlack = 0;
+  if(inner >= 0) {
+    int64_t innerQ = toFixed16(inner);
+    inner2 = innerQ * innerQ;
+    innerSlack = 4 * innerQ + 64;
+  }
+  int32_t cx = toFixed16(x);
+  int32_t cy = toFixed16(y);
+  int32_t cz = toFixed16(z);
+
+  for(int k = k0; k <= k1; k++) {
+    int64_t dz = k * one - cz;
+    for(int i = i0; i <= i1; i++) {
+      int64_t dx = i * one - cx;
+      int64_t a = dz * dz + dx * dx;
+      if(a >= outer2 + outerSlack)
+        continue;
+      int64_t dy = j0 * one - cy;
+      int64_t d2 = a + dy * dy;
+      int64_t step = 2 * one * dy + one * one;
+      for(int j = j0; j <= j1; j++) {
+        if(d2 < outer2 - outerSlack && d2 > inner2 + innerSlack)
+          sink.set(i, j, k);
+        else if(d2 < outer2 + outerSlack && d2 > inner2 - innerSlack && onShell(i, j, k, x, y, z, r, thickness))
+          sink.set(i, j, k);
+        d2 += step;
+        step += 2 * one * one;
+      }
+    }
+  }
+}
+
+/** Clip the extent of a shape along one axis to the cube, in the 8.8 fixed point of PointQ.
+
+  @return False if the shape misses the cube along this axis.
+*/
+static inline bool clipExtentQ(int32_t c, int32_t reach, int size, int &lo, int &hi)
+{
+  int32_t a = c - reach;
+  int32_t b = c + reach;
+  if(b < 0 || a > (size - 1) * POINTQ_ONE)
+    return false;
+  lo = (a <= 0) ? 0 : (a + POINTQ_ONE - 1) / POINTQ_ONE;
+  hi = (b >= (size - 1) * POINTQ_ONE) ? size - 1 : b / POINTQ_ONE;
+  return lo <= hi;
+}
+
+/** Find the box of voxels a shell in 8.8 fixed point can touch.
+
+  @return False if the shell misses the cube.
+*/
+template<int N>
+bool shellBoundsQ(PointQ c, int32_t r, int32_t thickness, int &i0, int &i1, int &j0, int &j1, int &k0, int &k1)
+{
+  int32_t outer = r + thickness;
+  return thickness > 0 && outer > 0 &&
+      clipExtentQ(c.x, outer, N, i0, i1) &&
+      clipExtentQ(c.y, outer, N, j0, j1) &&
+      clipExtentQ(c.z, outer, N, k0, k1);
+}
+
+/** Rasterize the part of a shell in 8.8 fixed point inside a box found by shellBoundsQ.
+  Calls sink.set for every voxel. A voxel is on the shell when (r - thickness) < distance < (r + thickness);
+  all the inputs are exact in fixed point, so squared distances are compared exactly, stepping them
+  along each row with additions only.
+*/
+template<class Sink>
+void rasterShellQ(PointQ c, int32_t r, int32_t thickness, int i0, int i1, int j0, int j1, int k0, int k1, Sink &sink)
+{
+  const int64_t one = POINTQ_ONE;
+  int64_t outer2 = (int64_t)(r + thickness) * (r + thickness);
+  int64_t inner2 = (r >= thickness) ? (int64_t)(r - thickness) * (r - thickness) : -1;
+
+  for(int k = k0; k <= k1; k++) {
+    int64_t dz = k * one - c.z;
+    for(int i = i0; i <= i1; i++) {
+      int64_t dx = i * one - c.x;
+      int64_t a = dz * dz + dx * dx;
+      if(a >= outer2)
+        continue;
+      int64_t dy = j0 * one - c.y;
+      int64_t d2 = a + dy * dy;
+      int64_t step = 2 * one * dy + one * one;
+      for(int j = j0; j <= j1; j++) {
+        if(d2 < outer2 && d2 > inner2)
+          sink.set(i, j, k);
+        d2 += step;
+        step += 2 * one * one;
+      }
+    }
+  }
+}
+
+#endif
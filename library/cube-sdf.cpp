@@ -0,0 +1,408 @@
+#include <math.h>
+#include "cube-sdf.h"
+#include "cube-raster.h"
+
+/** One voxel in 24.8 fixed point. */
+#define SDF_ONE 256
+
+/** Distance from the center of a 2x2x2 block to the centers of its voxels, sqrt(3)/2 voxels. */
+#define SDF_BLOCK_REACH 222
+
+/** Largest coordinate or length a node keeps, in voxels. */
+#define SDF_LIMIT 127.0f
+
+/** Clamp a difference of coordinates so that the sum of three squares fits in a uint32_t. */
+static inline int32_t clampDelta(int32_t v)
+{
+  return (v > 32767) ? 32767 : (v < -32767) ? -32767 : v;
+}
+
+/** Length of a vector in 24.8 fixed point. */
+static inline int32_t length3(int32_t x, int32_t y, int32_t z)
+{
+  x = clampDelta(x);
+  y = clampDelta(y);
+  z = clampDelta(z);
+  return isqrt32((uint32_t)(x * x) + (uint32_t)(y * y) + (uint32_t)(z * z));
+}
+
+static inline int32_t length2(int32_t x, int32_t y)
+{
+  x = clampDelta(x);
+  y = clampDelta(y);
+  return isqrt32((uint32_t)(x * x) + (uint32_t)(y * y));
+}
+
+/** Convert a coordinate to 24.8 fixed point, clamped to SDF_LIMIT voxels. */
+static int32_t toQ8(float v)
+{
+  if(v > SDF_LIMIT) v = SDF_LIMIT;
+  if(v < -SDF_LIMIT) v = -SDF_LIMIT;
+  return (int32_t)(v * SDF_ONE + ((v < 0) ? -0.5f : 0.5f));
+}
+
+/** Convert a length to 24.8 fixed point, clamped to 0 to SDF_LIMIT voxels. */
+static int32_t lengthToQ8(float v)
+{
+  return (v > 0) ? toQ8(v) : 0;
+}
+
+/** Construct an empty scene. */
+SdfScene::SdfScene() : count(0)
+{ }
+
+/** Remove all nodes. */
+void SdfScene::clear(void)
+{
+  this->count = 0;
+}
+
+/** Append a node.
+
+  @return Index of the node, or -1 if the scene is full.
+*/
+int SdfScene::add(SdfNode &node, uint8_t type, Color col)
+{
+  if(this->count == SDF_MAX_NODES)
+    return -1;
+  node.type = type;
+  node.a = node.b = 0;
+  node.color = CRGB(col.red, col.green, col.blue);
+  this->nodes[this->count] = node;
+  return this->count++;
+}
+
+/** Add a sphere.
+
+  @param x, y, z Position of the center of the sphere.
+  @param r Radius of the sphere.
+  @param col Color of the sphere.
+
+  @return Index of the node, or -1 if the scene is full.
+*/
+int SdfScene::sphere(float x, float y, float z, float r, Color col)
+{
+  SdfNode node;
+  node.p[0] = toQ8(x);
+  node.p[1] = toQ8(y);
+  node.p[2] = toQ8(z);
+  node.p[3] = lengthToQ8(r);
+  return this->add(node, SDF_SPHERE, col);
+}
+
+/** Add a sphere.
+
+  @param center Position of the center of the sphere.
+  @param r Radius of the sphere.
+  @param col Color of the sphere.
+
+  @return Index of the node, or -1 if the scene is full.
+*/
+int SdfScene::sphere(Point center, float r, Color col)
+{
+  return this->sphere(center.x, center.y, center.z, r, col);
+}
+
+/** Add a box aligned with the axes of the cube.
+
+  @param center Position of the center of the box.
+  @param halfSize Distance from the center to the faces of the box along each axis.
+  @param col Color of the box.
+
+  @return Index of the node, or -1 if the scene is full.
+*/
+int SdfScene::box(Point center, Point halfSize, Color col)
+{
+  SdfNode node;
+  node.p[0] = toQ8(center.x);
+  node.p[1] = toQ8(center.y);
+  node.p[2] = toQ8(center.z);
+  node.p[3] = lengthToQ8(halfSize.x);
+  node.p[4] = lengthToQ8(halfSize.y);
+  node.p[5] = lengthToQ8(halfSize.z);
+  return this->add(node, SDF_BOX, col);
+}
+
+/** Add a torus lying in a plane of constant z.
+
+  @param center Position of the center of the torus.
+  @param ringRadius Distance from the center to the middle of the tube.
+  @param tubeRadius Radius of the tube.
+  @param col Color of the torus.
+
+  @return Index of the node, or -1 if the scene is full.
+*/
+int SdfScene::torus(Point center, float ringRadius, float tubeRadius, Color col)
+{
+  SdfNode node;
+  node.p[0] = toQ8(center.x);
+  node.p[1] = toQ8(center.y);
+  node.p[2] = toQ8(center.z);
+  node.p[3] = lengthToQ8(ringRadius);
+  node.p[4] = lengthToQ8(tubeRadius);
+  return this->add(node, SDF_TORUS, col);
+}
+
+/** Add a capsule: every point within a distance of a line segment.
+
+  @param a, b Ends of the segment.
+  @param r Radius of the capsule.
+  @param col Color of the capsule.
+
+  @return Index of the node, or -1 if the scene is full.
+*/
+int SdfScene::capsule(Point a, Point b, float r, Color col)
+{
+  SdfNode node;
+  node.p[0] = toQ8(a.x);
+  node.p[1] = toQ8(a.y);
+  node.p[2] = toQ8(a.z);
+  node.p[3] = clampDelta(toQ8(b.x) - node.p[0]);
+  node.p[4] = clampDelta(toQ8(b.y) - node.p[1]);
+  node.p[5] = clampDelta(toQ8(b.z) - node.p[2]);
+  node.p[6] = lengthToQ8(r);
+  // 2^32 / |b - a|^2, so that projecting onto the segment needs no division per voxel
+  uint32_t ba2 = (uint32_t)(node.p[3] * node.p[3]) + (uint32_t)(node.p[4] * node.p[4]) + (uint32_t)(node.p[5] * node.p[5]);
+  node.p[7] = (ba2 > 1) ? (int32_t)(uint32_t)(0x100000000ULL / ba2) : 0;
+  return this->add(node, SDF_CAPSULE, col);
+}
+
+/** Add a plane. Everything on the side the normal points away from is inside.
+
+  @param normal Direction the surface faces; need not be of unit length.
+  @param offset Distance of the plane from the origin along the normal.
+  @param col Color of the plane.
+
+  @return Index of the node, or -1 if the scene is full or the normal is zero.
+*/
+int SdfScene::plane(Point normal, float offset, Color col)
+{
+  float length = sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+  if(length == 0)
+    return -1;
+  SdfNode node;
+  node.p[0] = (int32_t)(normal.x / length * 16384);
+  node.p[1] = (int32_t)(normal.y / length * 16384);
+  node.p[2] = (int32_t)(normal.z / length * 16384);
+  node.p[3] = toQ8(offset);
+  return this->add(node, SDF_PLANE, col);
+}
+
+/** Append an operation on two nodes.
+
+  @return Index of the node, or -1 if the scene is full or an operand is not a node of the scene.
+*/
+int SdfScene::operation(uint8_t type, int a, int b)
+{
+  if(a < 0 || a >= this->count || b < 0 || b >= this->count)
+    return -1;
+  SdfNode node;
+  int n = this->add(node, type, Black);
+  if(n >= 0) {
+    this->nodes[n].a = a;
+    this->nodes[n].b = b;
+  }
+  return n;
+}
+
+/** Add the union of two nodes: everything inside either. Each voxel takes the color of the nearer surface.
+
+  @return Index of the node, or -1 if the scene is full or an operand is invalid.
+*/
+int SdfScene::unionOf(int a, int b)
+{
+  return this->operation(SDF_UNION, a, b);
+}
+
+/** Add the intersection of two nodes: everything inside both.
+
+  @return Index of the node, or -1 if the scene is full or an operand is invalid.
+*/
+int SdfScene::intersectionOf(int a, int b)
+{
+  return this->operation(SDF_INTERSECTION, a, b);
+}
+
+/** Add the difference of two nodes: everything inside a but not inside b, in the color of a.
+
+  @return Index of the node, or -1 if the scene is full or an operand is invalid.
+*/
+int SdfScene::differenceOf(int a, int b)
+{
+  return this->operation(SDF_DIFFERENCE, a, b);
+}
+
+/** Add the smooth union of two nodes: a union whose seam is filled in with a fillet, with colors
+  blended across it.
+
+  @param a, b The nodes to join.
+  @param k Width of the fillet, in voxels.
+
+  @return Index of the node, or -1 if the scene is full or an operand is invalid.
+*/
+int SdfScene::smoothUnionOf(int a, int b, float k)
+{
+  int32_t width = lengthToQ8(k);
+  if(width == 0)
+    return this->unionOf(a, b);
+  int n = this->operation(SDF_SMOOTH_UNION, a, b);
+  if(n >= 0) {
+    this->nodes[n].p[0] = width;
+    this->nodes[n].p[1] = (128 << 16) / width;
+  }
+  return n;
+}
+
+/** Evaluate the distance field at a point.
+
+  @param root Node to evaluate.
+  @param x, y, z The point in 24.8 fixed point voxel units.
+  @param color Set to the color of the surface nearest to the point.
+
+  @return Signed distance to the surface in 24.8 fixed point voxel units.
+*/
+int32_t SdfScene::evaluate(int root, int32_t x, int32_t y, int32_t z, CRGB *color) const
+{
+  int32_t d[SDF_MAX_NODES];
+  CRGB c[SDF_MAX_NODES];
+  for(int n = 0; n <= root; n++) {
+    const SdfNode &node = this->nodes[n];
+    const int32_t *p = node.p;
+    switch(node.type) {
+      case SDF_SPHERE:
+        d[n] = length3(x - p[0], y - p[1], z - p[2]) - p[3];
+        c[n] = node.color;
+        break;
+      case SDF_BOX: {
+        int32_t qx = abs(clampDelta(x - p[0])) - p[3];
+        int32_t qy = abs(clampDelta(y - p[1])) - p[4];
+        int32_t qz = abs(clampDelta(z - p[2])) - p[5];
+        int32_t inside = (qx > qy) ? qx : qy;
+        if(qz > inside) inside = qz;
+        d[n] = length3((qx > 0) ? qx : 0, (qy > 0) ? qy : 0, (qz > 0) ? qz : 0) + ((inside < 0) ? inside : 0);
+        c[n] = node.color;
+        break;
+      }
+      case SDF_TORUS:
+        d[n] = length2(length2(x - p[0], y - p[1]) - p[3], z - p[2]) - p[4];
+        c[n] = node.color;
+        break;
+      case SDF_CAPSULE: {
+        int32_t ax = clampDelta(x - p[0]);
+        int32_t ay = clampDelta(y - p[1]);
+        int32_t az = clampDelta(z - p[2]);
+        int64_t dot = (int64_t)ax * p[3] + (int64_t)ay * p[4] + (int64_t)az * p[5];
+        int32_t h = 0;
+        if(dot > 0 && p[7]) {
+          uint64_t t = ((uint64_t)dot * (uint32_t)p[7]) >> 24;
+          h = (t > SDF_ONE) ? SDF_ONE : (int32_t)t;
+        }
+        d[n] = length3(ax - ((p[3] * h) >> 8), ay - ((p[4] * h) >> 8), az - ((p[5] * h) >> 8)) - p[6];
+        c[n] = node.color;
+        break;
+      }
+      case SDF_PLANE:
+        d[n] = ((x * p[0] + y * p[1] + z * p[2]) >> 14) - p[3];
+        c[n] = node.color;
+        break;
+      case SDF_UNION:
+        if(d[node.a] <= d[node.b]) {
+          d[n] = d[node.a];
+          c[n] = c[node.a];
+        } else {
+          d[n] = d[node.b];
+          c[n] = c[node.b];
+        }
+        break;
+      case SDF_INTERSECTION:
+        if(d[node.a] >= d[node.b]) {
+          d[n] = d[node.a];
+          c[n] = c[node.a];
+        } else {
+          d[n] = d[node.b];
+          c[n] = c[node.b];
+        }
+        break;
+      case SDF_DIFFERENCE:
+        d[n] = (d[node.a] >= -d[node.b]) ? d[node.a] : -d[node.b];
+        c[n] = c[node.a];
+        break;
+      case SDF_SMOOTH_UNION: {
+        // polynomial smooth minimum; h goes from 0 where b is much nearer to 1 where a is
+        int32_t da = d[node.a], db = d[node.b];
+        int32_t k = p[0];
+        int32_t diff = db - da;
+        if(diff > k) diff = k;
+        if(diff < -k) diff = -k;
+        int32_t h = 128 + ((diff * p[1]) >> 16);
+        d[n] = db + (((da - db) * h) >> 8) - ((k * h * (SDF_ONE - h)) >> 16);
+        c[n] = blend(c[node.b], c[node.a], (h > 255) ? 255 : h);
+        break;
+      }
+    }
+  }
+  *color = c[root];
+  return d[root];
+}
+
+/** Signed distance from a point to the surface of a node, negative inside.
+
+  @param x, y, z The point.
+  @param root Node to measure, or -1 for the last one added.
+
+  @return Distance in voxels, 0 if the scene is empty.
+*/
+float SdfScene::distance(float x, float y, float z, int root) const
+{
+  if(root < 0)
+    root = this->count - 1;
+  if(root < 0 || root >= this->count)
+    return 0;
+  CRGB color;
+  return this->evaluate(root, toQ8(x), toQ8(y), toQ8(z), &color) / (float)SDF_ONE;
+}
+
+/** Draw a signed distance field scene.
+  Voxels inside the surface are set to its color, voxels within half a voxel of it are blended with
+  what is already there by how much of them it covers, and everything else is left alone.
+  Blocks of 2x2x2 voxels whose center is too far outside the surface to reach any of them are skipped.
+
+  @param scene The scene to draw.
+  @param root Node to draw, or -1 for the last one added.
+*/
+void Cube::draw(SdfScene &scene, int root)
+{
+  if(root < 0)
+    root = scene.count - 1;
+  if(root < 0 || root >= scene.count)
+    return;
+
+  // the distance bound is exact up to the rounding of the fixed point math; allow a little for it
+  const int32_t cull = SDF_ONE / 2 + SDF_BLOCK_REACH + 8;
+  DirtyRegion touched;
+  CRGB color;
+  for(int z0 = 0; z0 < this->size; z0 += 2)
+    for(int x0 = 0; x0 < this->size; x0 += 2)
+      for(int y0 = 0; y0 < this->size; y0 += 2) {
+        if(scene.evaluate(root, x0 * SDF_ONE + SDF_ONE / 2, y0 * SDF_ONE + SDF_ONE / 2, z0 * SDF_ONE + SDF_ONE / 2, &color) >= cull)
+          continue;
+        for(int z = z0; z < z0 + 2 && z < this->size; z++)
+          for(int x = x0; x < x0 + 2 && x < this->size; x++)
+            for(int y = y0; y < y0 + 2 && y < this->size; y++) {
+              // coverage of the voxel, taking the surface as a plane across it
+              int32_t coverage = SDF_ONE / 2 - scene.evaluate(root, x * SDF_ONE, y * SDF_ONE, z * SDF_ONE, &color);
+              if(coverage <= 0)
+                continue;
+              CRGB &voxel = this->leds[index(x, y, z)];
+              if(coverage >= 255)
+                voxel = color;
+              else
+                nblend(voxel, color, coverage);
+              touched.include(x, y, z);
+            }
+      }
+  if(!touched.isEmpty()) {
+    this->dirty->include(touched.x0, touched.y0, touched.z0);
+    this->dirty->include(touched.x1, touched.y1, touched.z1);
+  }
+}
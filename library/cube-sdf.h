@@ -0,0 +1,70 @@
+#ifndef _L3D_SDF_H
+#define _L3D_SDF_H
+
+#include "beta-cube-library-fastled.h"
+
+/**   Largest number of primitives and operations in an SdfScene. */
+#ifndef SDF_MAX_NODES
+#define SDF_MAX_NODES 16
+#endif
+
+/** Node types of an SdfScene. */
+#define SDF_SPHERE 0
+#define SDF_BOX 1
+#define SDF_TORUS 2
+#define SDF_CAPSULE 3
+#define SDF_PLANE 4
+#define SDF_UNION 5
+#define SDF_INTERSECTION 6
+#define SDF_DIFFERENCE 7
+#define SDF_SMOOTH_UNION 8
+
+/**   A primitive or an operation of an SdfScene.
+      Lengths and positions are kept in 24.8 fixed point voxel units, plane normals in 2.14.
+      a and b are the operands of an operation, always nodes added earlier.
+*/
+struct SdfNode {
+  uint8_t type;
+  uint8_t a, b;
+  CRGB color;
+  int32_t p[8];
+};
+
+/**   A shape described by its signed distance field: the distance from any point to its surface,
+      negative inside. Primitives are combined by union, intersection, difference and smooth union,
+      each builder returning the index of the node it added, or -1 if the scene is full or an operand
+      is invalid. Cube::draw evaluates the field in fixed point at every voxel, skipping 2x2x2 blocks
+      that are too far outside the surface to be touched, and blends the edge voxels by how much of them
+      the shape covers, so surfaces move smoothly between voxels.
+      Positions are accurate within 128 voxels of the cube.
+*/
+class SdfScene {
+  friend class Cube;
+
+  private:
+    SdfNode nodes[SDF_MAX_NODES];
+    int count;
+
+    int add(SdfNode &node, uint8_t type, Color col);
+    int operation(uint8_t type, int a, int b);
+    int32_t evaluate(int root, int32_t x, int32_t y, int32_t z, CRGB *color) const;
+
+  public:
+    SdfScene();
+
+    void clear(void);
+    int sphere(float x, float y, float z, float r, Color col);
+    int sphere(Point center, float r, Color col);
+    int box(Point center, Point halfSize, Color col);
+    int torus(Point center, float ringRadius, float tubeRadius, Color col);
+    int capsule(Point a, Point b, float r, Color col);
+    int plane(Point normal, float offset, Color col);
+    int unionOf(int a, int b);
+    int intersectionOf(int a, int b);
+    int differenceOf(int a, int b);
+    int smoothUnionOf(int a, int b, float k);
+    float distance(float x, float y, float z, int root=-1) const;
+    int nodeCount(void) const { return this->count; }
+};
+
+#endif
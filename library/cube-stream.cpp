@@ -0,0 +1,350 @@
+#include <string.h>
+#include "cube-stream.h"
+
+/** Read a packet header.
+
+  @param data The packet.
+  @param length Length of the packet in bytes.
+
+  @return False if the packet is not a streaming packet of a version this code understands.
+*/
+bool StreamHeader::parse(const uint8_t *data, int length)
+{
+  if(length < STREAM_HEADER_SIZE || data[0] != STREAM_MAGIC_0 || data[1] != STREAM_MAGIC_1 || data[2] != STREAM_VERSION)
+    return false;
+  this->version = data[2];
+  this->type = data[3];
+  this->frame = (data[4] << 8) | data[5];
+  this->fragment = data[6];
+  this->fragmentCount = data[7];
+  this->offset = (data[8] << 8) | data[9];
+  return true;
+}
+
+/** Write a packet header.
+
+  @param data Buffer of at least STREAM_HEADER_SIZE bytes.
+*/
+void StreamHeader::write(uint8_t *data) const
+{
+  data[0] = STREAM_MAGIC_0;
+  data[1] = STREAM_MAGIC_1;
+  data[2] = this->version;
+  data[3] = this->type;
+  data[4] = this->frame >> 8;
+  data[5] = this->frame & 0xff;
+  data[6] = this->fragment;
+  data[7] = this->fragmentCount;
+  data[8] = this->offset >> 8;
+  data[9] = this->offset & 0xff;
+}
+
+/** Construct a receiver that accepts any frame id first. */
+StreamReceiver::StreamReceiver()
+{
+  this->reset();
+}
+
+/** Forget the current frame, so the next packet starts a new one whatever its frame id. */
+void StreamReceiver::reset(void)
+{
+  this->frame = 0;
+  this->started = false;
+  this->complete = false;
+  this->synced = false;
+  this->lastComplete = 0;
+  this->fragmentCount = 0;
+  this->receivedCount = 0;
+  memset(this->received, 0, sizeof(this->received));
+  this->lastPacket = 0;
+}
+
+/** Check whether the payload of a packet should be written to the frame buffer.
+
+  @param header Header of the packet.
+  @param payloadLength Number of bytes after the header.
+  @param voxelCount Number of voxels in the frame buffer.
+  @param now Current time in milliseconds.
+
+  @return STREAM_FRAGMENT if the payload belongs to the newest frame and has not been received yet,
+  STREAM_STALE if it belongs to an older frame or is a duplicate, STREAM_INVALID if it is malformed.
+*/
+int StreamReceiver::accept(const StreamHeader &header, int payloadLength, int voxelCount, uint32_t now)
+{
+  if(header.fragmentCount == 0 || header.fragment >= header.fragmentCount)
+    return STREAM_INVALID;
+  if(header.type == STREAM_FRAME) {
+    if(payloadLength <= 0 || payloadLength % 3 || header.offset + payloadLength / 3 > voxelCount)
+      return STREAM_INVALID;
+  } else if(header.type == STREAM_DELTA) {
+    if(payloadLength < 2 || header.offset > voxelCount)
+      return STREAM_INVALID;
+  } else {
+    return STREAM_INVALID;
+  }
+
+  if(this->started && now - this->lastPacket > STREAM_TIMEOUT)
+    this->started = false;
+
+  int16_t age = this->started ? (int16_t)(header.frame - this->frame) : 1;
+  if(age < 0)
+    return STREAM_STALE;
+  if(age > 0) {
+    // a newer frame; whatever is missing from the current one will not be shown
+    this->frame = header.frame;
+    this->started = true;
+    this->complete = false;
+    this->fragmentCount = header.fragmentCount;
+    this->receivedCount = 0;
+    memset(this->received, 0, sizeof(this->received));
+  } else if(header.fragmentCount != this->fragmentCount) {
+    return STREAM_INVALID;
+  }
+
+  uint32_t bit = 1UL << (header.fragment & 31);
+  if(this->complete || (this->received[header.fragment >> 5] & bit))
+    return STREAM_STALE;
+  this->lastPacket = now;
+  return STREAM_FRAGMENT;
+}
+
+/** Apply the payload of an accepted STREAM_DELTA packet to a frame buffer.
+  A malformed payload may have been partly applied when this returns; the frame then never completes,
+  so later deltas are dropped until the next keyframe overwrites the buffer.
+
+  @param header Header of the packet.
+  @param payload The bytes after the header.
+  @param length Number of bytes after the header.
+  @param rgb Frame buffer holding the last completed frame, 3 bytes per voxel.
+  @param voxelCount Number of voxels in the frame buffer.
+
+  @return STREAM_FRAGMENT if the delta was applied, STREAM_STALE if it applies to a frame other than the
+  last completed one, STREAM_INVALID if it is malformed.
+*/
+int StreamReceiver::applyDelta(const StreamHeader &header, const uint8_t *payload, int length, uint8_t *rgb, int voxelCount)
+{
+  uint16_t base = (payload[0] << 8) | payload[1];
+  if(!this->synced || base != this->lastComplete)
+    return STREAM_STALE;
+
+  int voxel = header.offset;
+  for(int i = 2; i < length; ) {
+    if(length - i < 2)
+      return STREAM_INVALID;
+    voxel += payload[i];
+    int count = payload[i + 1];
+    i += 2;
+    if(length - i < 3 * count || voxel + count > voxelCount)
+      return STREAM_INVALID;
+    uint8_t *out = rgb + 3 * voxel;
+    for(int n = 3 * count; n > 0; n--)
+      *out++ ^= payload[i++];
+    voxel += count;
+  }
+  return STREAM_FRAGMENT;
+}
+
+/** Record that the payload of an accepted packet has been written.
+
+  @param header Header of the packet.
+
+  @return STREAM_COMPLETE if this was the last missing fragment of the frame, STREAM_FRAGMENT otherwise.
+*/
+int StreamReceiver::finish(const StreamHeader &header)
+{
+  this->received[header.fragment >> 5] |= 1UL << (header.fragment & 31);
+  if(++this->receivedCount < this->fragmentCount)
+    return STREAM_FRAGMENT;
+  this->complete = true;
+  this->synced = true;
+  this->lastComplete = this->frame;
+  return STREAM_COMPLETE;
+}
+
+/** Receive a whole packet into a frame buffer.
+
+  @param packet The packet.
+  @param length Length of the packet in bytes.
+  @param rgb Frame buffer, 3 bytes per voxel.
+  @param voxelCount Number of voxels in the frame buffer.
+  @param now Current time in milliseconds.
+
+  @return One of STREAM_COMPLETE, STREAM_FRAGMENT, STREAM_STALE or STREAM_INVALID.
+*/
+int StreamReceiver::receive(const uint8_t *packet, int length, uint8_t *rgb, int voxelCount, uint32_t now)
+{
+  StreamHeader header;
+  if(!header.parse(packet, length))
+    return STREAM_INVALID;
+  int result = this->accept(header, length - STREAM_HEADER_SIZE, voxelCount, now);
+  if(result != STREAM_FRAGMENT)
+    return result;
+  if(header.type == STREAM_DELTA) {
+    result = this->applyDelta(header, packet + STREAM_HEADER_SIZE, length - STREAM_HEADER_SIZE, rgb, voxelCount);
+    if(result != STREAM_FRAGMENT)
+      return result;
+  } else {
+    memcpy(rgb + 3 * header.offset, packet + STREAM_HEADER_SIZE, length - STREAM_HEADER_SIZE);
+  }
+  return this->finish(header);
+}
+
+/** Construct an encoder.
+
+  @param previous Buffer of 3 * voxelCount bytes the encoder keeps the last frame it sent in.
+  @param voxelCount Number of voxels in a frame.
+  @param keyframeInterval Largest number of frames between keyframes.
+*/
+StreamEncoder::StreamEncoder(uint8_t *previous, int voxelCount, int keyframeInterval) :
+  previous(previous),
+  voxelCount(voxelCount),
+  keyframeInterval(keyframeInterval),
+  sinceKeyframe(0),
+  frame(0),
+  keyframeRequested(true)
+{ }
+
+/** Make the next frame a keyframe, e.g. when a receiver has just joined. */
+void StreamEncoder::requestKeyframe(void)
+{
+  this->keyframeRequested = true;
+}
+
+/** Encode a frame and pass its packets to a callback.
+
+  @param rgb The frame, 3 bytes per voxel in voxel index order.
+  @param send Called with each packet.
+  @param context Passed on to send.
+
+  @return Number of bytes in all packets of the frame.
+*/
+int StreamEncoder::encode(const uint8_t *rgb, void (*send)(const uint8_t *packet, int length, void *context), void *context)
+{
+  int bytes = 0;
+  if(!this->keyframeRequested && this->sinceKeyframe + 1 < this->keyframeInterval) {
+    // count what the delta would take first, fragment headers need the number of fragments
+    int fragments = this->encodeDelta(rgb, 0, &bytes, NULL, NULL);
+    if(fragments <= 255 && bytes < 3 * this->voxelCount) {
+      this->encodeDelta(rgb, fragments, &bytes, send, context);
+      this->sinceKeyframe++;
+    } else {
+      bytes = 0;
+    }
+  }
+  if(!bytes) {
+    bytes = this->encodeKeyframe(rgb, send, context);
+    this->sinceKeyframe = 0;
+    this->keyframeRequested = false;
+  }
+  memcpy(this->previous, rgb, 3 * this->voxelCount);
+  this->frame++;
+  return bytes;
+}
+
+/** Split a frame into STREAM_FRAME packets.
+
+  @return Number of bytes in all packets.
+*/
+int StreamEncoder::encodeKeyframe(const uint8_t *rgb, void (*send)(const uint8_t *packet, int length, void *context), void *context)
+{
+  const int perFragment = (STREAM_MAX_PACKET - STREAM_HEADER_SIZE) / 3;
+  uint8_t packet[STREAM_MAX_PACKET];
+  StreamHeader header;
+  header.frame = this->frame;
+  header.fragmentCount = (this->voxelCount + perFragment - 1) / perFragment;
+  int bytes = 0;
+  for(int f = 0; f < header.fragmentCount; f++) {
+    header.fragment = f;
+    header.offset = f * perFragment;
+    int count = (this->voxelCount - header.offset < perFragment) ? this->voxelCount - header.offset : perFragment;
+    header.write(packet);
+    memcpy(packet + STREAM_HEADER_SIZE, rgb + 3 * header.offset, 3 * count);
+    int length = STREAM_HEADER_SIZE + 3 * count;
+    if(send)
+      send(packet, length, context);
+    bytes += length;
+  }
+  return bytes;
+}
+
+/** Encode the changes from the previous frame as STREAM_DELTA packets.
+
+  @param fragmentCount Number of fragments to write into the headers.
+  @param bytes Set to the number of bytes in all packets.
+  @param send Called with each packet, or NULL to only count fragments and bytes.
+
+  @return Number of fragments.
+*/
+int StreamEncoder::encodeDelta(const uint8_t *rgb, uint8_t fragmentCount, int *bytes,
+    void (*send)(const uint8_t *packet, int length, void *context), void *context)
+{
+  const uint8_t *previous = this->previous;
+  const int n = this->voxelCount;
+  uint8_t packet[STREAM_MAX_PACKET];
+  StreamHeader header;
+  header.type = STREAM_DELTA;
+  header.frame = this->frame;
+  header.fragmentCount = fragmentCount;
+  uint16_t base = this->frame - 1;
+
+  int fragments = 0;
+  int length = 0;   // bytes in the open fragment, 0 if there is none
+  int voxel = 0;    // where the runs of the open fragment have got to
+  int i = 0;
+  *bytes = 0;
+  while(true) {
+    while(i < n && !memcmp(rgb + 3 * i, previous + 3 * i, 3))
+      i++;
+    bool last = (i == n);
+    int count = 0;
+    while(i + count < n && count < 255 && memcmp(rgb + 3 * (i + count), previous + 3 * (i + count), 3))
+      count++;
+
+    // a long gap or a full packet is cheaper to cross by starting a new fragment
+    int skip = i - voxel;
+    if(length && (last || skip >= 4 * 255 || length + 2 * (skip / 255) + 5 > STREAM_MAX_PACKET)) {
+      header.fragment = fragments++;
+      header.write(packet);
+      if(send)
+        send(packet, length, context);
+      *bytes += length;
+      length = 0;
+    }
+    if(last)
+      break;
+    if(!length) {
+      header.offset = i;
+      voxel = i;
+      packet[STREAM_HEADER_SIZE] = base >> 8;
+      packet[STREAM_HEADER_SIZE + 1] = base & 0xff;
+      length = STREAM_HEADER_SIZE + 2;
+    }
+    for(; i - voxel >= 255; voxel += 255) {
+      packet[length++] = 255;
+      packet[length++] = 0;
+    }
+    int room = (STREAM_MAX_PACKET - length - 2) / 3;
+    if(count > room)
+      count = room;
+    packet[length++] = i - voxel;
+    packet[length++] = count;
+    for(int b = 3 * i; b < 3 * (i + count); b++)
+      packet[length++] = rgb[b] ^ previous[b];
+    i += count;
+    voxel = i;
+  }
+
+  if(!fragments) {
+    // nothing changed, still send the frame so the receiver moves on to it
+    header.fragment = fragments++;
+    header.offset = 0;
+    header.write(packet);
+    packet[STREAM_HEADER_SIZE] = base >> 8;
+    packet[STREAM_HEADER_SIZE + 1] = base & 0xff;
+    length = STREAM_HEADER_SIZE + 2;
+    if(send)
+      send(packet, length, context);
+    *bytes += length;
+  }
+  return fragments;
+}
@@ -0,0 +1,122 @@
+#ifndef _L3D_STREAM_H
+#define _L3D_STREAM_H
+
+#include <stdint.h>
+
+/**   Streaming protocol, version 1.
+      Every datagram starts with a 10 byte header, multi byte fields in network byte order:
+
+        0  'L'
+        1  '3'
+        2  version (STREAM_VERSION)
+        3  packet type (STREAM_FRAME or STREAM_DELTA)
+        4  frame id, high byte
+        5  frame id, low byte
+        6  fragment index
+        7  number of fragments in the frame
+        8  first voxel, high byte
+        9  first voxel, low byte
+
+      A STREAM_FRAME payload is 3 bytes of red, green, blue per voxel, starting at the first voxel
+      and in the cube's voxel order (see VoxelGrid::index: slab by slab along z, row by row along x,
+      y varying fastest). A frame may be split into up to 255 fragments, so frames bigger than one
+      datagram (8x8x8 cubes and up) span several. Frame ids count up and wrap at 65536; fragments of
+      a frame older than the newest one seen are dropped.
+
+      A STREAM_DELTA payload changes the previous frame in place. It starts with the 2 byte id of the
+      frame it applies to, followed by runs of two bytes, the number of voxels to leave unchanged and
+      the number of voxels that change, then 3 bytes per changed voxel that are XORed into it. Runs
+      start at the first voxel of the header. A delta is dropped unless the frame it applies to was the
+      last one completed, so after a lost packet the cube waits for the next STREAM_FRAME, which the
+      sender sends every so often as a keyframe.
+
+      This file does not depend on FastLED or the Particle firmware, so host tools can share it.
+*/
+#define STREAM_MAGIC_0 'L'
+#define STREAM_MAGIC_1 '3'
+#define STREAM_VERSION 1
+#define STREAM_HEADER_SIZE 10
+
+/** Packet types. */
+#define STREAM_FRAME 0
+#define STREAM_DELTA 1
+
+/** Largest datagram the cube reads; fragments carry at most 167 voxels. */
+#define STREAM_MAX_PACKET 512
+
+/** Results of receiving a packet. */
+#define STREAM_INVALID -1
+#define STREAM_STALE 0
+#define STREAM_FRAGMENT 1
+#define STREAM_COMPLETE 2
+
+/** Milliseconds without a valid packet after which any frame id is accepted again, so a restarted
+    sender is not ignored until its frame ids catch up. */
+#define STREAM_TIMEOUT 1000
+
+/**   The header of a streaming packet. */
+struct StreamHeader {
+  uint8_t version;
+  uint8_t type;
+  uint16_t frame;
+  uint8_t fragment;
+  uint8_t fragmentCount;
+  uint16_t offset;
+
+  StreamHeader() : version(STREAM_VERSION), type(STREAM_FRAME), frame(0), fragment(0), fragmentCount(1), offset(0) {}
+
+  bool parse(const uint8_t *data, int length);
+  void write(uint8_t *data) const;
+};
+
+/**   Reassembles frames from streaming packets and drops stale ones.
+      Payloads are copied straight into an RGB buffer (3 bytes per voxel, the layout of CRGB).
+*/
+class StreamReceiver {
+  private:
+    uint16_t frame;
+    bool started;
+    bool complete;
+    bool synced;
+    uint16_t lastComplete;
+    uint8_t fragmentCount;
+    uint8_t receivedCount;
+    uint32_t received[8];
+    uint32_t lastPacket;
+
+  public:
+    StreamReceiver();
+
+    int accept(const StreamHeader &header, int payloadLength, int voxelCount, uint32_t now);
+    int applyDelta(const StreamHeader &header, const uint8_t *payload, int length, uint8_t *rgb, int voxelCount);
+    int finish(const StreamHeader &header);
+    int receive(const uint8_t *packet, int length, uint8_t *rgb, int voxelCount, uint32_t now);
+    void reset(void);
+};
+
+/**   Encodes frames into streaming packets, as deltas against the previous frame where that is
+      smaller, with a keyframe at least every keyframeInterval frames.
+*/
+class StreamEncoder {
+  private:
+    uint8_t *previous;
+    int voxelCount;
+    int keyframeInterval;
+    int sinceKeyframe;
+    uint16_t frame;
+    bool keyframeRequested;
+
+    int encodeDelta(const uint8_t *rgb, uint8_t fragmentCount, int *bytes,
+        void (*send)(const uint8_t *packet, int length, void *context), void *context);
+    int encodeKeyframe(const uint8_t *rgb,
+        void (*send)(const uint8_t *packet, int length, void *context), void *context);
+
+  public:
+    StreamEncoder(uint8_t *previous, int voxelCount, int keyframeInterval=30);
+
+    int encode(const uint8_t *rgb, void (*send)(const uint8_t *packet, int length, void *context), void *context);
+    void requestKeyframe(void);
+    uint16_t nextFrame(void) const { return this->frame; }
+};
+
+#endif
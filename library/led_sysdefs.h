@@ -14,6 +14,9 @@
 #include "platforms/arm/sam/led_sysdefs_arm_sam.h"
 #elif defined(STM32F10X_MD) || defined(STM32F2XX)
 #include "led_sysdefs_arm_stm32.h"
+#elif defined(FASTLED_HOST) || defined(__x86_64__)
+// Desktop build, see platforms/host
+#include "platforms/host/led_sysdefs_host.h"
 #else
 // AVR platforms
 #include "platforms/avr/led_sysdefs_avr.h"
@@ -760,4 +760,184 @@ void fill_2dnoise16(CRGB *leds, int width, int height, bool serpentine,
   }
 }
 
+// Row helper for the 3d fills.  Along a row of points at the same y and z, the gradient of every
+// corner of a lattice cell is a linear function of x, and blending the four corners on each side
+// of the cell along y and z, with weights that are fixed for the whole row, gives another.  So each
+// time the row enters a cell, the hashes of its corners are looked up and the two functions worked
+// out once; each point then costs two multiply-adds, the fade of its x and one blend along x.  The
+// blends are the ones inoise16_raw does, in another order and with more precision, so the values
+// match inoise16 to within a few counts.
+
+// The gradient of a corner as kx*x + c, at twice the value grad16 gives, for fixed y and z.
+static void inline __attribute__((always_inline)) grad16_row(uint8_t hash, int32_t y, int32_t z, int32_t &kx, int32_t &c) {
+  hash = hash&15;
+  int32_t sign_u = (hash&1) ? -1 : 1;
+  int32_t sign_v = (hash&2) ? -1 : 1;
+  kx = 0; c = 0;
+  if(hash<8) { kx += sign_u; } else { c += sign_u * y; }
+  if(hash<4) { c += sign_v * y; }
+  else if(hash==12||hash==14) { kx += sign_v; }
+  else { c += sign_v * z; }
+}
+
+static void inoise16_raw_row3d(int16_t *out, int count, uint32_t x, int scalex, uint32_t y, uint32_t z)
+{
+  uint8_t Y = (y>>16)&0xFF;
+  uint8_t Z = (z>>16)&0xFF;
+  uint16_t v = y & 0xFFFF;
+  uint16_t w = z & 0xFFFF;
+  int32_t yy = (v >> 1) & 0x7FFF;
+  int32_t zz = (w >> 1) & 0x7FFF;
+  const int32_t N = 0x8000L;
+  v = FADE(v); w = FADE(w);
+
+  // weights of the four corners on each side of the cell along y and z, in 0.32 fixed point
+  int64_t weight[4] = {
+    (int64_t)(65536 - v) * (65536 - w), (int64_t)v * (65536 - w),
+    (int64_t)(65536 - v) * w, (int64_t)v * w
+  };
+  int32_t cy[4] = { yy, yy - N, yy, yy - N };
+  int32_t cz[4] = { zz, zz, zz - N, zz - N };
+
+  // the near and far sides of the current cell along x: slope in 16.16, offset
+  int32_t slopeA = 0, offsetA = 0, slopeB = 0, offsetB = 0;
+  int lastX = -1;
+  for(int i = 0; i < count; i++, x += scalex) {
+    uint8_t X = (x>>16)&0xFF;
+    if(X != lastX) {
+      uint8_t A = P(X)+Y;
+      uint8_t AA = P(A)+Z;
+      uint8_t AB = P(A+1)+Z;
+      uint8_t B = P(X+1)+Y;
+      uint8_t BA = P(B) + Z;
+      uint8_t BB = P(B+1)+Z;
+      uint8_t near[4] = { P(AA), P(AB), P(AA+1), P(AB+1) };
+      uint8_t far[4] = { P(BA), P(BB), P(BA+1), P(BB+1) };
+      int64_t sa = 0, oa = 0, sb = 0, ob = 0;
+      for(int c = 0; c < 4; c++) {
+        int32_t kx, k;
+        grad16_row(near[c], cy[c], cz[c], kx, k);
+        sa += weight[c] * kx; oa += weight[c] * k;
+        grad16_row(far[c], cy[c], cz[c], kx, k);
+        sb += weight[c] * kx; ob += weight[c] * k;
+      }
+      slopeA = sa >> 16; offsetA = oa >> 32;
+      slopeB = sb >> 16; offsetB = ob >> 32;
+      lastX = X;
+    }
+    uint16_t u = x & 0xFFFF;
+    int32_t xx = (u >> 1) & 0x7FFF;
+    u = FADE(u);
+
+    int32_t a = (int32_t)(((int64_t)slopeA * xx) >> 16) + offsetA;
+    int32_t b = (int32_t)(((int64_t)slopeB * (xx - N)) >> 16) + offsetB;
+    out[i] = (a + (int32_t)(((int64_t)(b - a) * u) >> 16)) >> 1;
+  }
+}
+
+// The octaves of one row of a 3d fill.  Octave o samples at 2^o times the coordinates and
+// adds in at 1/2^o of the amplitude.  time is added to z unscaled at every octave, so the
+// finer octaves drift more slowly than the coarse ones and the volume changes shape over
+// time instead of only scrolling along z.  The 8-bit fills use the 16-bit row helper with
+// their coordinates widened, and scale the result like inoise8.
+// inoise16's scaling of a raw value into 0-65535.
+static uint16_t inline __attribute__((always_inline)) scale_noise16(int16_t raw) {
+  uint32_t pan = (int32_t)raw + 19052L;
+  return (pan*220L)>>7;
+}
+
+static void fill_raw_3dnoise8_row(uint8_t *pRow, int width, uint8_t octaves, uint16_t x, int scalex, uint16_t y, uint16_t z, uint16_t time) {
+  int16_t noise[width];
+  for(int o = 0; o < octaves; o++) {
+    inoise16_raw_row3d(noise, width, (uint32_t)(uint16_t)(x<<o) << 8, scalex << (o+8),
+                       (uint32_t)(uint16_t)(y<<o) << 8, (uint32_t)(uint16_t)((z<<o) + time) << 8);
+    for(int i = 0; i < width; i++) {
+      int16_t n = 76 + (noise[i] >> 8);
+      n = (n < 0) ? 0 : (n > 255) ? 255 : n;
+      pRow[i] = qadd8(pRow[i], (scale8(n,215)<<1)>>o);
+    }
+  }
+}
+
+static void fill_raw_3dnoise16_row(uint16_t *pRow, int width, uint8_t octaves, uint32_t x, int scalex, uint32_t y, uint32_t z, uint32_t time) {
+  int16_t noise[width];
+  for(int o = 0; o < octaves; o++) {
+    inoise16_raw_row3d(noise, width, x<<o, scalex<<o, y<<o, (z<<o) + time);
+    for(int i = 0; i < width; i++) {
+      uint32_t accum = pRow[i] + (scale_noise16(noise[i])>>o);
+      pRow[i] = (accum > 65535) ? 65535 : accum;
+    }
+  }
+}
+
+static void fill_raw_3dnoise16into8_row(uint8_t *pRow, int width, uint8_t octaves, uint32_t x, int scalex, uint32_t y, uint32_t z, uint32_t time) {
+  int16_t noise[width];
+  for(int o = 0; o < octaves; o++) {
+    inoise16_raw_row3d(noise, width, x<<o, scalex<<o, y<<o, (z<<o) + time);
+    for(int i = 0; i < width; i++) {
+      uint32_t accum = (scale_noise16(noise[i])>>o) + (pRow[i]<<8);
+      if(accum > 65535) { accum = 65535; }
+      pRow[i] = accum>>8;
+    }
+  }
+}
+
+void fill_raw_3dnoise8(uint8_t *pData, int width, int height, int depth, uint8_t octaves, uint16_t x, int scalex, uint16_t y, int scaley, uint16_t z, int scalez, uint16_t time) {
+  for(int k = 0; k < depth; k++, z+=scalez) {
+    uint16_t yy = y;
+    for(int j = 0; j < height; j++, yy+=scaley) {
+      fill_raw_3dnoise8_row(pData + (k*height + j)*width, width, octaves, x, scalex, yy, z, time);
+    }
+  }
+}
+
+void fill_raw_3dnoise16(uint16_t *pData, int width, int height, int depth, uint8_t octaves, uint32_t x, int scalex, uint32_t y, int scaley, uint32_t z, int scalez, uint32_t time) {
+  for(int k = 0; k < depth; k++, z+=scalez) {
+    uint32_t yy = y;
+    for(int j = 0; j < height; j++, yy+=scaley) {
+      fill_raw_3dnoise16_row(pData + (k*height + j)*width, width, octaves, x, scalex, yy, z, time);
+    }
+  }
+}
+
+void fill_raw_3dnoise16into8(uint8_t *pData, int width, int height, int depth, uint8_t octaves, uint32_t x, int scalex, uint32_t y, int scaley, uint32_t z, int scalez, uint32_t time) {
+  for(int k = 0; k < depth; k++, z+=scalez) {
+    uint32_t yy = y;
+    for(int j = 0; j < height; j++, yy+=scaley) {
+      fill_raw_3dnoise16into8_row(pData + (k*height + j)*width, width, octaves, x, scalex, yy, z, time);
+    }
+  }
+}
+
+void fill_3dnoise16(CRGB *leds, int width, int height, int depth,
+            uint8_t octaves, uint32_t x, int xscale, uint32_t y, int yscale, uint32_t z, int zscale, uint32_t time,
+            uint8_t hue_octaves, uint16_t hue_x, int hue_xscale, uint16_t hue_y, int hue_yscale, uint16_t hue_z, int hue_zscale, uint16_t hue_time,
+            bool blend, uint16_t hue_shift) {
+  // a row at a time, so that only two rows of values are ever on the stack
+  uint8_t V[width];
+  uint8_t H[width];
+  hue_shift >>= 8;
+
+  for(int k = 0; k < depth; k++, z+=zscale, hue_z+=hue_zscale) {
+    uint32_t yy = y;
+    uint16_t hue_yy = hue_y;
+    for(int j = 0; j < height; j++, yy+=yscale, hue_yy+=hue_yscale) {
+      memset(V,0,width);
+      memset(H,0,width);
+      fill_raw_3dnoise16into8_row(V, width, octaves, x, xscale, yy, z, time);
+      fill_raw_3dnoise8_row(H, width, hue_octaves, hue_x, hue_xscale, hue_yy, hue_z, hue_time);
+
+      CRGB *pRow = leds + (k*height + j)*width;
+      for(int i = 0; i < width; i++) {
+        CRGB led(CHSV(hue_shift + H[i],255,V[i]));
+        if(blend) {
+          pRow[i] >>= 1; pRow[i] += (led>>=1);
+        } else {
+          pRow[i] = led;
+        }
+      }
+    }
+  }
+}
+
 FASTLED_NAMESPACE_END
@@ -99,6 +99,19 @@ void fill_raw_2dnoise16into8(uint8_t *pData, int width, int height, uint8_t octa
 void fill_raw_2dnoise16(uint16_t *pData, int width, int height, uint8_t octaves, q88 freq88, fract16 amplitude, int skip, uint32_t x, int scalex, uint32_t y, int scaley, uint32_t time);
 void fill_raw_2dnoise16into8(uint8_t *pData, int width, int height, uint8_t octaves, q44 freq44, fract8 amplitude, int skip, uint32_t x, int scalex, uint32_t y, int scaley, uint32_t time);
 
+// Raw noise fill functions for volumes - fill into a 3d array of values, pData[(k*height + j)*width + i]
+// getting the noise at (x + i*scalex, y + j*scaley, z + k*scalez).  Octave o samples at 2^o times the
+// coordinates and adds in at 1/2^o of the amplitude; time moves along z by the same amount at every
+// octave, so the volume changes shape as it moves.  Values are added into pData, saturating, so clear it
+// first.  The lattice cell, its fade and the hashes of its corners are shared by the neighbouring points
+// of each row, so a fill costs about a third of calling inoise16 for every point.  Values match inoise16
+// to within a few counts, and inoise8 to within a few more, as the blends are done in another order.
+// The 8-bit fill is computed in 16 bits and scaled like inoise8.  To fill a Cube,
+// whose voxels are stored y fastest, then x, then z, pass y's origin and scale first.
+void fill_raw_3dnoise8(uint8_t *pData, int width, int height, int depth, uint8_t octaves, uint16_t x, int scalex, uint16_t y, int scaley, uint16_t z, int scalez, uint16_t time);
+void fill_raw_3dnoise16(uint16_t *pData, int width, int height, int depth, uint8_t octaves, uint32_t x, int scalex, uint32_t y, int scaley, uint32_t z, int scalez, uint32_t time);
+void fill_raw_3dnoise16into8(uint8_t *pData, int width, int height, int depth, uint8_t octaves, uint32_t x, int scalex, uint32_t y, int scaley, uint32_t z, int scalez, uint32_t time);
+
 // fill functions to fill leds with values based on noise functions.  These functions use the fill_raw_* functions as appropriate.
 void fill_noise8(CRGB *leds, int num_leds,
             uint8_t octaves, uint16_t x, int scale,
@@ -115,6 +128,13 @@ void fill_2dnoise16(CRGB *leds, int width, int height, bool serpentine,
             uint8_t octaves, uint32_t x, int xscale, uint32_t y, int yscale, uint32_t time,
             uint8_t hue_octaves, uint16_t hue_x, int hue_xscale, uint16_t hue_y, uint16_t hue_yscale,uint16_t hue_time, bool blend, uint16_t hue_shift=0);
 
+// fill a volume of leds, stored like the raw 3d fills above, with 16-bit noise for brightness and 8-bit
+// noise for hue.  Only one row of values is kept at a time, so this needs no large buffers.
+void fill_3dnoise16(CRGB *leds, int width, int height, int depth,
+            uint8_t octaves, uint32_t x, int xscale, uint32_t y, int yscale, uint32_t z, int zscale, uint32_t time,
+            uint8_t hue_octaves, uint16_t hue_x, int hue_xscale, uint16_t hue_y, int hue_yscale, uint16_t hue_z, int hue_zscale, uint16_t hue_time,
+            bool blend, uint16_t hue_shift=0);
+
 FASTLED_NAMESPACE_END
 
 #endif
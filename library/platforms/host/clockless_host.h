@@ -0,0 +1,37 @@
+#ifndef __INC_CLOCKLESS_HOST_H
+#define __INC_CLOCKLESS_HOST_H
+
+FASTLED_NAMESPACE_BEGIN
+// Definition for a single channel clockless controller on the host.  Frames are captured in memory by
+// CMemoryController, and the virtual clock is moved forward by the time the real chipset would have
+// needed to clock the data out, so that frame pacing on the host matches the device.
+
+#define FASTLED_HAS_CLOCKLESS 1
+
+template <int DATA_PIN, int T1, int T2, int T3, EOrder RGB_ORDER = RGB, int XTRA0 = 0, bool FLIP = false, int WAIT_TIME = 50>
+class ClocklessController : public CMemoryController<RGB_ORDER> {
+	typedef CMemoryController<RGB_ORDER> base;
+
+	void wireTime(int nLeds) {
+		// 24 bits per led at T1+T2+T3 clocks each, plus the latch time
+		advanceMicros((uint32_t)(((uint64_t)nLeds * 24 * (T1 + T2 + T3)) / (F_CPU / 1000000L)) + WAIT_TIME);
+	}
+
+public:
+	virtual void init() { FastPin<DATA_PIN>::setOutput(); }
+
+protected:
+	virtual void showColor(const struct CRGB & rgbdata, int nLeds, CRGB scale) {
+		base::showColor(rgbdata, nLeds, scale);
+		wireTime(nLeds);
+	}
+
+	virtual void show(const struct CRGB *rgbdata, int nLeds, CRGB scale) {
+		base::show(rgbdata, nLeds, scale);
+		wireTime(nLeds);
+	}
+};
+
+FASTLED_NAMESPACE_END
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef __INC_FASTLED_HOST_H
+#define __INC_FASTLED_HOST_H
+
+// Include the host headers
+#include "delay.h"
+#include "platforms/host/fastpin_host.h"
+#include "platforms/host/memory_controller.h"
+#include "platforms/host/clockless_host.h"
+
+#endif
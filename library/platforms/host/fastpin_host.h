@@ -0,0 +1,56 @@
+#ifndef __INC_FASTPIN_HOST_H
+#define __INC_FASTPIN_HOST_H
+
+FASTLED_NAMESPACE_BEGIN
+
+/// Pin definition for the host build.  Every pin is backed by a plain memory word, so that
+/// code which toggles pins compiles and runs, but nothing ever leaves the process.
+template<uint8_t PIN> class _HOSTPIN {
+public:
+  typedef volatile uint32_t * port_ptr_t;
+  typedef uint32_t port_t;
+
+  static port_t sPort;
+
+  inline static void setOutput() { pinMode(PIN, OUTPUT); }
+  inline static void setInput() { pinMode(PIN, INPUT); }
+
+  inline static void hi() __attribute__ ((always_inline)) { sPort = 1; }
+  inline static void lo() __attribute__ ((always_inline)) { sPort = 0; }
+  inline static void set(register port_t val) __attribute__ ((always_inline)) { sPort = val; }
+
+  inline static void strobe() __attribute__ ((always_inline)) { toggle(); toggle(); }
+
+  inline static void toggle() __attribute__ ((always_inline)) { sPort ^= 1; }
+
+  inline static void hi(register port_ptr_t port) __attribute__ ((always_inline)) { hi(); }
+  inline static void lo(register port_ptr_t port) __attribute__ ((always_inline)) { lo(); }
+  inline static void fastset(register port_ptr_t port, register port_t val) __attribute__ ((always_inline)) { *port = val; }
+
+  inline static port_t hival() __attribute__ ((always_inline)) { return 1; }
+  inline static port_t loval() __attribute__ ((always_inline)) { return 0; }
+  inline static port_ptr_t port() __attribute__ ((always_inline)) { return &sPort; }
+  inline static port_ptr_t sport() __attribute__ ((always_inline)) { return &sPort; }
+  inline static port_ptr_t cport() __attribute__ ((always_inline)) { return &sPort; }
+  inline static port_t mask() __attribute__ ((always_inline)) { return 1; }
+};
+
+template<uint8_t PIN> typename _HOSTPIN<PIN>::port_t _HOSTPIN<PIN>::sPort = 0;
+
+#define _DEFPIN_HOST(PIN) template<> class FastPin<PIN> : public _HOSTPIN<PIN> {};
+
+// Actual pin definitions, enough to cover the photon's D, A and analog input numbering
+_DEFPIN_HOST(0); _DEFPIN_HOST(1); _DEFPIN_HOST(2); _DEFPIN_HOST(3);
+_DEFPIN_HOST(4); _DEFPIN_HOST(5); _DEFPIN_HOST(6); _DEFPIN_HOST(7);
+_DEFPIN_HOST(8); _DEFPIN_HOST(9); _DEFPIN_HOST(10); _DEFPIN_HOST(11);
+_DEFPIN_HOST(12); _DEFPIN_HOST(13); _DEFPIN_HOST(14); _DEFPIN_HOST(15);
+_DEFPIN_HOST(16); _DEFPIN_HOST(17); _DEFPIN_HOST(18); _DEFPIN_HOST(19);
+
+#define SPI_DATA 15
+#define SPI_CLOCK 13
+
+#define HAS_HARDWARE_PIN_SUPPORT
+
+FASTLED_NAMESPACE_END
+
+#endif
@@ -0,0 +1,66 @@
+#if (defined(FASTLED_HOST) || defined(__x86_64__)) && !defined(FASTLED_HOST_NO_MAIN)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "FastLED.h"
+
+FASTLED_USING_NAMESPACE
+
+// Entry point for running a sketch headless on the host:
+//
+//   sketch [iterations] [frames.bin]
+//
+// runs setup() once, then loop() for the given number of iterations (default 1000), and prints the number
+// of frames shown, a hash of all of their wire bytes, the virtual time the sketch saw pass and the real time
+// it took.  The hash makes a quick regression check between two builds; the optional file receives the wire
+// bytes of every frame for a closer look.  Define FASTLED_HOST_NO_MAIN to supply a main() of your own.
+extern void setup();
+extern void loop();
+
+static uint64_t sHash = 1469598103934665603ULL;
+static FILE *sDump = NULL;
+
+static void captureFrame(const uint8_t *data, int nLeds, uint32_t) {
+	// FNV-1a
+	for(int i = 0; i < nLeds * 3; i++) {
+		sHash = (sHash ^ data[i]) * 1099511628211ULL;
+	}
+	if(sDump) { fwrite(data, 3, nLeds, sDump); }
+}
+
+static void attachCapture() {
+	for(int i = 0; i < FastLED.count(); i++) {
+		CMemoryCapture *capture = dynamic_cast<CMemoryCapture*>(&FastLED[i]);
+		if(capture) { capture->setFrameCallback(captureFrame); }
+	}
+}
+
+int main(int argc, char **argv) {
+	long iterations = (argc > 1) ? atol(argv[1]) : 1000;
+	if(argc > 2 && !(sDump = fopen(argv[2], "wb"))) {
+		perror(argv[2]);
+		return 1;
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	setup();
+	attachCapture();
+	for(long i = 0; i < iterations; i++) {
+		loop();
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	uint32_t frames = 0;
+	for(int i = 0; i < FastLED.count(); i++) {
+		CMemoryCapture *capture = dynamic_cast<CMemoryCapture*>(&FastLED[i]);
+		if(capture) { frames += capture->frameCount(); }
+	}
+	printf("frames=%u hash=%016llx virtual_ms=%u wall_ms=%.1f\n", frames, (unsigned long long)sHash, millis(),
+		(end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+	if(sDump) { fclose(sDump); }
+	return 0;
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef __INC_LED_SYSDEFS_HOST_H
+#define __INC_LED_SYSDEFS_HOST_H
+
+// Host (x86-64 desktop) build of the library.  There is no LED hardware here, the
+// clockless controllers capture frames into memory and the Particle firmware API is
+// provided by a small simulation shim with a virtual clock.
+#include <string.h>
+#include "platforms/host/particle_host.h"
+
+#define FASTLED_NAMESPACE_BEGIN namespace NSFastLED {
+#define FASTLED_NAMESPACE_END }
+#define FASTLED_USING_NAMESPACE using namespace NSFastLED;
+
+#define FASTLED_HOST_PLATFORM
+
+#ifndef INTERRUPT_THRESHOLD
+#define INTERRUPT_THRESHOLD 1
+#endif
+
+// Nothing can interrupt a memory copy
+#ifndef FASTLED_ALLOW_INTERRUPTS
+#define FASTLED_ALLOW_INTERRUPTS 0
+#endif
+
+#define cli()
+#define sei()
+
+// pgmspace definitions
+#define PROGMEM
+// unsigned long is 8 bytes here, so read exactly the 4 bytes of a table entry
+#define pgm_read_dword(addr) ({ uint32_t _v; memcpy(&_v, (addr), 4); _v; })
+#define pgm_read_dword_near(addr) pgm_read_dword(addr)
+
+// data type defs
+typedef volatile       uint8_t RoReg; /**< Read only 8-bit register (volatile const unsigned int) */
+typedef volatile       uint8_t RwReg; /**< Read-Write 8-bit register (volatile unsigned int) */
+
+#define FASTLED_NO_PINMAP
+
+// Pretend to be a photon so that chipset timings come out the same as on the device
+#define F_CPU 120000000
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef __INC_MEMORY_CONTROLLER_H
+#define __INC_MEMORY_CONTROLLER_H
+
+#include <stdlib.h>
+
+FASTLED_NAMESPACE_BEGIN
+
+/// Ring of the last frames a controller has shown, as the bytes that would have gone out on the wire.
+class CMemoryCapture {
+	uint8_t *mFrames;
+	int mDepth;
+	int mCapacity;
+	uint32_t mFrameCount;
+	void (*mCallback)(const uint8_t *data, int nLeds, uint32_t frame);
+
+protected:
+	/// Space for the next frame, 3 bytes per led
+	uint8_t *beginFrame(int nLeds) {
+		if(nLeds > mCapacity) {
+			mFrames = (uint8_t*)realloc(mFrames, nLeds * 3 * mDepth);
+			memset(mFrames, 0, nLeds * 3 * mDepth);
+			mCapacity = nLeds;
+		}
+		return mFrames + (mFrameCount % mDepth) * mCapacity * 3;
+	}
+
+	void endFrame(int nLeds) {
+		if(mCallback) { mCallback(mFrames + (mFrameCount % mDepth) * mCapacity * 3, nLeds, mFrameCount); }
+		mFrameCount++;
+	}
+
+public:
+	CMemoryCapture(int depth) : mFrames(NULL), mDepth(depth), mCapacity(0), mFrameCount(0), mCallback(NULL) {}
+	virtual ~CMemoryCapture() { free(mFrames); }
+
+	/// Number of frames shown since startup
+	uint32_t frameCount() const { return mFrameCount; }
+
+	/// Wire bytes of a captured frame, 3 bytes per led.
+	/// @param ago 0 for the most recent frame, up to the depth of the ring - 1 for older ones
+	/// @returns NULL if that frame has not been shown yet
+	const uint8_t *frame(int ago = 0) const {
+		if(ago >= mDepth || (uint32_t)ago >= mFrameCount) { return NULL; }
+		return mFrames + ((mFrameCount - 1 - ago) % mDepth) * mCapacity * 3;
+	}
+
+	/// Get called with the wire bytes of every frame as soon as it is shown (e.g. to dump it to a file)
+	void setFrameCallback(void (*callback)(const uint8_t *data, int nLeds, uint32_t frame)) { mCallback = callback; }
+};
+
+/// LED controller that renders into memory instead of onto a wire.  Every frame handed to show() goes through
+/// the same scaling, color correction and dithering path that the clockless drivers use, and the resulting bytes
+/// (in wire order, i.e. already reordered by RGB_ORDER) are kept in a ring holding the last FRAMES frames.
+/// This is what the host build uses in place of the real chipsets, and it can also be added explicitly with
+/// FastLED.addLeds(&controller, leds, n) for regression tests.  Use dynamic_cast<CMemoryCapture*>(&FastLED[i])
+/// to get at the frames of a controller without knowing its color order.
+template<EOrder RGB_ORDER = RGB, int FRAMES = 4>
+class CMemoryController : public CLEDController, public CMemoryCapture {
+	void capture(PixelController<RGB_ORDER> & pixels, int nLeds) {
+		uint8_t *out = beginFrame(nLeds);
+		while(pixels.has(1)) {
+			*out++ = pixels.loadAndScale0();
+			*out++ = pixels.loadAndScale1();
+			*out++ = pixels.loadAndScale2();
+			pixels.advanceData();
+			pixels.stepDithering();
+		}
+		endFrame(nLeds);
+	}
+
+public:
+	CMemoryController() : CMemoryCapture(FRAMES) {}
+
+	virtual void init() {}
+
+	virtual void clearLeds(int nLeds) { showColor(CRGB(0, 0, 0), nLeds, 0); }
+
+protected:
+	virtual void showColor(const struct CRGB & data, int nLeds, CRGB scale) {
+		PixelController<RGB_ORDER> pixels(data, nLeds, scale, getDither());
+		capture(pixels, nLeds);
+	}
+
+	virtual void show(const struct CRGB *data, int nLeds, CRGB scale) {
+		PixelController<RGB_ORDER> pixels(data, nLeds, scale, getDither());
+		capture(pixels, nLeds);
+	}
+
+#ifdef SUPPORT_ARGB
+	virtual void show(const struct CARGB *data, int nLeds, CRGB scale) {
+		PixelController<RGB_ORDER> pixels(data, nLeds, scale, getDither());
+		capture(pixels, nLeds);
+	}
+#endif
+};
+
+FASTLED_NAMESPACE_END
+
+#endif
@@ -0,0 +1,157 @@
+#if defined(FASTLED_HOST) || defined(__x86_64__)
+
+#include <stdarg.h>
+#include "platforms/host/particle_host.h"
+
+CloudClass Particle;
+WiFiClass WiFi;
+HostSerial Serial;
+
+static uint64_t sNowMicros = 0;
+
+static int32_t sAnalog[HOST_PIN_COUNT];
+static int32_t sDigital[HOST_PIN_COUNT];
+static bool sInputsReady = false;
+static int32_t (*sAnalogSource)(uint16_t pin, uint32_t now) = NULL;
+static void (*sHandlers[HOST_PIN_COUNT])(void);
+static int sHandlerModes[HOST_PIN_COUNT];
+
+struct QueuedPacket {
+	uint8_t *data;
+	int len;
+	QueuedPacket *next;
+};
+static QueuedPacket *sQueueHead = NULL;
+static QueuedPacket *sQueueTail = NULL;
+static void (*sSendHandler)(const uint8_t *data, int len, uint16_t port) = NULL;
+
+static void initInputs() {
+	if(sInputsReady) { return; }
+	// accelerometer and microphone sit at mid-scale, buttons are pulled up
+	for(int i = 0; i < HOST_PIN_COUNT; i++) {
+		sAnalog[i] = 2048;
+		sDigital[i] = HIGH;
+	}
+	sInputsReady = true;
+}
+
+uint32_t millis() { return (uint32_t)(sNowMicros / 1000); }
+
+// Every read moves time forward by a microsecond, so that code spinning on micros() terminates
+uint32_t micros() { return (uint32_t)(sNowMicros++); }
+
+void delay(unsigned long ms) { sNowMicros += (uint64_t)ms * 1000; }
+void delayMicroseconds(unsigned int us) { sNowMicros += us; }
+void advanceMicros(uint32_t us) { sNowMicros += us; }
+
+void pinMode(uint16_t, uint8_t) { initInputs(); }
+
+int32_t digitalRead(uint16_t pin) {
+	initInputs();
+	return (pin < HOST_PIN_COUNT) ? sDigital[pin] : LOW;
+}
+
+void digitalWrite(uint16_t pin, uint8_t value) { setDigitalInput(pin, value); }
+
+int32_t analogRead(uint16_t pin) {
+	initInputs();
+	if(sAnalogSource) { return sAnalogSource(pin, millis()); }
+	return (pin < HOST_PIN_COUNT) ? sAnalog[pin] : 0;
+}
+
+bool attachInterrupt(uint16_t pin, void (*handler)(void), int mode) {
+	if(pin >= HOST_PIN_COUNT) { return false; }
+	sHandlers[pin] = handler;
+	sHandlerModes[pin] = mode;
+	return true;
+}
+
+void setAnalogInput(uint16_t pin, int32_t value) {
+	initInputs();
+	if(pin < HOST_PIN_COUNT) { sAnalog[pin] = value; }
+}
+
+void setAnalogSource(int32_t (*source)(uint16_t pin, uint32_t now)) { sAnalogSource = source; }
+
+void setDigitalInput(uint16_t pin, int32_t value) {
+	initInputs();
+	if(pin >= HOST_PIN_COUNT) { return; }
+	int32_t old = sDigital[pin];
+	sDigital[pin] = value;
+	if(sHandlers[pin] && old != value) {
+		int mode = sHandlerModes[pin];
+		if(mode == CHANGE || (mode == FALLING && value == LOW) || (mode == RISING && value == HIGH)) {
+			sHandlers[pin]();
+		}
+	}
+}
+
+void injectUDPPacket(const uint8_t *data, int len) {
+	QueuedPacket *p = (QueuedPacket*)malloc(sizeof(QueuedPacket));
+	p->data = (uint8_t*)malloc(len);
+	memcpy(p->data, data, len);
+	p->len = len;
+	p->next = NULL;
+	if(sQueueTail) { sQueueTail->next = p; } else { sQueueHead = p; }
+	sQueueTail = p;
+}
+
+void setUDPSendHandler(void (*handler)(const uint8_t *data, int len, uint16_t port)) { sSendHandler = handler; }
+
+int UDP::parsePacket() {
+	free(mPacket);
+	mPacket = NULL;
+	mPacketSize = mReadPos = 0;
+	if(mPort == 0 || sQueueHead == NULL) { return 0; }
+
+	QueuedPacket *p = sQueueHead;
+	sQueueHead = p->next;
+	if(sQueueHead == NULL) { sQueueTail = NULL; }
+	mPacket = p->data;
+	mPacketSize = p->len;
+	free(p);
+	return mPacketSize;
+}
+
+int UDP::read(unsigned char *buffer, size_t len) {
+	int n = mPacketSize - mReadPos;
+	if((int)len < n) { n = len; }
+	if(n <= 0) { return -1; }
+	memcpy(buffer, mPacket + mReadPos, n);
+	mReadPos += n;
+	return n;
+}
+
+size_t UDP::write(const uint8_t *buffer, size_t size) {
+	if(mOutSize + size > sizeof(mOut)) { size = sizeof(mOut) - mOutSize; }
+	memcpy(mOut + mOutSize, buffer, size);
+	mOutSize += size;
+	return size;
+}
+
+int UDP::endPacket() {
+	if(sSendHandler) { sSendHandler(mOut, mOutSize, mOutPort); }
+	mOutSize = 0;
+	return 1;
+}
+
+String::String(const char *s) { mBuffer = strdup(s); }
+String::String(const String & other) { mBuffer = strdup(other.mBuffer); }
+String::~String() { free(mBuffer); }
+String & String::operator=(const String & other) {
+	if(this != &other) {
+		free(mBuffer);
+		mBuffer = strdup(other.mBuffer);
+	}
+	return *this;
+}
+
+size_t HostSerial::printf(const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	int n = vprintf(format, args);
+	va_end(args);
+	return n < 0 ? 0 : n;
+}
+
+#endif
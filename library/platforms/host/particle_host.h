@@ -0,0 +1,163 @@
+#ifndef __INC_PARTICLE_HOST_H
+#define __INC_PARTICLE_HOST_H
+
+// Stand-in for the parts of the Particle firmware API ("application.h") that the library and the example
+// sketches use, so that they can be compiled and run as a plain desktop program.
+//
+// Time is virtual: it starts at zero and only moves when the program delays, reads micros(), or the
+// simulated led controllers clock out a frame.  A sketch therefore runs as fast as the host allows while
+// still seeing the same timestamps it would see on the device.  Sensor and network inputs are injected
+// through the functions at the bottom of this file.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define D0 0
+#define D1 1
+#define D2 2
+#define D3 3
+#define D4 4
+#define D5 5
+#define D6 6
+#define D7 7
+#define A0 10
+#define A1 11
+#define A2 12
+#define A3 13
+#define A4 14
+#define A5 15
+#define A6 16
+#define A7 17
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define INPUT_PULLDOWN 3
+
+#define LOW 0
+#define HIGH 1
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define HOST_PIN_COUNT 20
+
+#ifndef constrain
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#endif
+
+uint32_t millis();
+uint32_t micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint16_t pin, uint8_t mode);
+int32_t digitalRead(uint16_t pin);
+void digitalWrite(uint16_t pin, uint8_t value);
+int32_t analogRead(uint16_t pin);
+bool attachInterrupt(uint16_t pin, void (*handler)(void), int mode);
+
+/// Minimal Wiring string
+class String {
+	char *mBuffer;
+public:
+	String(const char *s = "");
+	String(const String & other);
+	~String();
+	String & operator=(const String & other);
+	const char *c_str() const { return mBuffer; }
+	unsigned int length() const { return strlen(mBuffer); }
+	long toInt() const { return atol(mBuffer); }
+};
+
+class IPAddress {
+	uint8_t mAddress[4];
+public:
+	IPAddress() { memset(mAddress, 0, 4); }
+	IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) { mAddress[0] = a; mAddress[1] = b; mAddress[2] = c; mAddress[3] = d; }
+	uint8_t operator[](int index) const { return mAddress[index]; }
+	uint8_t & operator[](int index) { return mAddress[index]; }
+};
+
+/// UDP socket backed by a queue of injected packets.  Packets sent with beginPacket/write/endPacket go
+/// to the handler set with setUDPSendHandler, so a sender and a receiver can be looped back in-process.
+class UDP {
+	uint16_t mPort;
+	uint8_t *mPacket;
+	int mPacketSize;
+	int mReadPos;
+	uint8_t mOut[2048];
+	int mOutSize;
+	uint16_t mOutPort;
+public:
+	UDP() : mPort(0), mPacket(NULL), mPacketSize(0), mReadPos(0), mOutSize(0), mOutPort(0) {}
+	~UDP() { free(mPacket); }
+	uint8_t begin(uint16_t port) { mPort = port; return 1; }
+	void stop() { mPort = 0; }
+	int parsePacket();
+	int available() { return mPacketSize - mReadPos; }
+	int read() { return (mReadPos < mPacketSize) ? mPacket[mReadPos++] : -1; }
+	int read(unsigned char *buffer, size_t len);
+	int read(char *buffer, size_t len) { return read((unsigned char*)buffer, len); }
+	int beginPacket(IPAddress, uint16_t port) { mOutSize = 0; mOutPort = port; return 1; }
+	size_t write(const uint8_t *buffer, size_t size);
+	int endPacket();
+	IPAddress remoteIP() { return IPAddress(127, 0, 0, 1); }
+	uint16_t remotePort() { return mPort; }
+};
+
+class CloudClass {
+public:
+	bool variable(const char *, const char *) { return true; }
+	bool variable(const char *, const int *) { return true; }
+	bool variable(const char *, const double *) { return true; }
+	bool function(const char *, int (*)(String)) { return true; }
+	bool connect() { return true; }
+	bool disconnect() { return true; }
+	bool connected() { return false; }
+	void process() {}
+};
+
+class WiFiClass {
+public:
+	void listen() {}
+	bool ready() { return true; }
+	IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+	uint8_t *macAddress(uint8_t *mac) { memset(mac, 0, 6); return mac; }
+};
+
+/// Serial port writing to stdout
+class HostSerial {
+public:
+	void begin(long) {}
+	size_t print(const char *s) { return fputs(s, stdout) >= 0 ? strlen(s) : 0; }
+	size_t print(long n) { return ::printf("%ld", n); }
+	size_t print(double n, int digits = 2) { return ::printf("%.*f", digits, n); }
+	size_t println(const char *s = "") { return print(s) + print("\n"); }
+	size_t println(long n) { return print(n) + print("\n"); }
+	size_t println(double n, int digits = 2) { return print(n, digits) + print("\n"); }
+	size_t printf(const char *format, ...) __attribute__ ((format (printf, 2, 3)));
+};
+
+extern CloudClass Particle;
+extern WiFiClass WiFi;
+extern HostSerial Serial;
+
+// Virtual clock control
+void advanceMicros(uint32_t us);
+
+// Injectable inputs
+void setAnalogInput(uint16_t pin, int32_t value);
+void setAnalogSource(int32_t (*source)(uint16_t pin, uint32_t now));
+void setDigitalInput(uint16_t pin, int32_t value);
+void injectUDPPacket(const uint8_t *data, int len);
+void setUDPSendHandler(void (*handler)(const uint8_t *data, int len, uint16_t port));
+
+#endif
@@ -0,0 +1,165 @@
+// Host side check of layer compositing (library/cube-layers.h) against a voxel by voxel reference.
+//
+// Build on Linux:
+//   g++ -std=gnu++11 -O2 -DFASTLED_HOST_NO_MAIN -Ilibrary -ffunction-sections -Wl,--gc-sections tools/layertest.cpp library/*.cpp library/platforms/host/*.cpp -o layertest
+//
+// layertest [frames] [seed]
+//   Draws into a pool of layers at random, changes their modes and opacities, and adds them to and
+//   removes them from a LayerStack, composites the stack every frame and checks every voxel, and that
+//   the dirty region holds every lit one, against the layers combined one voxel at a time with
+//   lib8tion's arithmetic. Exits with 1 if any frame differs.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "beta-cube-library-fastled.h"
+#include "cube-layers.h"
+
+#define POOL_SIZE 6
+
+static Cube cube;
+static VoxelLayer pool[POOL_SIZE];
+static LayerStack stack;
+static int failures = 0;
+
+/** One channel of a layer combined with the one below, as the README describes the modes. */
+static uint8_t blendChannel(uint8_t below, uint8_t layer, uint8_t mode, fract8 opacity)
+{
+  bool full = opacity == 255;
+  uint8_t s = full ? layer : scale8(layer, opacity);
+  switch(mode) {
+    case LAYER_ADD:
+      return qadd8(below, s);
+    case LAYER_MAX:
+      return below > s ? below : s;
+    case LAYER_SCREEN:
+      return qadd8(below, scale8(s, 255 - below));
+    case LAYER_MULTIPLY: {
+      uint8_t m = ((uint16_t)below * (layer + 1)) >> 8;
+      return full ? m : scale8(below, 256 - opacity) + scale8(m, opacity);
+    }
+    default:
+      return full ? layer : scale8(below, 256 - opacity) + scale8(layer, opacity);
+  }
+}
+
+/** The stack combined from the bottom up, one voxel at a time. */
+static void reference(CRGB *out)
+{
+  for(int i = 0; i < PIXEL_COUNT; i++) {
+    CRGB c(0, 0, 0);
+    for(int l = 0; l < stack.layerCount(); l++) {
+      VoxelLayer &layer = stack.layer(l);
+      fract8 opacity = layer.getOpacity();
+      if(!opacity)
+        continue;
+      CRGB s = layer.leds[i];
+      if(layer.getMode() == LAYER_ALPHA) {
+        if(s)
+          nblend(c, s, opacity);
+      } else {
+        for(int k = 0; k < 3; k++)
+          c.raw[k] = blendChannel(c.raw[k], s.raw[k], layer.getMode(), opacity);
+      }
+    }
+    out[i] = c;
+  }
+}
+
+static bool inside(const DirtyRegion &r, int i)
+{
+  return !r.isEmpty() &&
+      cube.indexX(i) >= r.x0 && cube.indexX(i) <= r.x1 &&
+      cube.indexY(i) >= r.y0 && cube.indexY(i) <= r.y1 &&
+      cube.indexZ(i) >= r.z0 && cube.indexZ(i) <= r.z1;
+}
+
+/** Composite the stack and compare it with the reference. */
+static void check(const char *what, long frame)
+{
+  CRGB expect[PIXEL_COUNT];
+  cube.composite(stack);
+  reference(expect);
+  DirtyRegion dirty = cube.getDirtyRegion();
+  const CRGB *got = cube.voxels();
+  for(int i = 0; i < PIXEL_COUNT; i++) {
+    if(got[i] != expect[i] || (expect[i] && !inside(dirty, i))) {
+      if(failures < 10)
+        printf("%s, frame %ld: voxel %d is %d,%d,%d, expected %d,%d,%d%s\n", what, frame, i,
+            got[i].r, got[i].g, got[i].b, expect[i].r, expect[i].g, expect[i].b,
+            got[i] == expect[i] ? " inside the dirty region" : "");
+      failures++;
+      return;
+    }
+  }
+}
+
+static bool stacked(VoxelLayer &layer)
+{
+  for(int l = 0; l < stack.layerCount(); l++)
+    if(&stack.layer(l) == &layer)
+      return true;
+  return false;
+}
+
+/** Draw a few random spheres into a layer. */
+static void drawInto(VoxelLayer &layer)
+{
+  cube.setTarget(&layer);
+  cube.clear(false);
+  int spheres = rand() % 6;
+  for(int j = 0; j < spheres; j++)
+    cube.sphere(rand() % cube.size, rand() % cube.size, rand() % cube.size, rand() % 4,
+        Color(rand() % 256, rand() % 256, rand() % 256));
+  cube.setTarget(NULL);
+}
+
+int main(int argc, char **argv)
+{
+  long frames = argc > 1 ? atol(argv[1]) : 3000;
+  srand(argc > 2 ? atoi(argv[2]) : 1);
+  cube.begin();
+
+  // a layer removed from the top of the stack must leave the cache along with it
+  VoxelLayer a(LAYER_ADD), b(LAYER_ADD);
+  cube.setTarget(&a);
+  cube.setVoxel(1, 1, 1, Color(50, 0, 0));
+  cube.setTarget(&b);
+  cube.setVoxel(2, 2, 2, Color(0, 50, 0));
+  cube.setTarget(NULL);
+  stack.add(a);
+  stack.add(b);
+  check("two layers", 0);
+  check("nothing changed", 0);
+  stack.remove(b);
+  check("top layer removed", 0);
+  stack.remove(a);
+  check("all layers removed", 0);
+
+  for(int i = 0; i < POOL_SIZE; i++) {
+    drawInto(pool[i]);
+    stack.add(pool[i]);
+  }
+  for(long frame = 0; frame < frames; frame++) {
+    for(int i = 0; i < POOL_SIZE; i++) {
+      VoxelLayer &layer = pool[i];
+      if(rand() % 4 == 0)
+        drawInto(layer);
+      if(rand() % 8 == 0)
+        layer.setMode(rand() % 6);
+      if(rand() % 8 == 0)
+        layer.setOpacity(rand() % 4 == 0 ? 255 : rand() % 4 == 0 ? 0 : rand() % 256);
+      if(rand() % 16 == 0) {
+        if(stacked(layer))
+          stack.remove(layer);
+        else
+          stack.add(layer);
+      }
+    }
+    if(frame % 7 == 0)
+      cube.clear(false);
+    check("random layers", frame);
+  }
+
+  printf("%ld frames, %d failed\n", frames, failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,80 @@
+// Host side check that drawing particles (library/cube-particles.h) keeps the dirty region inside the cube.
+//
+// Build on Linux:
+//   g++ -std=gnu++11 -O2 -DFASTLED_HOST_NO_MAIN -Ilibrary -ffunction-sections -Wl,--gc-sections tools/particletest.cpp library/*.cpp library/platforms/host/*.cpp -o particletest
+//
+// particletest [frames] [seed]
+//   Spawns particles at random inside and around the cube, with culling off so that they stay there,
+//   draws them, and checks that the dirty region lies inside the cube and holds every lit voxel.
+//   Exits with 1 if any frame fails.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "beta-cube-library-fastled.h"
+#include "cube-particles.h"
+
+static Cube cube;
+static ParticleSystem particles;
+static int failures = 0;
+
+/** Draw the particles into a clear cube and check the dirty region. */
+static void check(const char *what, long frame)
+{
+  cube.clear(false);
+  cube.draw(particles);
+  DirtyRegion r = cube.getDirtyRegion();
+  const int last = cube.size - 1;
+  if(!r.isEmpty() && (r.x0 < 0 || r.y0 < 0 || r.z0 < 0 || r.x1 > last || r.y1 > last || r.z1 > last)) {
+    if(failures < 10)
+      printf("%s, frame %ld: dirty region x %d..%d y %d..%d z %d..%d is outside the cube\n", what, frame,
+          r.x0, r.x1, r.y0, r.y1, r.z0, r.z1);
+    failures++;
+    return;
+  }
+  const CRGB *got = cube.voxels();
+  for(int i = 0; i < PIXEL_COUNT; i++) {
+    int x = cube.indexX(i), y = cube.indexY(i), z = cube.indexZ(i);
+    if(got[i] && (r.isEmpty() || x < r.x0 || x > r.x1 || y < r.y0 || y > r.y1 || z < r.z0 || z > r.z1)) {
+      if(failures < 10)
+        printf("%s, frame %ld: voxel %d,%d,%d is lit outside the dirty region\n", what, frame, x, y, z);
+      failures++;
+      return;
+    }
+  }
+  // these visit the dirty region, so they would run off the buffer if it were outside the cube
+  cube.fade(0.5f, false);
+  cube.scaleVolume(200);
+  cube.blur(64);
+}
+
+/** A coordinate in 8.8 fixed point, up to a few voxels outside the cube either side. */
+static int16_t around(void)
+{
+  return (rand() % ((cube.size + 8) * 256)) - 4 * 256;
+}
+
+int main(int argc, char **argv)
+{
+  long frames = argc > 1 ? atol(argv[1]) : 3000;
+  srand(argc > 2 ? atoi(argv[2]) : 1);
+  cube.begin();
+  particles.setCulling(false);
+
+  // inside the cube on x and z but not on y: lights nothing, and must not widen the region
+  particles.spawn(PointQ(2 * 256, 20 * 256, 3 * 256), 0, 0, 0, CRGB(255, 255, 255), 100);
+  check("one particle outside on y", 0);
+  particles.spawn(PointQ(5 * 256 + 128, 1 * 256, 6 * 256), 0, 0, 0, CRGB(255, 255, 255), 100);
+  check("one particle inside", 0);
+
+  for(long frame = 0; frame < frames; frame++) {
+    particles.clear();
+    int count = rand() % 32;
+    for(int i = 0; i < count; i++)
+      particles.spawn(PointQ(around(), around(), around()), 0, 0, 0,
+          CRGB(rand() % 256, rand() % 256, rand() % 256), 1 + rand() % 100);
+    check("random particles", frame);
+  }
+
+  printf("%ld frames, %d failed\n", frames, failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,359 @@
+/*  Host side sender, encoder and tests for the cube streaming protocol (library/cube-stream.h).
+
+    Build on Linux:
+      g++ -std=gnu++11 -O2 -pthread -Ilibrary tools/streamtest.cpp library/cube-stream.cpp -o streamtest
+
+    streamtest loopback [frames] [size]
+      Streams frames over 127.0.0.1 to a receiver thread that reassembles them with StreamReceiver,
+      checks every completed frame and reports frames per second and latency. Every 8th frame a
+      fragment is held back and sent late to check that stale data is dropped.
+
+    streamtest send <address> [port] [fps] [size] [keyframe interval]
+      Streams a moving rainbow to a cube, as deltas with a keyframe every so often.
+
+    streamtest encode <frames.rgb> <packets> [size] [keyframe interval]
+      Encodes raw frames (3 bytes per voxel in voxel index order, one frame after the other) into
+      packets, each preceded by its length as 2 bytes, high byte first, and reports the bandwidth
+      against sending every frame whole.
+
+    streamtest fuzz [iterations] [seed]
+      Round trips random frame sequences through the encoder and receiver over a channel that drops,
+      duplicates and reorders packets, checking every completed frame against the one that was sent,
+      then feeds the receiver corrupted packets and checks it never writes outside the frame buffer.
+*/
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <map>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+#include "cube-stream.h"
+
+static int64_t nowMicros()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (int64_t)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+/** Value of a color byte of a loopback test frame. */
+static uint8_t pattern(uint16_t frame, int byte)
+{
+  return (uint8_t)(frame * 7 + byte * 13 + (byte >> 8));
+}
+
+/** Collects the packets of a frame. */
+static void collect(const uint8_t *packet, int length, void *context)
+{
+  ((std::vector<std::vector<uint8_t> > *)context)->push_back(std::vector<uint8_t>(packet, packet + length));
+}
+
+struct Socket {
+  int sock;
+  sockaddr_in to;
+};
+
+/** Sends a packet to a cube. */
+static void transmit(const uint8_t *packet, int length, void *context)
+{
+  Socket *s = (Socket *)context;
+  sendto(s->sock, packet, length, 0, (const sockaddr *)&s->to, sizeof(s->to));
+}
+
+static int loopback(int frames, int size)
+{
+  int voxels = size * size * size;
+  int rx = socket(AF_INET, SOCK_DGRAM, 0);
+  int bufferSize = 4 << 20;
+  setsockopt(rx, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+  struct timeval timeout = { 0, 200000 };
+  setsockopt(rx, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  Socket tx;
+  tx.sock = socket(AF_INET, SOCK_DGRAM, 0);
+  memset(&tx.to, 0, sizeof(tx.to));
+  tx.to.sin_family = AF_INET;
+  tx.to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addressLength = sizeof(tx.to);
+  if(bind(rx, (sockaddr *)&tx.to, sizeof(tx.to)) || getsockname(rx, (sockaddr *)&tx.to, &addressLength)) {
+    perror("bind");
+    return 1;
+  }
+
+  std::vector<std::atomic<int64_t> > sent(65536);
+  std::atomic<bool> done(false);
+  int completed = 0, stale = 0, invalid = 0, corrupt = 0;
+  int64_t latencyTotal = 0, latencyMax = 0;
+  int64_t first = 0, last = 0;
+
+  std::thread receiver([&]() {
+    StreamReceiver stream;
+    std::vector<uint8_t> rgb(3 * voxels);
+    uint8_t packet[2048];
+    while(true) {
+      ssize_t length = recv(rx, packet, sizeof(packet), 0);
+      if(length < 0) {
+        if(done)
+          break;
+        continue;
+      }
+      int64_t now = nowMicros();
+      int result = stream.receive(packet, length, &rgb[0], voxels, now / 1000);
+      if(result == STREAM_STALE)
+        stale++;
+      else if(result == STREAM_INVALID)
+        invalid++;
+      else if(result == STREAM_COMPLETE) {
+        StreamHeader header;
+        header.parse(packet, length);
+        for(int i = 0; i < 3 * voxels; i++)
+          if(rgb[i] != pattern(header.frame, i)) {
+            corrupt++;
+            break;
+          }
+        int64_t latency = now - sent[header.frame];
+        latencyTotal += latency;
+        if(latency > latencyMax)
+          latencyMax = latency;
+        if(!completed)
+          first = now;
+        last = now;
+        completed++;
+      }
+    }
+  });
+
+  // every frame is a keyframe, the pattern changes every voxel
+  std::vector<uint8_t> rgb(3 * voxels), previous(3 * voxels);
+  StreamEncoder encoder(&previous[0], voxels, 1);
+  std::vector<std::vector<uint8_t> > packets;
+  std::vector<uint8_t> late;
+  int held = 0, lateSent = 0;
+  for(int frame = 0; frame < frames; frame++) {
+    uint16_t id = encoder.nextFrame();
+    for(int i = 0; i < 3 * voxels; i++)
+      rgb[i] = pattern(id, i);
+    packets.clear();
+    sent[id] = nowMicros();
+    encoder.encode(&rgb[0], collect, &packets);
+    for(size_t p = 0; p < packets.size(); p++) {
+      if(p == 0 && frame % 8 == 0) {
+        // hold back a fragment, the frame can not complete without it
+        late = packets[p];
+        held++;
+      } else {
+        transmit(&packets[p][0], packets[p].size(), &tx);
+      }
+    }
+    if(frame % 8 == 1 && !late.empty()) {
+      transmit(&late[0], late.size(), &tx);
+      late.clear();
+      lateSent++;
+    }
+    // keep the socket buffer from overflowing
+    if(frame % 64 == 63)
+      usleep(1000);
+  }
+  usleep(300000);
+  done = true;
+  receiver.join();
+  close(rx);
+  close(tx.sock);
+
+  int expected = frames - held;
+  double seconds = (last - first) / 1e6;
+  printf("voxels=%d fragments_per_frame=%d frames_sent=%d frames_completed=%d expected=%d "
+      "stale_dropped=%d late_sent=%d invalid=%d corrupt=%d fps=%.0f latency_avg_us=%.1f latency_max_us=%lld\n",
+      voxels, (int)packets.size(), frames, completed, expected,
+      stale, lateSent, invalid, corrupt, (completed > 1 && seconds > 0) ? (completed - 1) / seconds : 0.0,
+      completed ? (double)latencyTotal / completed : 0.0, (long long)latencyMax);
+  return (corrupt || invalid || stale < lateSent || completed > expected) ? 1 : 0;
+}
+
+static int send(const char *host, int port, int fps, int size, int keyframeInterval)
+{
+  int voxels = size * size * size;
+  Socket tx;
+  tx.sock = socket(AF_INET, SOCK_DGRAM, 0);
+  memset(&tx.to, 0, sizeof(tx.to));
+  tx.to.sin_family = AF_INET;
+  tx.to.sin_port = htons(port);
+  if(inet_pton(AF_INET, host, &tx.to.sin_addr) != 1) {
+    fprintf(stderr, "bad address %s\n", host);
+    return 1;
+  }
+  std::vector<uint8_t> rgb(3 * voxels), previous(3 * voxels);
+  StreamEncoder encoder(&previous[0], voxels, keyframeInterval);
+  for(int frame = 0; ; frame++) {
+    for(int z = 0; z < size; z++)
+      for(int x = 0; x < size; x++)
+        for(int y = 0; y < size; y++) {
+          uint8_t *c = &rgb[3 * ((z * size + x) * size + y)];
+          float phase = (x + y + z) * 0.4f - frame * 0.1f;
+          c[0] = 32 + 31 * sinf(phase);
+          c[1] = 32 + 31 * sinf(phase + 2.094f);
+          c[2] = 32 + 31 * sinf(phase + 4.189f);
+        }
+    encoder.encode(&rgb[0], transmit, &tx);
+    usleep(1000000 / fps);
+  }
+  return 0;
+}
+
+static int encode(const char *in, const char *out, int size, int keyframeInterval)
+{
+  int voxels = size * size * size;
+  FILE *input = fopen(in, "rb");
+  FILE *output = fopen(out, "wb");
+  if(!input || !output) {
+    perror(input ? out : in);
+    return 1;
+  }
+  std::vector<uint8_t> rgb(3 * voxels), previous(3 * voxels);
+  StreamEncoder encoder(&previous[0], voxels, keyframeInterval);
+  std::vector<std::vector<uint8_t> > packets;
+  long frames = 0, bytes = 0, packetCount = 0;
+  while(fread(&rgb[0], 3 * voxels, 1, input) == 1) {
+    packets.clear();
+    bytes += encoder.encode(&rgb[0], collect, &packets);
+    for(size_t p = 0; p < packets.size(); p++) {
+      uint8_t length[2] = { (uint8_t)(packets[p].size() >> 8), (uint8_t)packets[p].size() };
+      fwrite(length, 2, 1, output);
+      fwrite(&packets[p][0], packets[p].size(), 1, output);
+    }
+    packetCount += packets.size();
+    frames++;
+  }
+  fclose(input);
+  fclose(output);
+
+  // what sending every frame whole would have taken
+  StreamEncoder whole(&previous[0], voxels, 1);
+  long wholeBytes = frames * whole.encode(&rgb[0], NULL, NULL);
+  printf("frames=%ld packets=%ld bytes=%ld keyframe_bytes=%ld ratio=%.2f\n",
+      frames, packetCount, bytes, wholeBytes, bytes ? (double)wholeBytes / bytes : 0.0);
+  return 0;
+}
+
+/** Applies random changes to a frame; mostly a few voxels, sometimes many. */
+static void animate(std::vector<uint8_t> &rgb, int voxels)
+{
+  int kind = rand() % 10;
+  int changes = (kind < 6) ? rand() % 8 : (kind < 9) ? rand() % (voxels / 4 + 1) : voxels;
+  for(int c = 0; c < changes; c++) {
+    int v = rand() % voxels;
+    int run = (kind == 9) ? 1 : 1 + rand() % 4;
+    for(int i = v; i < v + run && i < voxels; i++)
+      for(int b = 0; b < 3; b++)
+        rgb[3 * i + b] = rand();
+  }
+}
+
+static int fuzz(int iterations, unsigned seed)
+{
+  const int sizes[] = { 4, 8, 16 };
+  const int guard = 64;
+  long completed = 0, checked = 0, mismatches = 0, overruns = 0, bytes = 0, wholeBytes = 0;
+  srand(seed);
+  for(int it = 0; it < iterations; it++) {
+    int size = sizes[rand() % 3];
+    int voxels = size * size * size;
+    std::vector<uint8_t> rgb(3 * voxels), previous(3 * voxels);
+    std::vector<uint8_t> received(3 * voxels + 2 * guard, 0xA5);
+    uint8_t *frame = &received[guard];
+    StreamEncoder encoder(&previous[0], voxels, 1 + rand() % 40);
+    StreamReceiver stream;
+    std::map<uint16_t, std::vector<uint8_t> > history;
+    int loss = rand() % 3;
+    uint32_t now = 0;
+
+    for(int f = 0; f < 200; f++) {
+      animate(rgb, voxels);
+      uint16_t id = encoder.nextFrame();
+      history[id] = rgb;
+      history.erase((uint16_t)(id - 64));
+      std::vector<std::vector<uint8_t> > packets;
+      bytes += encoder.encode(&rgb[0], collect, &packets);
+      wholeBytes += 3 * voxels + STREAM_HEADER_SIZE * ((voxels + 166) / 167);
+
+      // a lossy channel: drop, duplicate and swap neighbouring packets
+      std::vector<std::vector<uint8_t> > channel;
+      for(size_t p = 0; p < packets.size(); p++) {
+        int r = rand() % 100;
+        if(r < loss * 3)
+          continue;
+        channel.push_back(packets[p]);
+        if(r >= 97)
+          channel.push_back(packets[p]);
+      }
+      for(size_t p = 1; p < channel.size(); p++)
+        if(rand() % 100 < loss * 5)
+          channel[p].swap(channel[p - 1]);
+
+      for(size_t p = 0; p < channel.size(); p++) {
+        int result = stream.receive(&channel[p][0], channel[p].size(), frame, voxels, now);
+        if(result == STREAM_COMPLETE) {
+          StreamHeader header;
+          header.parse(&channel[p][0], channel[p].size());
+          completed++;
+          if(history.count(header.frame)) {
+            checked++;
+            if(memcmp(frame, &history[header.frame][0], 3 * voxels))
+              mismatches++;
+          }
+        }
+      }
+      now += 10;
+    }
+
+    // corrupted and random packets must only ever be rejected or written inside the frame
+    std::vector<uint8_t> packet;
+    for(int c = 0; c < 2000; c++) {
+      std::vector<std::vector<uint8_t> > packets;
+      animate(rgb, voxels);
+      encoder.encode(&rgb[0], collect, &packets);
+      packet = packets[rand() % packets.size()];
+      int flips = 1 + rand() % 4;
+      for(int i = 0; i < flips; i++)
+        packet[rand() % packet.size()] = rand();
+      if(rand() % 4 == 0)
+        packet.resize(rand() % (packet.size() + 1));
+      if(packet.empty())
+        continue;
+      stream.receive(&packet[0], packet.size(), frame, voxels, now);
+    }
+    for(int i = 0; i < guard; i++)
+      if(received[i] != 0xA5 || received[guard + 3 * voxels + i] != 0xA5) {
+        overruns++;
+        break;
+      }
+  }
+  printf("iterations=%d frames_completed=%ld checked=%ld mismatches=%ld overruns=%ld bandwidth_ratio=%.2f\n",
+      iterations, completed, checked, mismatches, overruns, bytes ? (double)wholeBytes / bytes : 0.0);
+  return (mismatches || overruns || !checked) ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+  if(argc >= 2 && !strcmp(argv[1], "loopback"))
+    return loopback((argc > 2) ? atoi(argv[2]) : 10000, (argc > 3) ? atoi(argv[3]) : 8);
+  if(argc >= 3 && !strcmp(argv[1], "send"))
+    return send(argv[2], (argc > 3) ? atoi(argv[3]) : 2222, (argc > 4) ? atoi(argv[4]) : 30,
+        (argc > 5) ? atoi(argv[5]) : 8, (argc > 6) ? atoi(argv[6]) : 30);
+  if(argc >= 4 && !strcmp(argv[1], "encode"))
+    return encode(argv[2], argv[3], (argc > 4) ? atoi(argv[4]) : 8, (argc > 5) ? atoi(argv[5]) : 30);
+  if(argc >= 2 && !strcmp(argv[1], "fuzz"))
+    return fuzz((argc > 2) ? atoi(argv[2]) : 200, (argc > 3) ? atoi(argv[3]) : 1);
+  fprintf(stderr, "usage: %s loopback [frames] [size]\n"
+      "       %s send <address> [port] [fps] [size] [keyframe interval]\n"
+      "       %s encode <frames.rgb> <packets> [size] [keyframe interval]\n"
+      "       %s fuzz [iterations] [seed]\n", argv[0], argv[0], argv[0], argv[0]);
+  return 2;
+}